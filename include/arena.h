@@ -0,0 +1,25 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_ALIGN 16
+
+// One block for everything that lives as long as a table: sized up front
+// with ArenaSize, carved up with ArenaAlloc and released with one ArenaFree.
+// Nothing in it is freed on its own.
+struct Arena
+{
+    unsigned char *base;
+    size_t size;
+    size_t used;
+};
+
+// What an allocation of size takes out of an arena, padding included.
+size_t ArenaSize( size_t size );
+int ArenaInit( struct Arena *arena, size_t size );
+// Zeroed.  NULL if the arena wasn't sized for it.
+void * ArenaAlloc( struct Arena *arena, size_t size );
+void ArenaFree( struct Arena *arena );
+
+#endif // ARENA_H
@@ -0,0 +1,79 @@
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <GLES2/gl2.h>
+#include "glesTools.h"
+#include "mesh.h"
+
+#define ASSET_LOADER_MAX_WORKERS 4
+#define ASSET_LOADER_MAX_JOBS 32
+#define TIMELINE_MAX_EVENTS 64
+
+enum AssetJobType
+{
+    ASSET_JOB_SHADER,
+    ASSET_JOB_MESH,
+    ASSET_JOB_PNG
+};
+
+// One file to load off the GL thread.  Results stay in the job until the GL
+// thread picks them up: source and image are handed over, meshes are parsed
+// straight into *mesh.
+struct AssetJob
+{
+    enum AssetJobType type;
+    const char *name;
+    struct Mesh *mesh;
+    int withNormals;
+
+    char *source;
+    struct PngImage image;
+    int ok;
+    int done;        // Guarded by the loader lock.
+    GLuint worker;
+    double start;
+    double end;
+};
+
+struct AssetWorker
+{
+    struct AssetLoader *loader;
+    GLuint index;
+};
+
+// Decodes and parses the startup assets on worker threads while the window
+// and EGL come up.  Workers take jobs in the order they were added; the GL
+// thread blocks in AssetLoaderWait only for the one it needs next.
+struct AssetLoader
+{
+    struct AssetJob jobs[ ASSET_LOADER_MAX_JOBS ];
+    GLuint jobCount;
+    atomic_uint nextJob;
+
+    pthread_mutex_t lock;
+    pthread_cond_t jobDone;
+    pthread_t workers[ ASSET_LOADER_MAX_WORKERS ];
+    struct AssetWorker workerArgs[ ASSET_LOADER_MAX_WORKERS ];
+    GLuint workerCount;
+};
+
+void AssetLoaderAddShader( struct AssetLoader *loader, const char *name );
+void AssetLoaderAddMesh( struct AssetLoader *loader, const char *name,
+        struct Mesh *mesh, int withNormals );
+void AssetLoaderAddPng( struct AssetLoader *loader, const char *name );
+int AssetLoaderStart( struct AssetLoader *loader, GLuint workerCount );
+// Blocks until the job for name has run.  NULL if it failed or was never
+// added.
+struct AssetJob * AssetLoaderWait( struct AssetLoader *loader,
+        const char *name );
+void AssetLoaderFinish( struct AssetLoader *loader );
+
+// Startup timeline.  Times are relative to the first mark.
+double TimelineNow( void );
+void TimelineMark( const char *label );
+void TimelineReport( FILE *file, const struct AssetLoader *loader );
+
+#endif // ASSETLOADER_H
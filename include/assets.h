@@ -0,0 +1,38 @@
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stddef.h>
+
+// Read-only copy of a file under shader/, model/, texture/ or table/ compiled
+// into the executable by embedAssets.  data is followed by a '\0' not counted
+// in size.
+struct Asset
+{
+    const char *name;
+    const unsigned char *data;
+    size_t size;
+};
+
+// Generated into assetData.c, sorted by name.
+extern const struct Asset embeddedAssets[];
+extern const unsigned int embeddedAssetCount;
+
+struct AssetData
+{
+    const unsigned char *data; // '\0' terminated.
+    size_t size;
+    void *buffer; // Set when the data was read from disk.
+};
+
+// Read assets from files under directory instead of the embedded copies, for
+// working on them without a rebuild.  NULL goes back to the embedded ones.
+void AssetSetDirectory( const char *directory );
+const char * AssetDirectory( void );
+// Path of name on disk, only meaningful with an asset directory set.
+int AssetPath( const char *name, char *path, size_t size );
+// The asset called name, or failing that the file at the path name, so files
+// outside the assets (a new table, say) load without a rebuild.
+int AssetOpen( const char *name, struct AssetData *asset );
+void AssetClose( struct AssetData *asset );
+
+#endif // ASSETS_H
@@ -0,0 +1,33 @@
+#ifndef ATLAS_H
+#define ATLAS_H
+
+#include <GLES2/gl2.h>
+
+#define ATLAS_MAX_LEVELS 16
+#define ATLAS_MAX_SPRITES 64
+#define ATLAS_NAME_SIZE 64
+
+struct AtlasSprite
+{
+    char name[ ATLAS_NAME_SIZE ];
+    GLfloat uv[4]; // left, top, right, bottom
+};
+
+// Metadata written by makeTextureAtlas next to the atlas images.  levels are
+// asset names of the mip chain, largest first, down to 1x1.
+struct Atlas
+{
+    GLint width;
+    GLint height;
+    int premultiplied;
+    GLuint levelCount;
+    char levels[ ATLAS_MAX_LEVELS ][ ATLAS_NAME_SIZE ];
+    GLuint spriteCount;
+    struct AtlasSprite sprites[ ATLAS_MAX_SPRITES ];
+};
+
+int LoadAtlas( struct Atlas *atlas, const char *_fileName );
+const struct AtlasSprite * AtlasFind( const struct Atlas *atlas,
+        const char *name );
+
+#endif // ATLAS_H
@@ -0,0 +1,69 @@
+#ifndef CONTROLPROTOCOL_H
+#define CONTROLPROTOCOL_H
+
+#include <stdint.h>
+
+// Wire format of the control socket (--control PATH).  Every message is a
+// ControlHeader followed by size bytes of payload, in the host's byte order;
+// the socket is local so both ends share it.  Clients can include this header
+// on its own.
+
+#define CONTROL_PROTOCOL_VERSION 2
+#define CONTROL_BALLS 24 // NUM_PARTICLES
+
+enum ControlMessageType
+{
+    // Client -> game.
+    CONTROL_PLACE = 1,     // struct ControlVector: cue ball position.
+    CONTROL_SHOOT = 2,     // struct ControlVector: cue ball velocity.
+    CONTROL_SNAPSHOT = 3,  // No payload.  Answered with CONTROL_STATE.
+    CONTROL_SUBSCRIBE = 4, // uint32_t CONTROL_SUBSCRIBE_* flags.
+
+    // Game -> client.
+    CONTROL_HELLO = 64,    // uint32_t CONTROL_PROTOCOL_VERSION.
+    CONTROL_STATE = 65,    // struct ControlState.
+    CONTROL_EVENT = 66,    // struct ControlEvent.
+    CONTROL_DROPPED = 67,  // uint32_t messages dropped because the client
+                           // wasn't reading.
+};
+
+#define CONTROL_SUBSCRIBE_TICKS  0x1 // A CONTROL_STATE for every tick that
+                                     // changed something.
+#define CONTROL_SUBSCRIBE_EVENTS 0x2 // A CONTROL_EVENT for every contact.
+
+// Events use the physics' contact types.
+#define CONTROL_EVENT_BALL    0
+#define CONTROL_EVENT_CUSHION 1
+#define CONTROL_EVENT_POCKET  2
+
+struct ControlHeader
+{
+    uint16_t type;
+    uint16_t size;
+};
+
+struct ControlVector
+{
+    float x;
+    float y;
+};
+
+// Balls are indexed by number, 0 is the cue ball.  Pocketed balls are at
+// +infinity.
+struct ControlState
+{
+    uint32_t tick;
+    uint32_t moving;
+    float balls[ CONTROL_BALLS ][ 4 ]; // x, y, vx, vy
+};
+
+struct ControlEvent
+{
+    uint32_t tick;
+    uint16_t type;
+    int16_t a;  // Ball number.
+    int16_t b;  // Ball number for CONTROL_EVENT_BALL, otherwise -1.
+    uint16_t padding;
+};
+
+#endif // CONTROLPROTOCOL_H
@@ -0,0 +1,64 @@
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <pthread.h>
+#include <GLES2/gl2.h>
+#include "controlProtocol.h"
+#include "input.h"
+#include "ring.h"
+#include "simThread.h"
+
+#define CONTROL_MAX_CLIENTS 8
+#define CONTROL_CLIENT_QUEUE 32768 // Bytes waiting to go out per client.
+#define CONTROL_TICK_QUEUE 512     // Ticks from the sim, a bit over 2 s.
+#define CONTROL_COMMAND_QUEUE 64
+#define CONTROL_POLL_MS 4          // About one sim tick.
+
+struct ControlClient
+{
+    int fd;
+    uint32_t subscriptions;
+    int wantsSnapshot;
+    uint32_t dropped;
+
+    unsigned char in[ 256 ];
+    size_t inSize;
+    unsigned char out[ CONTROL_CLIENT_QUEUE ];
+    size_t outStart;
+    size_t outEnd;
+};
+
+// A Unix domain socket that bots and tools use to drive a running game, see
+// controlProtocol.h.  One thread does all the socket work.  Every socket is
+// non-blocking and every client has a bounded queue, so a slow client only
+// loses its own messages and never holds up the sim or the renderer.
+struct ControlServer
+{
+    pthread_t thread;
+    int started;
+    int listenFd;
+    int wake[2];
+    char path[ 108 ];
+
+    // Sim thread -> server, attached to the sim with SimThread.ticks.
+    struct Ring ticks;
+    // Server -> render thread, drained by the play state machine like the
+    // input thread's commands.
+    struct Ring commands;
+
+    // Ball number of each particleData slot.  Set before the sim starts.
+    GLint ballNumbers[ NUM_PARTICLES ];
+
+    // Server thread only.
+    int hasState;
+    struct SimTick state;
+    struct ControlClient clients[ CONTROL_MAX_CLIENTS ];
+};
+
+int ControlServerStart( struct ControlServer *server, const char *path );
+void ControlServerStop( struct ControlServer *server );
+// Returns 0 when there is nothing waiting.
+int ControlServerPoll( struct ControlServer *server,
+        struct InputCommand *command );
+
+#endif // CONTROLSERVER_H
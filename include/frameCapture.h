@@ -0,0 +1,64 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <pthread.h>
+#include <GLES2/gl2.h>
+
+#define CAPTURE_FRAME_COUNT 8
+#define CAPTURE_MAX_WORKERS 8
+
+struct FrameCapture;
+
+// One read back frame.  Rows are bottom-up, as glReadPixels leaves them.
+struct Frame
+{
+    unsigned char *pixels;
+    GLint width;
+    GLint height;
+    GLenum format;
+    GLenum type;
+    GLuint bytesPerPixel;
+    GLuint number;
+    struct Frame *next;
+};
+
+typedef void (*FrameEncodeFunc)( struct FrameCapture *capture, struct Frame
+        *frame );
+
+// A fixed pool of frame buffers cycled between the render thread, which reads
+// pixels into them, and worker threads, which encode them.  Nothing is
+// allocated after FrameCaptureInit.  When every buffer is waiting to be
+// encoded FrameCaptureAcquire blocks, which keeps memory bounded.
+struct FrameCapture
+{
+    struct Frame frames[ CAPTURE_FRAME_COUNT ];
+    unsigned char *pixels;
+
+    struct Frame *freeList;
+    struct Frame *queueHead;
+    struct Frame *queueTail;
+    pthread_mutex_t lock;
+    pthread_cond_t frameFree;
+    pthread_cond_t frameQueued;
+    int stopping;
+
+    pthread_t workers[ CAPTURE_MAX_WORKERS ];
+    GLuint workerCount;
+
+    FrameEncodeFunc encode;
+    void *encodeData;
+    GLuint framesSubmitted;
+};
+
+int FrameCaptureInit( struct FrameCapture *capture, GLint width, GLint height,
+        GLuint bytesPerPixel, GLuint workerCount, FrameEncodeFunc encode,
+        void *encodeData );
+struct Frame * FrameCaptureAcquire( struct FrameCapture *capture );
+void FrameCaptureSubmit( struct FrameCapture *capture, struct Frame *frame );
+void FrameCaptureFinish( struct FrameCapture *capture );
+
+// Encoders.  encodeData is the output directory.
+void FrameEncodePng( struct FrameCapture *capture, struct Frame *frame );
+void FrameEncodeRaw( struct FrameCapture *capture, struct Frame *frame );
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,60 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <stdio.h>
+#include <GLES2/gl2.h>
+
+// Upper edges of the frame time histogram in milliseconds, chosen around
+// 120, 60 and 30 Hz.  The last bucket holds everything slower.
+#define FRAME_HISTOGRAM_EDGES { 4, 8, 12, 17, 20, 25, 34, 50, 67, 100 }
+#define FRAME_HISTOGRAM_BUCKETS 11
+// A frame misses its deadline when it takes this many target intervals.
+#define FRAME_MISSED_FACTOR 1.5
+// Assumed display refresh for the target without --fps, since neither
+// esUtil nor EGL says what it is.
+#define FRAME_REFRESH_RATE 60
+
+// Paces the render loop and keeps presentation timing.  Whatever loop draws
+// (esMainLoop, which is out of our hands on the Pi, or HeadlessMainLoop)
+// calls FramePacerBegin as a frame starts and FramePacerDrawn once it has
+// been drawn; the swap happens in between those calls.
+//
+// With a target rate FramePacerBegin sleeps until the frame's slot comes up,
+// for modes where the swap doesn't block on vsync.  A frame that runs late
+// moves the slots along rather than making the next ones hurry.
+struct FramePacer
+{
+    double interval;        // Seconds per frame, 0 runs flat out.
+    double target;          // What missed is measured against, 0 for none.
+    double nextFrame;       // When the next frame may start.
+    double reportInterval;  // Seconds between reports, 0 only at exit.
+    double lastReport;
+
+    double frameStart;
+    double drawn;           // 0 until the first frame is drawn.
+
+    // Since the last report.
+    GLuint frames;
+    GLuint missed;
+    double frameTotal;
+    double frameMin;
+    double frameMax;
+    double swapTotal;       // From drawn to the next frame, less sleeping.
+    double swapMax;
+    double sleepTotal;
+    GLuint histogram[ FRAME_HISTOGRAM_BUCKETS ];
+};
+
+// fps 0 leaves the rate to the swap, and frames are then measured against
+// swapInterval refreshes (< 0 being EGL's default of 1, 0 no target).
+void FramePacerInit( struct FramePacer *pacer, GLuint fps,
+        GLint swapInterval, double reportInterval );
+// Returns 1 when a report is due, which the caller prints.
+int FramePacerBegin( struct FramePacer *pacer );
+void FramePacerDrawn( struct FramePacer *pacer );
+// How long the current frame took from starting (after any sleep) to drawn.
+double FramePacerBusy( const struct FramePacer *pacer );
+// Print the frames since the last report and start counting afresh.
+void FramePacerReport( struct FramePacer *pacer, FILE *out );
+
+#endif // FRAMEPACER_H
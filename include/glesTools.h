@@ -0,0 +1,53 @@
+#ifndef GLESTOOLS_H
+#define GLESTOOLS_H
+
+#include <stddef.h>
+#include <GLES2/gl2.h>
+
+#ifndef GL_UNSIGNED_INT
+#define GL_UNSIGNED_INT 0x1405
+#endif
+
+// A parsed OBJ file.  Every distinct position/texCoord/normal combination used
+// by a face is one vertex.  indices holds trianglesSize triangle indices
+// followed by linesSize line indices (two corner faces and l polylines), as
+// GLuint when there are more vertices than a GLushort can address.
+struct ObjMesh
+{
+    GLuint vertexCount;
+    GLfloat *positions; // xyz
+    GLfloat *texCoords; // uv, NULL if no face has one.
+    GLfloat *normals;   // xyz, NULL if no face has one.
+
+    GLenum indexType;   // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    void *indices;
+    GLuint trianglesSize;
+    GLuint linesSize;
+};
+
+// RGBA8 pixels decoded by PngTexture.  The buffer is kept and grown as needed
+// so one PngImage can stage a series of textures.
+struct PngImage
+{
+    unsigned char *pixels;
+    size_t capacity;
+    int width;
+    int height;
+};
+
+// The shader's source, to be freed by the caller.  NULL if it couldn't be
+// read; this runs on the asset loader's threads, so it never exits.
+char * loadShader( const char * _fileName );
+float randFloat( void );
+int ParseObj( const char *data, size_t size, struct ObjMesh *mesh );
+void FreeObj( struct ObjMesh *mesh );
+// Element count, or 0 if the model couldn't be read, didn't parse or needs
+// more than GLushort elements.  Like loadShader it runs on the asset loader's
+// threads and never exits.
+GLuint loadObj( const char* _fileName, GLfloat **_vertices, GLushort **_elements );
+GLfloat * ComputeSurfaceNormals( const GLfloat *points, const GLushort
+        *elements, const GLuint elementsSize );
+int PngTexture( const char * _fileName, struct PngImage *image );
+void FreePngImage( struct PngImage *image );
+
+#endif // GLESTOOLS_H
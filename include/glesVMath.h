@@ -0,0 +1,28 @@
+#ifndef GLESVMATH_H
+#define GLESVMATH_H
+
+#include <string.h>
+#include <GLES2/gl2.h>
+
+void normalize2f( GLfloat* v );
+void UMinusV( GLfloat *_result, const GLfloat *_u, const GLfloat *_v, const
+        GLuint _dimension );
+void UPlusV( GLfloat *_result, const GLfloat *_u, const GLfloat *_v, const
+        GLuint _dimension );
+void UDotV( GLfloat *_result, const GLfloat *_u, const GLfloat *_v, const
+        GLuint _dimension );
+void scale( GLfloat *_result, const GLfloat *_vec, const GLfloat _a, const
+        GLuint dimension );
+void projectUonV2f(GLfloat *_result, const GLfloat *_u, const GLfloat *_v);
+void scalarU(GLfloat *_result, const GLfloat *_vec, GLfloat _scalar, const GLuint
+        _dimension);
+void distanceSquared(GLfloat *_result, const GLfloat *_point1, const GLfloat
+        *_point2, GLuint _dimension);
+void magnitudeSquaredU( GLfloat *_result, const GLfloat *_u, const GLuint
+        _dimension);
+void magnitudeSquaredComponents( GLfloat *_result, const GLfloat
+        _magnitudeSquared, GLfloat *_vector, GLuint _dimension );
+void reflectAboutNormal2f( GLfloat *_result, const GLfloat *_u, const GLfloat
+        *_n );
+
+#endif // GLESVMATH_H
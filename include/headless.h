@@ -0,0 +1,13 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "esUtil.h"
+
+// Create an EGL context with no window.  Mesa's surfaceless platform is tried
+// first (llvmpipe on a box without a GPU), then a pbuffer on the default
+// display.  Either way the caller renders into a RenderTarget, so width and
+// height are only recorded in esContext.
+int HeadlessCreateContext( ESContext *esContext, GLint width, GLint height );
+void HeadlessDestroyContext( ESContext *esContext );
+
+#endif // HEADLESS_H
@@ -0,0 +1,58 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <GLES2/gl2.h>
+#include "ring.h"
+
+#define INPUT_QUEUE_SIZE 64
+#define INPUT_LINE_SIZE 256
+#define INPUT_MOUSE_SCALE 0.002f // Table units per mouse count.
+#define INPUT_KEY_STEP 0.02f     // Table units per arrow key press.
+
+enum InputCommandType
+{
+    INPUT_POINT,   // "x y": a position or a velocity, whichever is asked for.
+    INPUT_PLACE,   // Put the cue ball at value[0..1].
+    INPUT_SHOOT,   // Shoot the cue ball with velocity value[0..1].
+    INPUT_MOVE,    // Nudge the position or aim being edited by value[0..1].
+    INPUT_CONFIRM,
+    INPUT_CANCEL,
+};
+
+struct InputCommand
+{
+    GLint type;
+    GLfloat value[2];
+};
+
+// Reads the player's input on its own thread so the frame loop never blocks
+// on it.  The source is stdin, a FIFO or any other text stream with one
+// command per line, or an evdev device (/dev/input/event*).  Commands reach
+// the render thread through an SPSC ring; the input thread is the only
+// producer.
+struct Input
+{
+    pthread_t thread;
+    int started;
+    int fd;
+    int evdev;
+    int wake[2];     // Written by InputStop to get the thread out of poll.
+    struct Ring commands;
+
+    // Input thread only.
+    char line[ INPUT_LINE_SIZE ];
+    size_t lineLength;
+    GLfloat move[2]; // Relative motion since the last SYN_REPORT.
+};
+
+// path NULL or "-" reads stdin.
+int InputStart( struct Input *input, const char *path );
+void InputStop( struct Input *input );
+// Returns 0 when there is nothing waiting.
+int InputPoll( struct Input *input, struct InputCommand *command );
+// Parse one line of the text protocol.  Returns 0 for anything else.
+int InputParseLine( const char *line, struct InputCommand *command );
+
+#endif // INPUT_H
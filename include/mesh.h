@@ -0,0 +1,48 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <GLES2/gl2.h>
+
+#define MESH_CACHE_MAGIC 0x4853454du // "MESH" little endian
+#define MESH_CACHE_VERSION 1u
+#define MESH_CACHE_SUFFIX ".mesh"
+
+// On disk layout of a cached mesh.  The header is followed by the vertices
+// (2 floats each), the elements and, for collision meshes, one normal per
+// line segment.  Every section starts on a 4 byte boundary so the arrays can
+// be used straight out of the mapping.
+struct MeshCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t elementsSize;
+    uint32_t normalsSize; // Floats, 0 if the mesh has no normals.
+    uint32_t verticesOffset;
+    uint32_t elementsOffset;
+    uint32_t normalsOffset;
+};
+
+struct Mesh
+{
+    GLint elementsSize;
+    GLuint vertexCount;
+    const GLfloat *v;
+    const GLushort *e;
+    const GLfloat *n;
+
+    void *map;      // Mapping of the cache file, NULL when v/e/n are malloced.
+    size_t mapSize;
+};
+
+// Loads the _fileName asset.  Embedded models are parsed from memory.  From an
+// asset directory they go through a binary cache (_fileName with the
+// extension replaced by MESH_CACHE_SUFFIX), converting the .obj first if the
+// cache is missing, stale or unreadable.  withNormals also stores the segment
+// normals used by the collision code.
+int LoadMesh( struct Mesh *mesh, const char *_fileName, int withNormals );
+void FreeMesh( struct Mesh *mesh );
+
+#endif // MESH_H
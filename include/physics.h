@@ -0,0 +1,91 @@
+#ifndef PHYSICS_H
+#define PHYSICS_H
+
+#include <GLES2/gl2.h>
+#include "table.h"
+
+// Slots in particleData.  A ball set (tableSpec.h) uses the first ones; the
+// rest stay off the table at INFINITY and the physics stops at the table's
+// ballCount.
+#define NUM_PARTICLES	24
+#define PARTICLE_SIZE   4 // Has velocity.
+#define POINT_ACCELERATION -0.2f
+#define SMALL_TIME_STEP 0.02f
+
+#define CONTACT_LIST_SIZE 32
+
+// Ball-ball contacts resolved in one step.  Equal discs in a plane can't
+// touch more than 3n - 6 times.
+#define BALL_CONTACT_MAX ( NUM_PARTICLES * 3 )
+#define BALL_SOLVER_ITERATIONS 16
+#define BALL_SOLVER_TOLERANCE 1e-5f // Speed; smaller corrections stop early.
+
+// UpdatePositions splits its step so no ball moves more than half the gap to
+// its nearest ball or cushion in one go, but always lets it move
+// SUBSTEP_MIN_TRAVEL radii and never splits into more than SUBSTEP_MAX.
+#define SUBSTEP_MAX 8
+#define SUBSTEP_MIN_TRAVEL 0.25f
+
+enum ContactType
+{
+    CONTACT_BALL,
+    CONTACT_CUSHION,
+    CONTACT_POCKET,
+};
+
+// Something a ball ran into during one step.  a and b are slots in
+// particleData; b is -1 unless two balls touched.
+struct Contact
+{
+    GLint type;
+    GLint a;
+    GLint b;
+};
+
+// Filled in by the functions below when the caller wants to know more than
+// how many contacts there were.  Contacts past CONTACT_LIST_SIZE still count
+// but aren't listed.
+struct ContactList
+{
+    GLuint count;
+    struct Contact contacts[ CONTACT_LIST_SIZE ];
+};
+
+// A touching, closing pair found at the start of a step.
+struct BallContact
+{
+    GLint a;
+    GLint b;
+    GLfloat normal[2];  // From a to b, where they first touched.
+    GLfloat rewind;     // How long before the step that was.
+    GLfloat target;     // Separating speed the solver aims for.
+    GLfloat impulse;    // Accumulated so far, never negative.
+};
+
+// Running totals UpdatePositions adds to when it's given somewhere to put
+// them.
+struct StepStats
+{
+    GLuint steps;       // UpdatePositions calls.
+    GLuint substeps;    // What they were split into.
+    GLuint capped;      // Steps that wanted more than SUBSTEP_MAX.
+};
+
+// The physics only ever touches particleData (position, velocity) so that it
+// can run away from the GL thread.  Quads are rebuilt by whoever draws.
+// The Check functions and UpdatePositions return how many ball-ball and
+// ball-cushion contacts they resolved.  contacts may be NULL; otherwise each
+// contact, and each ball that drops into a pocket, is appended to it.  Only
+// the first ballCount slots (the table's, see table.h) are looked at.
+GLuint CheckForParticleCollisions( GLfloat *particleData, GLint ballCount,
+        GLfloat radius, struct ContactList *contacts );
+GLuint CheckForBoundaryCollisions( GLfloat *particleData, GLint ballCount,
+        const GLfloat *v, const GLushort *e, GLint elementsSize,
+        const GLfloat *n, struct ContactList *contacts );
+int CheckForMovement( const GLfloat *particleData, GLint ballCount );
+// stats may be NULL.
+GLuint UpdatePositions( GLfloat *particleData, const struct Table *table,
+        float deltaTime, struct ContactList *contacts,
+        struct StepStats *stats );
+
+#endif // PHYSICS_H
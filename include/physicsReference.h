@@ -0,0 +1,33 @@
+#ifndef PHYSICSREFERENCE_H
+#define PHYSICSREFERENCE_H
+
+#include <GLES2/gl2.h>
+#include "physics.h"
+#include "table.h"
+
+// Steps per second.  32 of them to every sim tick, and no substeps.
+#define REFERENCE_RATE 7680
+
+// The same model as physics.c (ball-ball solver, cushions and pockets,
+// rolling resistance, the stopping cutoff) in double precision at a fixed,
+// very small step.  It is far too slow for the game; it is what the float
+// physics, with its bigger steps and shortcuts, gets measured against.  The
+// state is laid out like particleData.
+struct ReferenceTable
+{
+    double *boundary;      // table->boundary, widened.
+    const GLushort *e;
+    GLint elementsSize;
+    GLint ballCount;
+    double ballRadius;
+};
+
+int ReferenceTableInit( struct ReferenceTable *reference,
+        const struct Table *table );
+void ReferenceTableFree( struct ReferenceTable *reference );
+// One REFERENCE_RATE step.  Returns the contacts resolved.
+GLuint ReferenceUpdate( double *state, const struct ReferenceTable *reference );
+int ReferenceMoving( const double *state,
+        const struct ReferenceTable *reference );
+
+#endif // PHYSICSREFERENCE_H
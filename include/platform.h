@@ -0,0 +1,41 @@
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <EGL/egl.h>
+#include "esUtil.h"
+
+// Builds other than PLATFORM=rpi get esCreateWindow, esMainLoop and the rest
+// of esUtil.h's window handling from platformEgl.c instead of the VideoCore
+// esUtil.c.  platformEgl.c does the EGL side through EGL_EXT_platform_base;
+// one backend per build supplies the native display and window:
+//
+//     platformX11.c          a window on an X server
+//     platformGbm.c          a GBM surface flipped onto a KMS CRTC, no server
+//     platformSurfaceless.c  no display at all, a pbuffer on Mesa's
+//                            surfaceless platform (llvmpipe works)
+//
+// The Makefile's PLATFORM variable picks one.
+struct PlatformWindow
+{
+    EGLenum platform;       // EGL_PLATFORM_*_KHR/MESA for the display.
+    void *nativeDisplay;
+    void *nativeWindow;     // What eglCreatePlatformWindowSurfaceEXT takes;
+                            // NULL draws into a pbuffer instead.
+    EGLint visual;          // EGL_NATIVE_VISUAL_ID the config needs, or 0.
+    GLint width;            // May differ from what was asked for, e.g. the
+    GLint height;           // KMS mode's size.
+    void *backend;          // The backend's own state.
+};
+
+// Open the display and make a window for a width x height surface.
+int PlatformOpen( struct PlatformWindow *window, const char *title,
+        GLint width, GLint height );
+// Called after every eglSwapBuffers.  GBM puts the new frame on screen here.
+int PlatformPresent( struct PlatformWindow *window, EGLDisplay display,
+        EGLSurface surface );
+// Hand window system events to esContext's callbacks.  Returns 0 once the
+// window has been closed.
+int PlatformPollEvents( struct PlatformWindow *window, ESContext *esContext );
+void PlatformClose( struct PlatformWindow *window );
+
+#endif // PLATFORM_H
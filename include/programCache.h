@@ -0,0 +1,32 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <stdint.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#define PROGRAM_CACHE_MAGIC 0x47525042u // "BPRG" little endian
+#define PROGRAM_CACHE_VERSION 1u
+
+// Linked program binaries kept between runs through GL_OES_get_program_binary.
+// Files are named <driver hash>-<source hash>.bin, the driver hash covering
+// GL_VENDOR, GL_RENDERER and GL_VERSION.  Files from another driver are
+// deleted by ProgramCacheInit.
+struct ProgramCache
+{
+    int enabled;
+    char directory[ 512 ];
+    uint64_t driverHash;
+    PFNGLGETPROGRAMBINARYOESPROC getProgramBinary;
+    PFNGLPROGRAMBINARYOESPROC programBinary;
+    GLuint hits;
+    GLuint misses;
+};
+
+// Needs a current context.  Without the extension or a writable cache
+// directory ProgramCacheLoad just compiles.
+void ProgramCacheInit( struct ProgramCache *cache );
+GLuint ProgramCacheLoad( struct ProgramCache *cache, const char *vertexSource,
+        const char *fragmentSource );
+
+#endif // PROGRAMCACHE_H
@@ -0,0 +1,18 @@
+#ifndef RACK_H
+#define RACK_H
+
+#include <GLES2/gl2.h>
+#include "physics.h"
+#include "tableSpec.h"
+
+// Which ball number goes in each slot of particleData, following the table's
+// rack rule.  Slot 0 is always the cue ball and the slots past the ball set
+// keep their own number.
+void RackShuffle( const struct TableSpec *spec, GLint *ballOrder,
+        unsigned int seed );
+// Fill particleData with a racked table: balls at rest on their spots and
+// the unused slots off the table.  The cue ball's spot is usually INFINITY,
+// in hand waiting to be placed.
+void RackPositions( const struct TableSpec *spec, GLfloat *particleData );
+
+#endif // RACK_H
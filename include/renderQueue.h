@@ -0,0 +1,63 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <GLES2/gl2.h>
+#include "mesh.h"
+
+#define RENDER_QUEUE_MAX 16     // Items in one frame.
+
+enum RenderBlend
+{
+    RENDER_BLEND_OPAQUE,        // Blending off, writes depth.
+    RENDER_BLEND_ALPHA,         // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA
+    RENDER_BLEND_PREMULTIPLIED, // GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+    RENDER_BLEND_ADDITIVE,      // GL_SRC_ALPHA, GL_ONE
+};
+
+struct RenderItem;
+typedef void (*RenderDrawFunc)( void *context, const struct RenderItem *item );
+
+// One draw.  The queue binds program and texture and sets blending and depth;
+// draw sets the attributes and uniforms and issues the glDraw call.
+struct RenderItem
+{
+    const struct Mesh *mesh;    // NULL when draw has its own vertices.
+    const GLfloat *color;       // For draw, may be NULL.
+    const void *data;           // Anything else draw needs, may be NULL.
+    GLuint program;
+    GLuint texture;             // On unit 0, 0 for none.
+    int blend;
+    // Everything lies in the table's plane, so depth is a stacking order:
+    // higher layers are nearer and win the depth test through a polygon
+    // offset.
+    GLint layer;
+    RenderDrawFunc draw;
+    void *context;
+    GLuint order;               // Set by RenderQueueAdd.
+};
+
+// Draws submitted for a frame.  RenderQueueRun draws the opaque items first,
+// nearest first so hidden fragments fail the depth test early, then the
+// blended ones furthest first without writing depth.  Within a layer items
+// are grouped by program and texture, and state that is already set is not
+// set again.
+struct RenderQueue
+{
+    struct RenderItem items[ RENDER_QUEUE_MAX ];
+    GLuint count;
+
+    // Bound while running.
+    GLuint program;
+    GLuint texture;
+    int blend;
+    GLint layer;
+};
+
+void RenderQueueReset( struct RenderQueue *queue );
+// A zeroed item to fill in, NULL when the queue is full.
+struct RenderItem *RenderQueueAdd( struct RenderQueue *queue );
+// Draw and empty the queue.  Leaves blending and the depth test off and
+// depth writes on, so glClear and later draws start from a known state.
+void RenderQueueRun( struct RenderQueue *queue );
+
+#endif // RENDERQUEUE_H
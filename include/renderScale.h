@@ -0,0 +1,36 @@
+#ifndef RENDERSCALE_H
+#define RENDERSCALE_H
+
+#include <GLES2/gl2.h>
+
+#define RENDER_SCALE_MIN 0.5f   // Automatic scaling stays within these.
+#define RENDER_SCALE_MAX 1.0f
+#define RENDER_SCALE_BUDGET (1.0 / 60.0) // Frame time to fit in without --fps.
+#define RENDER_SCALE_PERIOD 15  // Frames averaged between adjustments.
+// Aim for this much of the budget; go down above HIGH, up below LOW.
+#define RENDER_SCALE_TARGET 0.8
+#define RENDER_SCALE_HIGH 0.9
+#define RENDER_SCALE_LOW 0.65
+#define RENDER_SCALE_STEP 0.1f  // Most the scale moves in one adjustment.
+
+// How much of the window's resolution the scene is drawn at.  Either fixed,
+// or adjusted every RENDER_SCALE_PERIOD frames from how long they took to
+// draw, so the frame time stays inside the budget.  Cost goes with the pixel
+// count, the square of the scale.
+struct RenderScale
+{
+    GLfloat scale;
+    int automatic;
+    double budget;          // Seconds.
+    double busyTotal;       // Since the last adjustment.
+    GLuint samples;
+    GLuint changes;
+};
+
+// scale 0 picks automatically, starting at RENDER_SCALE_MAX.
+void RenderScaleInit( struct RenderScale *renderScale, GLfloat scale,
+        double budget );
+// One frame's drawing time.  Returns 1 when the scale has changed.
+int RenderScaleUpdate( struct RenderScale *renderScale, double busy );
+
+#endif // RENDERSCALE_H
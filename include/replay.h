@@ -0,0 +1,159 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <GLES2/gl2.h>
+#include "physics.h"
+#include "ring.h"
+#include "simThread.h"
+
+#define REPLAY_MAGIC 0x4c505242u // "BRPL" little endian
+#define REPLAY_VERSION 3u
+#define REPLAY_TABLE_SIZE 64
+// Keyframes go in at the start of every shot and then this often while the
+// balls roll.  Seeking re-simulates at most this many ticks; fewer keyframes
+// make smaller files.
+#define REPLAY_KEYFRAME_TICKS ( SIM_RATE * 8 )
+#define REPLAY_COMMAND_QUEUE 256
+
+// A replay is the rack and the commands the sim was given, plus what they
+// led to: the contacts, each stamped with its tick, and full-state keyframes
+// for seeking.  Commands only ever reach the sim with every ball at rest, so
+// the time spent waiting for the player isn't recorded and the timeline is
+// sim time.
+//
+// The header names the table description the game was played on, by path and
+// by the name it gives itself; replaying loads the same file, and the wall
+// display takes replays whose table has its table's name.
+//
+// File layout: ReplayHeader, the record stream, then the index.  Records are
+// a tag byte, type in the low 3 bits and the tick delta from the previous
+// record in the high 5 (31 means a varint with the rest follows), then:
+//
+//     REPLAY_KEYFRAME  uint32 on-table mask, uint32 moving mask, x y for
+//                      each ball on the table, vx vy for each moving one
+//     REPLAY_PLACE     slot byte, float x, float y
+//     REPLAY_SHOOT     slot byte, float vx, float vy
+//     REPLAY_BALL      slot a, slot b
+//     REPLAY_CUSHION   slot
+//     REPLAY_POCKET    slot
+//
+// Floats are stored as their bits so re-simulation is exact.  Slots are
+// particleData slots; the rack seed gives the ball in each.
+enum ReplayRecordType
+{
+    REPLAY_KEYFRAME,
+    REPLAY_PLACE,
+    REPLAY_SHOOT,
+    REPLAY_BALL,
+    REPLAY_CUSHION,
+    REPLAY_POCKET,
+};
+
+struct ReplayHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t simRate;
+    uint32_t rackSeed;
+    uint32_t shotCount;
+    uint32_t tickCount;
+    uint32_t recordsOffset;
+    uint32_t recordsSize;
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    char table[ REPLAY_TABLE_SIZE ];     // Path of the description.
+    char tableName[ REPLAY_TABLE_SIZE ]; // Its name line, may be empty.
+};
+
+// One per keyframe, in tick order.  shot is the number of shots taken before
+// the keyframe's tick, so the first entry for shot n is where it starts.
+struct ReplayIndexEntry
+{
+    uint32_t tick;
+    uint32_t offset; // Into the record stream.
+    uint32_t shot;
+};
+
+// Records a game on its own thread.  The render thread hands over every
+// command it submits and the recorder replays them through the same physics
+// the sim thread uses, so recording costs the game nothing but a ring push.
+struct ReplayRecorder
+{
+    pthread_t thread;
+    int started;
+    atomic_int running;
+    struct Ring commands;     // Render thread -> recorder.
+    const char *path;
+    int dropping;             // Render thread.  Set once a command is lost.
+
+    // Recorder thread only.
+    const struct Table *table;
+    const char *tablePath;
+    const char *tableName;
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    uint32_t rackSeed;
+    GLuint tick;
+    GLuint lastRecordTick;
+    GLuint sinceKeyframe;
+    GLuint shots;
+    int failed;               // Out of memory, the stream is incomplete.
+    unsigned char *records;
+    size_t recordsSize;
+    size_t recordsCapacity;
+    struct ReplayIndexEntry *index;
+    GLuint indexCount;
+    GLuint indexCapacity;
+};
+
+int ReplayRecorderStart( struct ReplayRecorder *recorder, const char *path,
+        const char *tablePath, const char *tableName, const struct Table *table,
+        const GLfloat *particleData, uint32_t rackSeed );
+// Render thread.  Never blocks; if the recorder is a whole queue behind the
+// command is lost and the replay is cut short.
+void ReplayRecord( struct ReplayRecorder *recorder,
+        const struct SimCommand *command );
+// Finish the commands still queued and write the file.
+int ReplayRecorderStop( struct ReplayRecorder *recorder );
+
+struct Replay
+{
+    unsigned char *data;
+    size_t size;
+    struct ReplayHeader header;
+    const unsigned char *records;
+    const struct ReplayIndexEntry *index;
+};
+
+// A position in a replay and the state of the table there.
+struct ReplayCursor
+{
+    const struct Replay *replay;
+    size_t offset;           // Next record.
+    GLuint recordTick;       // Tick of the record before it.
+    GLuint tick;
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+};
+
+int ReplayLoad( struct Replay *replay, const char *path );
+void ReplayFree( struct Replay *replay );
+// Binary searches of the index.  ReplayFindShot returns NULL past the last
+// shot; ReplayFindTick never does.
+const struct ReplayIndexEntry * ReplayFindShot( const struct Replay *replay,
+        GLuint shot );
+const struct ReplayIndexEntry * ReplayFindTick( const struct Replay *replay,
+        GLuint tick );
+// Put the cursor on a keyframe.
+int ReplaySeek( struct ReplayCursor *cursor, const struct Replay *replay,
+        const struct ReplayIndexEntry *entry );
+// Re-simulate forward to tick, applying the recorded commands on the way.
+void ReplayAdvance( struct ReplayCursor *cursor, const struct Table *table,
+        GLuint tick );
+// Skip ahead to the next command without simulating, for feeding a live
+// sim.  Returns 0 at the end of the replay.
+int ReplayNextCommand( struct ReplayCursor *cursor,
+        struct SimCommand *command );
+
+#endif // REPLAY_H
@@ -0,0 +1,26 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <GLES2/gl2.h>
+
+// Single-producer single-consumer ring of fixed size elements.  One thread may
+// push while another pops without any locking.  capacity must be a power of
+// two.
+struct Ring
+{
+    unsigned char *data;
+    size_t elementSize;
+    GLuint capacity;
+    atomic_uint head; // Next slot to pop.  Written by the consumer.
+    atomic_uint tail; // Next slot to push.  Written by the producer.
+};
+
+int RingInit( struct Ring *ring, size_t elementSize, GLuint capacity );
+void RingFree( struct Ring *ring );
+int RingPush( struct Ring *ring, const void *element );
+int RingPop( struct Ring *ring, void *element );
+int RingIsEmpty( struct Ring *ring );
+
+#endif // RING_H
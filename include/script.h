@@ -0,0 +1,38 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdio.h>
+#include <GLES2/gl2.h>
+#include "table.h"
+#include "tableSpec.h"
+
+#define SCRIPT_MAX_WORKERS 16
+#define SCRIPT_MAX_SIM_TIME 600.0f // Seconds before a shot is called stuck.
+#define SCRIPT_MAX_KEYFRAMES 4096  // RunAccuracy's trajectories.
+
+// Batch mode.  A script is a text file with one command per line:
+//
+//     rack SEED      Rack a fresh table shuffled from SEED, by the table's
+//                    rack rule.
+//     place X Y      Put the cue ball at rest at X Y.
+//     shoot VX VY    Hit the cue ball and run the table to rest.
+//
+// Blank lines and lines starting with # are skipped.  Each shoot writes one
+// JSON object per line to out, in script order.  Racks are independent, so
+// they are spread over workers threads; shots within a rack run in order.
+// Returns 0 if every line parsed and every shot ran.
+int RunScript( const char *path, const struct Table *table,
+        const struct TableSpec *spec, FILE *out, GLuint workers );
+
+// Accuracy mode.  Plays the same script with the double precision reference
+// physics (physicsReference.h) and with each of the faster configurations
+// listed in script.c, every one starting each shot from the reference's
+// positions, and writes a table to out: per configuration, the median, mean
+// and worst distance between its final ball positions and the reference's,
+// how many shots pocketed a different set of balls or never came to rest,
+// and the time taken and speedup over the reference.  Runs on one thread so
+// the times compare.  Returns 0 if every line parsed and every shot ran.
+int RunAccuracy( const char *path, const struct Table *table,
+        const struct TableSpec *spec, FILE *out );
+
+#endif // SCRIPT_H
@@ -0,0 +1,93 @@
+#ifndef SHAREDSTATE_H
+#define SHAREDSTATE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Live table state in POSIX shared memory (--shared-state NAME) for viewers
+// and overlays in other processes.  The sim writes every tick into a ring of
+// slots, each guarded by a seqlock, and never looks at the readers: any
+// number of them can map the region read-only, nothing is serialized and a
+// reader that falls a ring behind just skips ahead.  Readers only need this
+// header and SharedStateOpen/Read from sharedState.c.
+
+#define SHARED_STATE_MAGIC 0x54534242u // "BBST" little endian
+#define SHARED_STATE_VERSION 3u
+#define SHARED_STATE_SLOTS 256         // Power of two.  A bit over a second.
+#define SHARED_STATE_BALLS 24         // NUM_PARTICLES
+#define SHARED_STATE_TABLE_SIZE 64    // TABLE_SPEC_NAME_SIZE
+
+// One tick.  Balls are indexed by number, 0 is the cue ball; pocketed balls
+// are at +infinity.
+struct SharedState
+{
+    uint32_t sequence;  // Publish count, the n-th tick written is n - 1.
+    uint32_t tick;      // Sim tick.
+    uint32_t moving;    // Bit per ball number.
+    uint32_t pocketed;  // Bit per ball number.
+    float balls[ SHARED_STATE_BALLS ][ 4 ]; // x, y, vx, vy
+};
+
+struct SharedStateSlot
+{
+    atomic_uint lock;   // Odd while the sim is writing the slot.
+    uint32_t padding;
+    struct SharedState state;
+};
+
+struct SharedStateRegion
+{
+    uint32_t magic;     // Written last, a reader can't see a half set up region.
+    uint32_t version;
+    uint32_t slotCount;
+    uint32_t simRate;
+    char table[ SHARED_STATE_TABLE_SIZE ]; // Name line of the table, may be empty.
+    uint32_t padding[12];
+    atomic_uint published; // Ticks written so far.  On its own cache line.
+    uint32_t padding2[15];
+    struct SharedStateSlot slots[ SHARED_STATE_SLOTS ];
+};
+
+// The sim's end.
+struct SharedStatePublisher
+{
+    int fd;
+    char name[ 64 ];
+    struct SharedStateRegion *region;
+    uint32_t published;
+
+    // Ball number of each particleData slot.  Set before the sim starts.
+    int32_t ballNumbers[ SHARED_STATE_BALLS ];
+};
+
+// Creates (or takes over) the named region.  Names look like "/billiards".
+// table is the table description's name, for readers to check against.
+int SharedStateCreate( struct SharedStatePublisher *publisher,
+        const char *name, const char *table, uint32_t simRate );
+// Sim thread.  particleData is the sim's, NUM_PARTICLES * PARTICLE_SIZE.
+void SharedStatePublish( struct SharedStatePublisher *publisher,
+        uint32_t tick, const float *particleData );
+// Unmaps and unlinks the region.  Readers keep their mappings.
+void SharedStateDestroy( struct SharedStatePublisher *publisher );
+
+// A viewer's end.
+struct SharedStateReader
+{
+    int fd;
+    const struct SharedStateRegion *region;
+    size_t size;
+    uint32_t next;      // Sequence of the next tick to read.
+    uint32_t dropped;   // Ticks skipped because the sim lapped the reader.
+};
+
+// Starts at the newest tick.
+int SharedStateOpen( struct SharedStateReader *reader, const char *name );
+// Copies out the next unread tick.  Returns 0 when there isn't one yet.
+int SharedStateRead( struct SharedStateReader *reader,
+        struct SharedState *state );
+// Skips to the newest tick, for viewers that only draw the present.
+int SharedStateLatest( struct SharedStateReader *reader,
+        struct SharedState *state );
+void SharedStateClose( struct SharedStateReader *reader );
+
+#endif // SHAREDSTATE_H
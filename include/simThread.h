@@ -0,0 +1,103 @@
+#ifndef SIMTHREAD_H
+#define SIMTHREAD_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <GLES2/gl2.h>
+#include "physics.h"
+#include "ring.h"
+#include "sharedState.h"
+
+#define SIM_RATE 240 // Physics ticks per second.
+#define SIM_MAX_CATCH_UP 0.25 // Seconds of ticks to replay after a stall.
+#define SIM_COMMAND_QUEUE_SIZE 64
+
+// The three published states.  SIM_STATE_FRESH is or'd into the shared index
+// when the sim has written a state the renderer hasn't picked up yet.
+#define SIM_STATE_COUNT 3
+#define SIM_STATE_INDEX_MASK 0x3
+#define SIM_STATE_FRESH 0x4
+
+enum SimCommandType
+{
+    SIM_COMMAND_PLACE, // Put a ball at value[0..1] at rest.
+    SIM_COMMAND_SHOOT, // Give a ball the velocity value[0..1].
+};
+
+struct SimCommand
+{
+    GLint type;
+    GLint ball;
+    GLfloat value[2];
+};
+
+// The sim after tick.  previousParticleData is where the balls were when the
+// tick began, once its commands were applied, so blending from it to
+// particleData covers exactly one step however many ticks the renderer
+// missed.
+struct SimState
+{
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLfloat previousParticleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLuint tick;
+    GLuint commandsApplied;
+    GLint moving;
+    double publishTime; // CLOCK_MONOTONIC seconds.
+    struct StepStats stats; // Since the sim started.
+};
+
+// One tick for a listener off the render thread (the control server).  Only
+// ticks where something changed are sent, plus the very first one.
+struct SimTick
+{
+    GLuint tick;
+    GLint moving;
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    struct ContactList contacts;
+};
+
+struct SimThread
+{
+    pthread_t thread;
+    atomic_int running;
+
+    const struct Table *table;
+
+    // Owned by the sim thread once started.
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLfloat tickStart[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLuint tick;
+    GLuint commandsApplied;
+    GLuint writeIndex;
+    struct StepStats stats;
+
+    // Owned by the render thread.
+    GLuint readIndex;
+
+    // Lock-free triple buffer.  The sim always has a buffer to write and the
+    // renderer always has a complete buffer to read; neither ever waits.
+    struct SimState states[ SIM_STATE_COUNT ];
+    atomic_uint sharedIndex;
+
+    // Render thread -> sim thread.
+    struct Ring commands;
+
+    // Sim thread -> listener, of struct SimTick.  Optional, set before
+    // SimThreadStart.  Ticks are dropped if the listener falls behind.
+    struct Ring *ticks;
+
+    // Every tick also goes here for other processes.  Optional, set before
+    // SimThreadStart.
+    struct SharedStatePublisher *shared;
+};
+
+double SimThreadNow( void );
+int SimThreadStart( struct SimThread *sim, const struct Table *table, const
+        GLfloat *particleData );
+void SimThreadStop( struct SimThread *sim );
+const struct SimState * SimThreadLatest( struct SimThread *sim );
+int SimThreadSubmit( struct SimThread *sim, const struct SimCommand *command );
+// What the sim thread does with a command, for anything replaying them.
+void SimApplyCommand( GLfloat *particleData, const struct SimCommand *command );
+
+#endif // SIMTHREAD_H
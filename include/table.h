@@ -0,0 +1,24 @@
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <GLES2/gl2.h>
+#include "mesh.h"
+
+// Which models, how big and what balls are all in the table description,
+// see tableSpec.h.  TODO: Use a texture for all but collision.
+struct Table
+{
+    struct Mesh table;
+    struct Mesh rails;
+    struct Mesh holes;
+    struct Mesh ticks;
+    struct Mesh collision;
+
+    // Set by TableSpecApply.  boundary is collision.v scaled to the table's
+    // size.
+    GLint ballCount;            // Slots in particleData the physics steps.
+    GLfloat ballRadius;
+    const GLfloat *boundary;
+};
+
+#endif // TABLE_H
@@ -0,0 +1,75 @@
+#ifndef TABLESPEC_H
+#define TABLESPEC_H
+
+#include <GLES2/gl2.h>
+#include "arena.h"
+#include "physics.h"
+#include "table.h"
+
+#define TABLE_SPEC_DEFAULT "table/pool-9ft.table"
+#define TABLE_SPEC_NAME_SIZE 64
+
+enum TableModel
+{
+    TABLE_MODEL_TABLE,
+    TABLE_MODEL_RAILS,
+    TABLE_MODEL_HOLES,
+    TABLE_MODEL_TICKS,
+    TABLE_MODEL_COLLISION,
+    TABLE_MODEL_COUNT,
+};
+
+enum RackRule
+{
+    RACK_FIXED,      // Every ball on its own spot.
+    RACK_EIGHT_BALL, // 8 in the middle, a stripe and a solid in the corners.
+    RACK_SHUFFLE,    // Object balls shuffled, except the ones in keep.
+};
+
+struct TableSpecBall
+{
+    char sprite[ TABLE_SPEC_NAME_SIZE ];
+    GLfloat spot[2]; // INFINITY when the ball starts in hand.
+};
+
+// A table and the balls played on it, read from a description under table/
+// like the ones the game ships:
+//
+//     name 8-ball, 9 ft
+//     models model/table.obj model/rails.obj - model/ticks.obj model/collision.obj
+//     scale 1.0              every model is scaled by this
+//     size 1.48378 0.74189   half length and half width inside the cushions
+//     headString -0.76406    the break is placed behind this x
+//     radius 0.024
+//     rack eight-ball        or fixed, or shuffle [number...] to keep
+//     ball 0 - -             sprite and spot, in ball number order
+//     ball 1 0.84406 0
+//
+// Models are listed table, rails, holes, ticks, collision; "-" leaves one
+// out (not the collision mesh).  Ball n starts on the n-th spot before the
+// rack rule shuffles them; ball 0 is the cue ball and its spot may be "-".
+// Positions are in table units after scaling.  The particleData slots past
+// ballCount stay off the table.
+struct TableSpec
+{
+    char name[ TABLE_SPEC_NAME_SIZE ];
+    char models[ TABLE_MODEL_COUNT ][ TABLE_SPEC_NAME_SIZE ];
+    GLfloat scale;
+    GLfloat size[2];
+    GLfloat headString;
+    GLfloat ballRadius;
+    GLint rack;
+    GLuint keep;      // RACK_SHUFFLE: bit per ball number left on its spot.
+    GLint ballCount;
+    struct TableSpecBall balls[ NUM_PARTICLES ];
+};
+
+int LoadTableSpec( struct TableSpec *spec, const char *_fileName );
+// What TableSpecApply takes from the arena.
+size_t TableSpecArenaSize( const struct TableSpec *spec,
+        const struct Table *table );
+// Set up table for the physics once its collision mesh has loaded.
+int TableSpecApply( const struct TableSpec *spec, struct Table *table,
+        struct Arena *arena );
+
+#endif // TABLESPEC_H
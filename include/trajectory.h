@@ -0,0 +1,44 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+#include <GLES2/gl2.h>
+#include "physics.h"
+
+#define TRAJECTORY_STEP (1.0f / 960.0f) // Contact detection step.
+#define TRAJECTORY_MAX_TIME 120.0f
+#define TRAJECTORY_STOP_SPEED 0.01f     // UpdatePositions' cutoff.
+#define TRAJECTORY_POCKETED 100.0f      // Off screen, in place of INFINITY.
+
+// Start of one piece of a ball's path.  Between contacts a ball decays
+// exponentially, v(t) = v0 e^(at), each component stopping once it drops
+// below TRAJECTORY_STOP_SPEED, so position has a closed form.
+struct Keyframe
+{
+    GLfloat time;
+    GLfloat position[2];
+    GLfloat velocity[2];
+};
+
+// A whole shot, worked out before it is shown.  Each ball's keyframes are
+// contiguous and in time order.
+struct Trajectory
+{
+    struct Keyframe *keyframes;
+    struct Keyframe *scratch;
+    GLint *owner;
+    GLuint keyframeCount;
+    GLuint maxKeyframes;
+    GLuint first[ NUM_PARTICLES ];
+    GLuint count[ NUM_PARTICLES ];
+    GLfloat duration;
+    GLfloat finalParticleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+};
+
+int TrajectoryInit( struct Trajectory *trajectory, GLuint maxKeyframes );
+void TrajectoryFree( struct Trajectory *trajectory );
+int BuildTrajectory( struct Trajectory *trajectory, const GLfloat
+        *particleData, const struct Table *table );
+void EvaluateKeyframe( const struct Keyframe *keyframe, GLfloat time,
+        GLfloat *position, GLfloat *velocity );
+
+#endif // TRAJECTORY_H
@@ -0,0 +1,36 @@
+#ifndef VIDEOOUT_H
+#define VIDEOOUT_H
+
+#include <stdio.h>
+#include <GLES2/gl2.h>
+#include "frameCapture.h"
+
+enum VideoFormat
+{
+    VIDEO_Y4M, // YUV4MPEG2, 4:2:0 full range.
+    VIDEO_RGB, // Headerless packed RGB24, top row first.
+};
+
+// A stream of frames written to a file, pipe or FIFO for an external encoder
+// to consume.  Frames must arrive in order, so it is fed by a FrameCapture
+// with exactly one worker.
+struct VideoOut
+{
+    FILE *file;
+    int format;
+    GLint width;
+    GLint height;
+    GLuint fps;
+    unsigned char *buffer; // One converted frame, reused.
+    size_t frameSize;
+    int failed;
+};
+
+int VideoOutOpen( struct VideoOut *video, const char *path, int format,
+        GLint width, GLint height, GLuint fps );
+void VideoOutClose( struct VideoOut *video );
+
+// FrameEncodeFunc.  encodeData is the VideoOut.
+void FrameEncodeVideo( struct FrameCapture *capture, struct Frame *frame );
+
+#endif // VIDEOOUT_H
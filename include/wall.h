@@ -0,0 +1,82 @@
+#ifndef WALL_H
+#define WALL_H
+
+#include <GLES2/gl2.h>
+#include "physics.h"
+#include "simThread.h"
+#include "replay.h"
+#include "sharedState.h"
+#include "table.h"
+#include "tableSpec.h"
+
+#define WALL_MAX_TABLES 16
+#define WALL_REPLAY_PAUSE 2.0 // Seconds at rest before a replay starts over.
+
+// One of the other tables on a wall display.  Each either follows another
+// game's --shared-state ring, or has a sim of its own and plays a replay over
+// and over, or sits at its rack without one.  The render thread reads it like
+// the game's table: currentState is the newest tick and particleData is
+// blended across it.
+struct WallTable
+{
+    struct SharedStateReader *live; // NULL runs the sim below.
+    double liveEpoch;               // Our clock at the live game's tick 0.
+    GLuint liveTicks;               // Read so far.
+
+    struct SimThread sim;
+    struct SimState currentState;
+    GLuint commandsSubmitted;
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+
+    const struct Replay *replay;    // NULL sits at the rack.
+    struct ReplayCursor cursor;
+    unsigned int rackSeed;          // Gives the ball in each slot.
+    double restTime;                // When the replay ran out, 0 before.
+};
+
+// --wall: a grid of tables in one window.  Table 0 is the game, which
+// UserData keeps as it always has; tables[0] is the wall's table 1.  All of
+// them share the game's table description and geometry.
+struct Wall
+{
+    GLuint count;                   // Tables including the game's, 1 is off.
+    GLuint columns;
+    GLuint rows;
+    // Per table, where it goes in clip space: offset x, offset y and the
+    // scale for both.  The vertex shaders index it by a_cell.
+    GLfloat cells[ WALL_MAX_TABLES * 4 ];
+
+    struct SharedStateReader live[ WALL_MAX_TABLES - 1 ];
+    GLuint liveCount;               // The first tables after the game's.
+    struct Replay replays[ WALL_MAX_TABLES - 1 ];
+    GLuint replayCount;
+    struct WallTable tables[ WALL_MAX_TABLES - 1 ];
+    GLuint started;                 // Tables set up, for WallStop.
+};
+
+// Grid the count tables as squarely as they go, each the same size and kept
+// in proportion.
+void WallLayout( struct Wall *wall, GLuint count );
+// Replays must have been recorded on a table with spec's name.  The tables
+// take them in turn, so there can be fewer replays than tables.
+int WallLoadReplays( struct Wall *wall, const char * const *paths,
+        GLuint pathCount, const struct TableSpec *spec );
+// The named --shared-state regions, which must be publishing spec's table at
+// SIM_RATE.  Each gets a table of its own.
+int WallOpenLive( struct Wall *wall, const char * const *names,
+        GLuint nameCount, const struct TableSpec *spec );
+// Rack and start the other tables.  The live ones come first, the rest take
+// the replays in turn; tables without either are racked from seed.
+int WallStart( struct Wall *wall, const struct Table *table,
+        const struct TableSpec *spec, unsigned int seed );
+// Render thread, for a live table: read every tick published since the last
+// call into currentState.
+void WallPoll( struct WallTable *table, GLint ballCount );
+// Render thread, once currentState is fresh.  When the table has come to
+// rest, hand its sim the replay's commands up to the next shot, or rack
+// again once the replay has run out.
+void WallFeed( struct WallTable *table, GLint ballCount );
+// Stop the sims, close the live regions and free the replays.
+void WallStop( struct Wall *wall );
+
+#endif // WALL_H
@@ -1,15 +1,58 @@
+// MAX_KEYFRAMES is defined by the loader to fit GL_MAX_VERTEX_UNIFORM_VECTORS.
 uniform float u_time;
 uniform mat4 u_MVP;
 attribute vec2 a_startPosition;
 attribute vec2 a_texCoords;
 varying vec2 v_texCoords;
 
+// Wall display, as in table.vert.
+uniform vec4 u_cells[ MAX_CELLS ];
+attribute float a_cell;
+
+// Shot playback.  Each ball's path is a run of keyframes (position.xy,
+// velocity.zw, start time) between contacts.  a_keyframes is the ball's
+// (first, count) and a_startPosition is then the corner's offset from the
+// ball's centre.
+uniform bool u_playback;
+uniform vec4 u_keyframes[ MAX_KEYFRAMES ];
+uniform float u_keyframeTimes[ MAX_KEYFRAMES ];
+attribute vec2 a_keyframes;
+
+const float ACCELERATION = -0.2;
+const float STOP_SPEED = 0.01;
+
+vec2 PlaybackPosition( void )
+{
+    int first = int( a_keyframes.x );
+    int index = first;
+    for ( int i = 1 ; i < MAX_KEYFRAMES ; ++i ) {
+        if ( float( i ) >= a_keyframes.y ||
+             u_keyframeTimes[ first + i ] > u_time ) {
+            break;
+        }
+        index = first + i;
+    }
+
+    vec4 keyframe = u_keyframes[ index ];
+    float tau = max( u_time - u_keyframeTimes[ index ], 0.0 );
+    // Each component stops once it has decayed to STOP_SPEED.
+    vec2 speed = max( abs( keyframe.zw ), vec2( STOP_SPEED ) );
+    vec2 t = min( vec2( tau ), log( speed / STOP_SPEED ) / -ACCELERATION );
+    return keyframe.xy + keyframe.zw * (exp( ACCELERATION * t ) - 1.0) /
+           ACCELERATION;
+}
+
 void main( void )
 {
     gl_Position.xy = a_startPosition;
+    if ( u_playback ) {
+        gl_Position.xy += PlaybackPosition();
+    }
     gl_Position.z = 0.0;
     gl_Position.w = 1.0;
     gl_Position = u_MVP * gl_Position;
+    vec4 cell = u_cells[ int( a_cell ) ];
+    gl_Position.xy = gl_Position.xy * cell.zw + cell.xy * gl_Position.w;
 
     v_texCoords = a_texCoords;
 }
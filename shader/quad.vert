@@ -1,9 +1,12 @@
 attribute vec2 a_position;
 attribute vec2 a_texCoord;
+// Texture coordinates scale (xy) and offset (zw), for sampling part of the
+// texture.
+uniform vec4 u_texTransform;
 varying vec2 v_texCoord;
 
 void main()
 {
-    v_texCoord = a_texCoord;
+    v_texCoord = a_texCoord * u_texTransform.xy + u_texTransform.zw;
     gl_Position = vec4(a_position, 0.0, 1.0);
 }
@@ -1,10 +1,18 @@
 uniform mat4 u_MVP;
 attribute vec2 a_startPosition;
 
+// MAX_CELLS is defined by the loader.  A wall display draws every table at
+// once, a_cell picking each vertex's table: u_cells has where the table goes
+// in clip space, offset.xy and scale.zw.  One table is cell 0, left as is.
+uniform vec4 u_cells[ MAX_CELLS ];
+attribute float a_cell;
+
 void main( void )
 {
     gl_Position.xy = a_startPosition;
     gl_Position.z = 0.0;
     gl_Position.w = 1.0;
     gl_Position = u_MVP * gl_Position;
+    vec4 cell = u_cells[ int( a_cell ) ];
+    gl_Position.xy = gl_Position.xy * cell.zw + cell.xy * gl_Position.w;
 }
@@ -0,0 +1,46 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+size_t ArenaSize( size_t size )
+{
+    return ( size + ARENA_ALIGN - 1 ) & ~(size_t) ( ARENA_ALIGN - 1 );
+}
+
+int ArenaInit( struct Arena *arena, size_t size )
+{
+    arena->size = ArenaSize( size );
+    arena->used = 0;
+    arena->base = NULL;
+    if ( arena->size > 0 && posix_memalign( (void **) &arena->base,
+                ARENA_ALIGN, arena->size ) != 0 ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        arena->base = NULL;
+        arena->size = 0;
+        return 0;
+    }
+    return 1;
+}
+
+void * ArenaAlloc( struct Arena *arena, size_t size )
+{
+    size = ArenaSize( size );
+    if ( size > arena->size - arena->used ) {
+        fprintf( stderr, "%s: Arena of %zu bytes is full (%zu used, %zu more "
+                "wanted)\n", __FILE__, arena->size, arena->used, size );
+        return NULL;
+    }
+    void *block = arena->base + arena->used;
+    arena->used += size;
+    memset( block, 0, size );
+    return block;
+}
+
+void ArenaFree( struct Arena *arena )
+{
+    free( arena->base );
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "assetLoader.h"
+
+struct TimelineEvent
+{
+    const char *label;
+    double time;
+};
+
+static struct TimelineEvent timeline[ TIMELINE_MAX_EVENTS ];
+static GLuint timelineCount = 0;
+static double timelineOrigin = -1.0;
+static pthread_mutex_t timelineLock = PTHREAD_MUTEX_INITIALIZER;
+
+double TimelineNow( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void TimelineMark( const char *label )
+{
+    double now = TimelineNow();
+    pthread_mutex_lock( &timelineLock );
+    if ( timelineOrigin < 0.0 ) {
+        timelineOrigin = now;
+    }
+    if ( timelineCount < TIMELINE_MAX_EVENTS ) {
+        timeline[timelineCount].label = label;
+        timeline[timelineCount].time = now;
+        ++timelineCount;
+    }
+    pthread_mutex_unlock( &timelineLock );
+}
+
+void TimelineReport( FILE *file, const struct AssetLoader *loader )
+{
+    GLuint i;
+    pthread_mutex_lock( &timelineLock );
+    fprintf( file, "Startup timeline (ms):\n" );
+    for ( i = 0 ; i < timelineCount ; ++i ) {
+        double at = ( timeline[i].time - timelineOrigin ) * 1000.0;
+        double delta = i ? ( timeline[i].time - timeline[i-1].time ) * 1000.0 :
+            0.0;
+        fprintf( file, "  %8.2f  +%7.2f  %s\n", at, delta, timeline[i].label );
+    }
+    if ( loader != NULL ) {
+        for ( i = 0 ; i < loader->jobCount ; ++i ) {
+            const struct AssetJob *job = &loader->jobs[i];
+            fprintf( file, "  %8.2f  %8.2f  worker %u %s%s\n",
+                    ( job->start - timelineOrigin ) * 1000.0,
+                    ( job->end - job->start ) * 1000.0, job->worker,
+                    job->name, job->ok ? "" : " (failed)" );
+        }
+    }
+    pthread_mutex_unlock( &timelineLock );
+}
+
+static struct AssetJob * AddJob( struct AssetLoader *loader,
+        enum AssetJobType type, const char *name )
+{
+    if ( loader->jobCount >= ASSET_LOADER_MAX_JOBS ) {
+        fprintf( stderr, "%s: Too many jobs, raise ASSET_LOADER_MAX_JOBS\n",
+                __FILE__ );
+        exit(1);
+    }
+    struct AssetJob *job = &loader->jobs[ loader->jobCount++ ];
+    memset( job, 0, sizeof(*job) );
+    job->type = type;
+    job->name = name;
+    return job;
+}
+
+void AssetLoaderAddShader( struct AssetLoader *loader, const char *name )
+{
+    AddJob( loader, ASSET_JOB_SHADER, name );
+}
+
+void AssetLoaderAddMesh( struct AssetLoader *loader, const char *name,
+        struct Mesh *mesh, int withNormals )
+{
+    struct AssetJob *job = AddJob( loader, ASSET_JOB_MESH, name );
+    job->mesh = mesh;
+    job->withNormals = withNormals;
+}
+
+void AssetLoaderAddPng( struct AssetLoader *loader, const char *name )
+{
+    AddJob( loader, ASSET_JOB_PNG, name );
+}
+
+static void RunJob( struct AssetJob *job )
+{
+    switch ( job->type ) {
+        case ASSET_JOB_SHADER:
+            job->source = loadShader( job->name );
+            job->ok = job->source != NULL;
+            break;
+        case ASSET_JOB_MESH:
+            job->ok = LoadMesh( job->mesh, job->name, job->withNormals );
+            break;
+        case ASSET_JOB_PNG:
+            job->ok = PngTexture( job->name, &job->image );
+            break;
+    }
+}
+
+static void * AssetLoaderWorker( void *arg )
+{
+    struct AssetWorker *worker = arg;
+    struct AssetLoader *loader = worker->loader;
+    for ( ;; ) {
+        GLuint next = atomic_fetch_add( &loader->nextJob, 1 );
+        if ( next >= loader->jobCount ) {
+            return NULL;
+        }
+        struct AssetJob *job = &loader->jobs[next];
+        job->worker = worker->index;
+        job->start = TimelineNow();
+        RunJob( job );
+        job->end = TimelineNow();
+
+        pthread_mutex_lock( &loader->lock );
+        job->done = 1;
+        pthread_cond_broadcast( &loader->jobDone );
+        pthread_mutex_unlock( &loader->lock );
+    }
+}
+
+int AssetLoaderStart( struct AssetLoader *loader, GLuint workerCount )
+{
+    GLuint i;
+    if ( workerCount < 1 ) {
+        workerCount = 1;
+    } else if ( workerCount > ASSET_LOADER_MAX_WORKERS ) {
+        workerCount = ASSET_LOADER_MAX_WORKERS;
+    }
+    atomic_init( &loader->nextJob, 0 );
+    pthread_mutex_init( &loader->lock, NULL );
+    pthread_cond_init( &loader->jobDone, NULL );
+
+    loader->workerCount = 0;
+    for ( i = 0 ; i < workerCount ; ++i ) {
+        loader->workerArgs[i].loader = loader;
+        loader->workerArgs[i].index = i;
+        if ( pthread_create( &loader->workers[i], NULL, AssetLoaderWorker,
+                &loader->workerArgs[i] ) != 0 ) {
+            fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+            break;
+        }
+        ++loader->workerCount;
+    }
+    if ( loader->workerCount == 0 ) {
+        // No threads to be had, load everything right here instead.
+        loader->workerArgs[0].loader = loader;
+        loader->workerArgs[0].index = 0;
+        AssetLoaderWorker( &loader->workerArgs[0] );
+    }
+    return 1;
+}
+
+struct AssetJob * AssetLoaderWait( struct AssetLoader *loader,
+        const char *name )
+{
+    GLuint i;
+    for ( i = 0 ; i < loader->jobCount ; ++i ) {
+        if ( strcmp( loader->jobs[i].name, name ) == 0 ) {
+            break;
+        }
+    }
+    if ( i == loader->jobCount ) {
+        fprintf( stderr, "%s: %s was never queued\n", __FILE__, name );
+        return NULL;
+    }
+    struct AssetJob *job = &loader->jobs[i];
+    pthread_mutex_lock( &loader->lock );
+    while ( !job->done ) {
+        pthread_cond_wait( &loader->jobDone, &loader->lock );
+    }
+    pthread_mutex_unlock( &loader->lock );
+    return job->ok ? job : NULL;
+}
+
+///
+// Wait for every job, stop the workers and drop anything nobody picked up.
+//
+void AssetLoaderFinish( struct AssetLoader *loader )
+{
+    GLuint i;
+    for ( i = 0 ; i < loader->workerCount ; ++i ) {
+        pthread_join( loader->workers[i], NULL );
+    }
+    pthread_mutex_destroy( &loader->lock );
+    pthread_cond_destroy( &loader->jobDone );
+    for ( i = 0 ; i < loader->jobCount ; ++i ) {
+        free( loader->jobs[i].source );
+        loader->jobs[i].source = NULL;
+        FreePngImage( &loader->jobs[i].image );
+    }
+}
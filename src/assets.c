@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+
+static const char *assetDirectory = NULL;
+
+void AssetSetDirectory( const char *directory )
+{
+    assetDirectory = directory;
+}
+
+const char * AssetDirectory( void )
+{
+    return assetDirectory;
+}
+
+int AssetPath( const char *name, char *path, size_t size )
+{
+    int written = assetDirectory ?
+        snprintf( path, size, "%s/%s", assetDirectory, name ) :
+        snprintf( path, size, "%s", name );
+    return written > 0 && (size_t)written < size;
+}
+
+static int CompareAsset( const void *key, const void *element )
+{
+    return strcmp( key, ((const struct Asset *)element)->name );
+}
+
+static int ReadFile( const char *path, struct AssetData *asset )
+{
+    FILE *inputFile = fopen( path, "rb" );
+    if ( inputFile == NULL ) {
+        return 0;
+    }
+    fseek( inputFile, 0, SEEK_END );
+    long fileSize = ftell( inputFile );
+    rewind( inputFile );
+
+    unsigned char *buffer = malloc( fileSize + 1 );
+    if ( buffer == NULL ||
+            fread( buffer, 1, fileSize, inputFile ) != (size_t)fileSize ) {
+        fprintf( stderr, "%s: Read error %s\n", __FILE__, path );
+        free( buffer );
+        fclose( inputFile );
+        return 0;
+    }
+    fclose( inputFile );
+    buffer[fileSize] = '\0';
+    asset->data = buffer;
+    asset->size = fileSize;
+    asset->buffer = buffer;
+    return 1;
+}
+
+static int ReadAsset( const char *name, struct AssetData *asset )
+{
+    char path[512];
+    return AssetPath( name, path, sizeof(path) ) && ReadFile( path, asset );
+}
+
+int AssetOpen( const char *name, struct AssetData *asset )
+{
+    memset( asset, 0, sizeof(*asset) );
+    if ( assetDirectory != NULL ) {
+        if ( ReadAsset( name, asset ) ) {
+            return 1;
+        }
+    } else {
+        const struct Asset *embedded = bsearch( name, embeddedAssets,
+                embeddedAssetCount, sizeof(struct Asset), CompareAsset );
+        if ( embedded != NULL ) {
+            asset->data = embedded->data;
+            asset->size = embedded->size;
+            return 1;
+        }
+    }
+
+    // Not one of the assets, so a file of the user's such as a new table.
+    if ( ReadFile( name, asset ) ) {
+        return 1;
+    }
+    if ( assetDirectory != NULL ) {
+        fprintf( stderr, "%s: Error Loading %s/%s\n", __FILE__,
+                assetDirectory, name );
+    } else {
+        fprintf( stderr, "%s: %s is not embedded or a file\n", __FILE__,
+                name );
+    }
+    return 0;
+}
+
+void AssetClose( struct AssetData *asset )
+{
+    free( asset->buffer );
+    memset( asset, 0, sizeof(*asset) );
+}
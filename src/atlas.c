@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "atlas.h"
+#include "assets.h"
+
+int LoadAtlas( struct Atlas *atlas, const char *_fileName )
+{
+    struct AssetData asset;
+    if ( !AssetOpen( _fileName, &asset ) ) {
+        return 0;
+    }
+    memset( atlas, 0, sizeof(*atlas) );
+
+    const char *line = (const char *)asset.data;
+    GLuint lineNumber = 1;
+    int ok = 1;
+    while ( ok && *line != '\0' ) {
+        char name[ ATLAS_NAME_SIZE ];
+        GLfloat uv[4];
+        if ( sscanf( line, "size %d %d", &atlas->width,
+                    &atlas->height ) == 2 ) {
+        } else if ( sscanf( line, "premultiplied %d",
+                    &atlas->premultiplied ) == 1 ) {
+        } else if ( sscanf( line, "level %63s", name ) == 1 ) {
+            ok = atlas->levelCount < ATLAS_MAX_LEVELS;
+            if ( ok ) {
+                strcpy( atlas->levels[ atlas->levelCount++ ], name );
+            }
+        } else if ( sscanf( line, "sprite %63s %f %f %f %f", name, &uv[0],
+                    &uv[1], &uv[2], &uv[3] ) == 5 ) {
+            ok = atlas->spriteCount < ATLAS_MAX_SPRITES;
+            if ( ok ) {
+                struct AtlasSprite *sprite =
+                    &atlas->sprites[ atlas->spriteCount++ ];
+                strcpy( sprite->name, name );
+                memcpy( sprite->uv, uv, sizeof(uv) );
+            }
+        }
+        // Anything else (comments, "clean") is informational.
+        const char *next = strchr( line, '\n' );
+        if ( next == NULL ) {
+            break;
+        }
+        line = next + 1;
+        ++lineNumber;
+    }
+    AssetClose( &asset );
+
+    if ( !ok || atlas->width <= 0 || atlas->height <= 0 ||
+            atlas->levelCount == 0 ) {
+        fprintf( stderr, "%s: Bad atlas %s (line %u)\n", __FILE__, _fileName,
+                lineNumber );
+        return 0;
+    }
+    return 1;
+}
+
+const struct AtlasSprite * AtlasFind( const struct Atlas *atlas,
+        const char *name )
+{
+    GLuint i;
+    for ( i = 0 ; i < atlas->spriteCount ; ++i ) {
+        if ( strcmp( atlas->sprites[i].name, name ) == 0 ) {
+            return &atlas->sprites[i];
+        }
+    }
+    return NULL;
+}
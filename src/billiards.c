@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include "esUtil.h"
 #include "glesTools.h"
@@ -7,38 +8,51 @@
 #include <sys/time.h>
 #include "defines.h"
 #include <time.h>
+#include <unistd.h>
+#include "physics.h"
+#include "simThread.h"
+#include "table.h"
+#include "headless.h"
+#include "frameCapture.h"
+#include "videoOut.h"
+#include "trajectory.h"
+#include "assets.h"
+#include "assetLoader.h"
+#include "atlas.h"
+#include "programCache.h"
+#include "input.h"
+#include "rack.h"
+#include "script.h"
+#include "controlServer.h"
+#include "replay.h"
+#include "sharedState.h"
+#include "arena.h"
+#include "tableSpec.h"
+#include "framePacer.h"
+#include "renderScale.h"
+#include "renderQueue.h"
+#include "wall.h"
 
-#define NUM_PARTICLES	16
-#define PARTICLE_SIZE   4 // Has velocity.
 #define PARTICLE_QUAD_SIZE 24 // Doesn't have velocity.  Has texture coords.
 #define RENDER_TO_TEX_WIDTH 256
 #define RENDER_TO_TEX_HEIGHT 256
-#define POINT_RADIUS 0.024f
-#define POINT_ACCELERATION -0.2f
-#define PATICLES_QUAD_HALF_SIDELENGTH .03f
-#define TEXTURE_ATLAS_SIDE_LENGTH 256
-#define TEXTURE_ATLAS_IMAGE_SIZE 64
-#define SMALL_TIME_STEP 0.02f
+#define BALL_QUAD_SCALE 1.25f // Quad half side over the ball radius.
+#define BALL_ATLAS "texture/balls.atlas"
 
 #define TABLE_SIDE_LENGTH 0.75f
 
-#define BALL_SIZE 0.04f
 #define POINT_SIZE 30.0f
 
-// TODO: Use a texture for all but collision.
-#define TABLE_MODEL "model/table.obj"
-#define RAILS_MODEL "model/rails.obj"
-#define HOLES_MODEL "model/holes.obj"
-#define TICKS_MODEL "model/ticks.obj"
-#define COLLISION_MODEL "model/collision.obj"
+#define DEFAULT_WIDTH 1920
+#define DEFAULT_HEIGHT 1080
+#define CAPTURE_DEFAULT_WORKERS 2
+#define VIDEO_DEFAULT_FPS 60
 
-#define RAILS_INNER_HEIGHT 0.74189f
-
-#define H_TICK 0.38203f
-#define V_TICK 0.39463f
-
-#define WIDTH  1.48378f
-#define HEIGHT 0.74189f
+// Uniform vectors the particle vertex shader needs besides the keyframes and
+// the wall's cells, which take one per table.
+#define PLAYBACK_RESERVED_UNIFORMS 8
+#define PLAYBACK_MAX_KEYFRAMES 512
+#define PLAYBACK_VERTEX_SIZE 6 // corner offset, texture coords, keyframes.
 
 struct ball
 {
@@ -67,27 +81,66 @@ struct Quad
     GLshort *e;
 };
 
-struct Table
+// An offscreen colour + depth framebuffer.
+struct RenderTarget
 {
-    GLint tableElementsSize;
-    GLint railsElementsSize;
-    GLint holesElementsSize;
-    GLint ticksElementsSize;
-    GLint collisionElementsSize;
+    GLuint framebuffer;
+    GLuint colorTexture;
+    GLuint depthRenderbuffer;
+    GLint width;
+    GLint height;
+};
 
-    GLfloat *vTable;
-    GLfloat *vRails;
-    GLfloat *vHoles;
-    GLfloat *vTicks;
-    GLfloat *vCollision;
+struct Options
+{
+    int headless;
+    GLint width;
+    GLint height;
+    GLuint frames;          // Headless only.  0 runs until killed.
+    const char *captureDirectory;
+    FrameEncodeFunc captureEncode;
+    GLuint captureWorkers;
+    const char *videoPath;  // "-" is stdout.
+    int videoFormat;
+    GLuint videoFps;
+    int gpuPlayback;
+    GLuint fps;             // 0 leaves the rate to the swap.
+    GLint swapInterval;     // < 0 keeps the platform's default.
+    double frameStatsInterval; // Seconds, 0 reports only at exit.
+    GLfloat renderScale;    // 1 draws straight to the window, 0 is automatic.
+    const char *inputPath;  // NULL is stdin.
+    const char *scriptPath; // Batch mode, see script.h.
+    const char *resultsPath;
+    int accuracy;           // --script against the reference physics.
+    const char *controlPath; // Unix socket, see controlProtocol.h.
+    const char *sharedStateName; // POSIX shm, see sharedState.h.
+    const char *recordPath;
+    const char *replayPath;
+    const char *tablePath;  // See tableSpec.h.
+    GLuint replayShot;      // 1 is the first shot, 0 starts at the rack.
+    double replayTime;      // Sim seconds, < 0 when not seeking by time.
+    GLuint wall;            // Tables in the window, see wall.h.
+    const char *wallReplays[ WALL_MAX_TABLES - 1 ];
+    GLuint wallReplayCount;
+    const char *wallLive[ WALL_MAX_TABLES - 1 ]; // --shared-state names.
+    GLuint wallLiveCount;
+};
 
-    GLushort *eTable;
-    GLushort *eRails;
-    GLushort *eHoles;
-    GLushort *eTicks;
-    GLushort *eCollision;
+// Stacking of the draws in the table's plane, see RenderItem.
+enum RenderLayer
+{
+    LAYER_TABLE,
+    LAYER_RAILS,
+    LAYER_HOLES,
+    LAYER_TICKS,
+    LAYER_BALLS,
+};
 
-    GLfloat *nCollision;
+enum PlayState
+{
+    PLAY_WAITING, // For the sim to settle.  Input stays queued.
+    PLAY_PLACING, // For a cue ball position and a confirm.
+    PLAY_AIMING,  // For a shot.
 };
 
 typedef struct
@@ -105,14 +158,24 @@ typedef struct
     GLint particlesTimeLoc;
     GLint particlesColorLoc;
     GLint particlesSamplerLoc;
+    GLint particlesPlaybackLoc;
+    GLint particlesKeyframesLoc;
+    GLint particlesKeyframeTimesLoc;
+    GLint particlesKeyframeRangeLoc;
 
     // Particles Texture handle
     GLuint particlesTextureId;
-
-    // Particles vertex data
-    float particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
-    float particleQuadData[ NUM_PARTICLES * PARTICLE_QUAD_SIZE ];
-    struct ball balls[ NUM_PARTICLES ];
+    struct Atlas ballAtlas; // Sprites named by ball number.
+
+    // Particles vertex data.  particleData is the render thread's copy,
+    // interpolated between the two newest states the sim published; it has
+    // every slot, the quads and balls only the table's ballCount.  All three
+    // are carved out of arena.
+    float *particleData;
+    float *particleQuadData;
+    struct ball *balls;     // By ball number.
+    GLint ballCount;
+    GLfloat ballHalfSide;   // Of the quads.
     struct player players[ 2 ];
 
     // Current time
@@ -129,11 +192,40 @@ typedef struct
 
     // =========renderToTex========= //
 
-    GLuint renderToTexFramebuffer;
-    GLuint renderToTexDepthRenderBuffer;
-    GLuint renderToTexTexture;
-    GLint renderToTexTexWidth;
-    GLint renderToTexTexHeight;
+    struct RenderTarget renderToTex;
+
+    // =========Scaling========= //
+    // With scaling the scene is drawn into the corner of sceneTarget, which
+    // is window sized, and DrawQuad stretches it over the window.
+    int scaling;
+    struct RenderScale renderScale;
+    struct RenderTarget sceneTarget;
+
+    struct RenderQueue renderQueue;
+
+    // ============Wall============ //
+    // With more than one table every table's meshes and balls go in one draw
+    // each.  GLES 2 has no instancing, so the meshes are repeated once per
+    // table in wallMeshes with the table of each vertex alongside.  The balls
+    // are already one array: particleQuadData has every table's quads, the
+    // game's first.
+    struct Wall wall;
+    struct Arena wallArena;
+    struct Mesh wallMeshes[ TABLE_MODEL_COLLISION ];
+    GLfloat *wallMeshCells[ TABLE_MODEL_COLLISION ];
+    GLfloat *wallBallCells;
+    GLint tableCellLoc;
+    GLint tableCellsLoc;
+    GLint particlesCellLoc;
+    GLint particlesCellsLoc;
+
+    // ===========Capture=========== //
+    int capturing;
+    struct FrameCapture capture;
+    struct VideoOut video;
+    GLuint captureFramebuffer;
+    GLenum readFormat;
+    GLenum readType;
 
     // ============Quad============ //
 
@@ -146,6 +238,7 @@ typedef struct
 
     // Quad Unifrom locations
     GLint quadSamplerLoc;
+    GLint quadTexTransformLoc;
 
     // Quad Texture handle
     GLuint quadTextureId;
@@ -153,17 +246,62 @@ typedef struct
     // Quad struct
     struct Quad * quad;
 
+    // ===========Assets=========== //
+    // Files decoded off the GL thread during startup.
+    struct AssetLoader *loader;
+    // Linked programs kept on disk so later runs skip the compiler.
+    struct ProgramCache programCache;
+
     // ============Table============ //
     GLuint tableProgram;
     struct Table * table;
+    struct TableSpec spec;
+    // Every buffer sized by the table, freed in one go at shut down.
+    struct Arena arena;
     GLuint tableStartPositionLoc;
     //GLuint tableTimeLoc;
     GLuint tableColorLoc;
 
-    float pauseTime;
     ESMatrix tableMVP;
     GLint tableMVPLoc;
 
+    // ============Input============ //
+    struct Input input;
+    struct ControlServer *control; // NULL without --control.
+    struct SharedStatePublisher *shared; // NULL without --shared-state.
+    int playState;
+    GLfloat placeBoundary[4]; // left, right, top, bottom
+    int hasCandidate;         // Cue ball drawn at candidate until it's placed.
+    GLfloat candidate[2];
+    GLfloat aim[2];           // Velocity built up from moves.
+
+    // ============Sim============ //
+    struct SimThread sim;
+    struct SimState currentState;
+    GLuint commandsSubmitted;
+
+    // ===========Replay=========== //
+    unsigned int rackSeed;
+    struct ReplayRecorder *recorder; // NULL without --record.
+    struct Replay *replay;           // NULL without --replay or once it ends.
+    struct ReplayCursor replayCursor;
+
+    // ==========Playback========== //
+    // With playbackEnabled a shot is solved up front and the vertex shader
+    // moves the balls; the sim only hears about the final positions.
+    int playbackEnabled;
+    int playing;
+    int playbackFinished;
+    float playbackStart;
+    struct Trajectory trajectory;
+    GLfloat *playbackKeyframes;     // vec4 per keyframe.
+    GLfloat *playbackKeyframeTimes;
+    GLfloat *playbackVertices;      // In arena, ballCount quads.
+    GLuint playbackBuffer;
+
+    // ===========Pacing=========== //
+    struct FramePacer pacer;
+
 } UserData;
 
 ///
@@ -196,43 +334,83 @@ GLuint LoadTexture ( char *fileName )
     return texId;
 }
 
-GLuint LoadPngTexture ( char *fileName )
+GLuint CreatePngTexture ( const struct PngImage *image )
 {
-    int *width,
-        *height;
-    unsigned char *buffer = PngTexture( fileName, &width, &height );
     GLuint texId;
 
-    if ( buffer == NULL )
-    {
-        esLogMessage ( "Error loading (%s) image.\n", fileName );
-        return 0;
-    }
-
     glGenTextures ( 1, &texId );
     glBindTexture ( GL_TEXTURE_2D, texId );
 
-    glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGBA, *width, *height, 0, GL_RGBA, GL_UNSIGNED_BYTE, buffer );
+    glTexImage2D ( GL_TEXTURE_2D, 0, GL_RGBA, image->width, image->height,
+            0, GL_RGBA, GL_UNSIGNED_BYTE, image->pixels );
     glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
     glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
     glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
     glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
-    free ( buffer );
-    free ( width );
-    free ( height );
+    return texId;
+}
+
+///
+// Upload an atlas and the mip chain the asset loader decoded for it.
+//
+GLuint CreateAtlasTexture ( UserData *userData, const struct Atlas *atlas )
+{
+    GLuint texId, level;
+    GLint width = atlas->width, height = atlas->height;
+
+    glGenTextures ( 1, &texId );
+    glBindTexture ( GL_TEXTURE_2D, texId );
+    for ( level = 0 ; level < atlas->levelCount ; ++level ) {
+        struct AssetJob *job = AssetLoaderWait( userData->loader,
+                atlas->levels[level] );
+        if ( job == NULL || job->image.width != width ||
+                job->image.height != height ) {
+            fprintf( stderr, "%s: %s should be %dx%d\n", __FILE__,
+                    atlas->levels[level], width, height );
+            glDeleteTextures ( 1, &texId );
+            return 0;
+        }
+        glTexImage2D ( GL_TEXTURE_2D, level, GL_RGBA, width, height, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, job->image.pixels );
+        FreePngImage( &job->image );
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+    }
+    // ES 2.0 only samples mipmaps with the whole chain down to 1x1 there.
+    GLint mipmapped = atlas->levelCount ==
+        (GLuint)ceil( log2( fmax( atlas->width, atlas->height ) ) ) + 1;
+    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+            mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR );
+    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri ( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
 
     return texId;
 }
 
+// staging holds the decoded pixels and can be reused for the next texture.
+GLuint LoadPngTexture ( const char *fileName, struct PngImage *staging )
+{
+    if ( !PngTexture( fileName, staging ) )
+    {
+        esLogMessage ( "Error loading (%s) image.\n", fileName );
+        return 0;
+    }
+    return CreatePngTexture( staging );
+}
+
 void LoadBallTextures ( GLuint *textures )
 {
+    struct PngImage staging;
+    memset( &staging, 0, sizeof(staging) );
     int i = 0;
     for ( ; i < 16 ; ++i) {
         char str[15];
         sprintf(str, "texture/%d.png", i);
-        textures[i] = LoadPngTexture( str );
+        textures[i] = LoadPngTexture( str, &staging );
     }
+    FreePngImage( &staging );
 }
 
 GLuint LoadWhiteTex( void )
@@ -246,83 +424,89 @@ GLuint LoadWhiteTex( void )
     return whiteTexHandle;
 }
 
-int InitFBO ( ESContext *esContext )
+int InitRenderTarget ( struct RenderTarget *target, GLint width, GLint height )
 {
-    UserData *userData = esContext->userData;
-
     GLint maxRenderBufferSize;
 
     glGetIntegerv ( GL_MAX_RENDERBUFFER_SIZE, &maxRenderBufferSize );
-    if ( (maxRenderBufferSize <= userData->renderToTexTexWidth) ||
-         (maxRenderBufferSize <= userData->renderToTexTexHeight) ) {
+    if ( (maxRenderBufferSize < width) || (maxRenderBufferSize < height) ) {
         fprintf(stderr, "Error.  GL_MAX_RENDERBUFFER_SIZE = %d\n", maxRenderBufferSize);
         return FALSE;
     }
+    target->width = width;
+    target->height = height;
 
-    glGenFramebuffers(1, &userData->renderToTexFramebuffer);
-    //glGenRenderbuffers(1, &userData->renderToTexDepthRenderBuffer);
-    glGenTextures(1, &userData->renderToTexTexture);
+    glGenFramebuffers(1, &target->framebuffer);
+    glGenRenderbuffers(1, &target->depthRenderbuffer);
+    glGenTextures(1, &target->colorTexture);
 
-    glBindTexture(GL_TEXTURE_2D, userData->renderToTexTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
-            userData->renderToTexTexWidth,
-            userData->renderToTexTexHeight, 0, GL_RGB,
-            GL_UNSIGNED_SHORT_5_6_5, NULL);
+    glBindTexture(GL_TEXTURE_2D, target->colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, NULL);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
+    glBindRenderbuffer(GL_RENDERBUFFER, target->depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT16, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target->framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+            GL_TEXTURE_2D, target->colorTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+            GL_RENDERBUFFER, target->depthRenderbuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if ( status != GL_FRAMEBUFFER_COMPLETE ) {
+        fprintf(stderr, "Error.  Framebuffer incomplete (0x%x)\n", status);
+        return FALSE;
+    }
     return TRUE;
 }
 
-void ParticleToQuad( const GLfloat * particle, GLfloat * quad )
+void FreeRenderTarget ( struct RenderTarget *target )
+{
+    glDeleteFramebuffers(1, &target->framebuffer);
+    glDeleteRenderbuffers(1, &target->depthRenderbuffer);
+    glDeleteTextures(1, &target->colorTexture);
+}
+
+void ParticleToQuad( const GLfloat * particle, GLfloat halfSide,
+        GLfloat * quad )
 {
-    quad[0] = particle[0] + PATICLES_QUAD_HALF_SIDELENGTH; // bottom right.
-    quad[1] = particle[1] - PATICLES_QUAD_HALF_SIDELENGTH;
+    quad[0] = particle[0] + halfSide; // bottom right.
+    quad[1] = particle[1] - halfSide;
 
-    quad[4] = particle[0] - PATICLES_QUAD_HALF_SIDELENGTH; // top left
-    quad[5] = particle[1] + PATICLES_QUAD_HALF_SIDELENGTH;
+    quad[4] = particle[0] - halfSide; // top left
+    quad[5] = particle[1] + halfSide;
 
-    quad[8] = particle[0] - PATICLES_QUAD_HALF_SIDELENGTH; // bottom left.
-    quad[9] = particle[1] - PATICLES_QUAD_HALF_SIDELENGTH;
+    quad[8] = particle[0] - halfSide; // bottom left.
+    quad[9] = particle[1] - halfSide;
 
     // Sadly, due to lack of primitive restart, we have to duplicate vertices.
 
-    quad[12] = particle[0] - PATICLES_QUAD_HALF_SIDELENGTH; // top left
-    quad[13] = particle[1] + PATICLES_QUAD_HALF_SIDELENGTH;
+    quad[12] = particle[0] - halfSide; // top left
+    quad[13] = particle[1] + halfSide;
 
-    quad[16] = particle[0] + PATICLES_QUAD_HALF_SIDELENGTH; // bottom right.
-    quad[17] = particle[1] - PATICLES_QUAD_HALF_SIDELENGTH;
+    quad[16] = particle[0] + halfSide; // bottom right.
+    quad[17] = particle[1] - halfSide;
 
-    quad[20] = particle[0] + PATICLES_QUAD_HALF_SIDELENGTH; // top right.
-    quad[21] = particle[1] + PATICLES_QUAD_HALF_SIDELENGTH;
+    quad[20] = particle[0] + halfSide; // top right.
+    quad[21] = particle[1] + halfSide;
 
 }
 
-// Texture points are strided.
-void AddTextureToQuad(GLfloat *particleQuadData, int ballNumber) {
-    GLfloat startX = (ballNumber % 4) * TEXTURE_ATLAS_IMAGE_SIZE;
-    GLfloat startY = (ballNumber / 4) * TEXTURE_ATLAS_IMAGE_SIZE;
+// Texture points are strided.  uv is the sprite's left, top, right, bottom.
+void AddTextureToQuad(GLfloat *particleQuadData, const GLfloat *uv) {
     GLfloat particlesTex[] = {
-        (startX + TEXTURE_ATLAS_IMAGE_SIZE) / TEXTURE_ATLAS_SIDE_LENGTH,
-        (startY + TEXTURE_ATLAS_IMAGE_SIZE) / TEXTURE_ATLAS_SIDE_LENGTH, // Bottom right
-
-                                     startX / TEXTURE_ATLAS_SIDE_LENGTH,
-                                     startY / TEXTURE_ATLAS_SIDE_LENGTH, // Top left
-
-                                     startX / TEXTURE_ATLAS_SIDE_LENGTH,
-        (startY + TEXTURE_ATLAS_IMAGE_SIZE) / TEXTURE_ATLAS_SIDE_LENGTH, // Bottom left
-
-                                     startX / TEXTURE_ATLAS_SIDE_LENGTH,
-                                     startY / TEXTURE_ATLAS_SIDE_LENGTH, // Top left
-
-        (startX + TEXTURE_ATLAS_IMAGE_SIZE) / TEXTURE_ATLAS_SIDE_LENGTH,
-        (startY + TEXTURE_ATLAS_IMAGE_SIZE) / TEXTURE_ATLAS_SIDE_LENGTH, // Bottom right
-
-        (startX + TEXTURE_ATLAS_IMAGE_SIZE) / TEXTURE_ATLAS_SIDE_LENGTH,
-                                     startY / TEXTURE_ATLAS_SIDE_LENGTH  // Top right
+        uv[2], uv[3], // Bottom right
+        uv[0], uv[1], // Top left
+        uv[0], uv[3], // Bottom left
+        uv[0], uv[1], // Top left
+        uv[2], uv[3], // Bottom right
+        uv[2], uv[1]  // Top right
     };
     GLfloat *pt = &particlesTex[0];
     int j = 1;
@@ -332,76 +516,149 @@ void AddTextureToQuad(GLfloat *particleQuadData, int ballNumber) {
     }
 }
 
+///
+// Size the arena for the table the spec describes and carve it up.  The
+// collision mesh has to be in first, scaling it takes arena space too.
+//
+int InitArena( ESContext *esContext )
+{
+    UserData *userData = esContext->userData;
+    const struct TableSpec *spec = &userData->spec;
+    GLint ballCount = spec->ballCount;
+
+    if ( AssetLoaderWait( userData->loader,
+                spec->models[TABLE_MODEL_COLLISION] ) == NULL ) {
+        return FALSE;
+    }
+    size_t particleSize = sizeof(GLfloat) * NUM_PARTICLES * PARTICLE_SIZE;
+    size_t quadSize = sizeof(GLfloat) * ballCount * PARTICLE_QUAD_SIZE *
+        userData->wall.count;
+    size_t ballSize = sizeof(struct ball) * ballCount;
+    size_t playbackSize = sizeof(GLfloat) * ballCount *
+        (PARTICLE_QUAD_SIZE / PARTICLE_SIZE) * PLAYBACK_VERTEX_SIZE;
+    if ( !ArenaInit( &userData->arena, ArenaSize( particleSize ) +
+                ArenaSize( quadSize ) + ArenaSize( ballSize ) +
+                ArenaSize( playbackSize ) +
+                TableSpecArenaSize( spec, userData->table ) ) ) {
+        return FALSE;
+    }
+    userData->particleData = ArenaAlloc( &userData->arena, particleSize );
+    userData->particleQuadData = ArenaAlloc( &userData->arena, quadSize );
+    userData->balls = ArenaAlloc( &userData->arena, ballSize );
+    userData->playbackVertices = ArenaAlloc( &userData->arena, playbackSize );
+    if ( userData->playbackVertices == NULL ||
+            !TableSpecApply( spec, userData->table, &userData->arena ) ) {
+        return FALSE;
+    }
+    userData->ballCount = ballCount;
+    userData->ballHalfSide = spec->ballRadius * BALL_QUAD_SCALE;
+    return TRUE;
+}
+
 int InitBalls( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
-    srand ( time(NULL) );
     GLint ballOrder[ NUM_PARTICLES ];
     GLint i;
-    for( i = 0 ; i < NUM_PARTICLES ; ++i ) {
-        ballOrder[i] = i;
-    }
-    // 8 ball needs to go in position 5.  A stipe and solid must compose the
-    // back corners.
-    GLint stripeBallPos = NUM_PARTICLES - 1;
-    GLint solidBallPos = NUM_PARTICLES - 1;
-    int eightBallPos = NUM_PARTICLES - 1;
-    // shuffle
-    for( i = 1 ; i < NUM_PARTICLES-1 ; ++i ) {
-        int j = i + rand() / (RAND_MAX / (NUM_PARTICLES - i) + 1);
-        int t = ballOrder[j];
-        if( ballOrder[j] == 8 ) {
-            eightBallPos = i;
-        }
-        if ( ballOrder[j] > 8 && i != 5 ) {
-            stripeBallPos = i;
-        }
-        if ( ballOrder[j] < 8 && i != 5 ) {
-            solidBallPos = i;
-        }
-        ballOrder[j] = ballOrder[i];
-        ballOrder[i] = t;
-    }
-
-    // This is where the 8 ball must go.
-    int t = ballOrder[5];
-    ballOrder[5] = ballOrder[eightBallPos];
-    ballOrder[eightBallPos] = t;
-
-    if ( ballOrder[11] < 8 && ballOrder[15] < 8 ) {
-        t = ballOrder[11];
-        ballOrder[11] = ballOrder[stripeBallPos];
-        ballOrder[stripeBallPos] = t;
-    } else if ( ballOrder[11] > 8 && ballOrder[15] > 8 ) {
-        t = ballOrder[11];
-        ballOrder[11] = ballOrder[solidBallPos];
-        ballOrder[solidBallPos] = t;
-    }
+    RackShuffle( &userData->spec, ballOrder, userData->rackSeed );
 
-    for ( i = 0; i < NUM_PARTICLES; ++i )
+    // Slots past ballCount never hold a ball.
+    for ( i = 0; i < userData->ballCount; ++i )
     {
         GLfloat *particleData = &userData->particleData[i * PARTICLE_SIZE];
         GLfloat *particleQuadData = &userData->particleQuadData[i * PARTICLE_QUAD_SIZE];
+        userData->balls[ballOrder[i]].number = ballOrder[i];
         userData->balls[ballOrder[i]].position = particleData;
         userData->balls[ballOrder[i]].velocity = particleData + 2;
         userData->balls[ballOrder[i]].quad = particleQuadData;
-        AddTextureToQuad(particleQuadData, ballOrder[i]);
+
+        const char *name = userData->spec.balls[ ballOrder[i] ].sprite;
+        const struct AtlasSprite *sprite = AtlasFind( &userData->ballAtlas,
+                name );
+        if ( sprite == NULL ) {
+            fprintf( stderr, "No sprite %s for ball %d in %s\n", name,
+                    ballOrder[i], BALL_ATLAS );
+            return FALSE;
+        }
+        AddTextureToQuad(particleQuadData, sprite->uv);
     }
     return TRUE;
 }
 
+///
+// Take over a shader source read by the asset loader.  NULL if it failed.
+//
+char * TakeShader ( UserData *userData, const char *name )
+{
+    struct AssetJob *job = AssetLoaderWait( userData->loader, name );
+    if ( job == NULL ) {
+        return NULL;
+    }
+    char *source = job->source;
+    job->source = NULL;
+    return source;
+}
+
+///
+// Put prefix (#defines) in front of a shader loaded by loadShader.  Takes
+// over source; NULL if it is NULL or there's no memory.
+//
+char * PrefixShader ( const char *prefix, char *source )
+{
+    if ( source == NULL ) {
+        return NULL;
+    }
+    size_t prefixLength = strlen( prefix );
+    size_t sourceLength = strlen( source );
+    char *result = malloc( prefixLength + sourceLength + 1 );
+    if ( result == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        free( source );
+        return NULL;
+    }
+    memcpy( result, prefix, prefixLength );
+    memcpy( result + prefixLength, source, sourceLength + 1 );
+    free( source );
+    return result;
+}
+
 int InitParticles ( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
     int i;
 
-    char * vShaderStr = loadShader( "shader/billiards.vert" );
-    char * fShaderStr = loadShader( "shader/billiards.frag" );
+    // Fit as many playback keyframes as the vertex uniforms allow.  Each
+    // takes a vec4 and a float, which may well get a vector to itself.
+    GLint maxVertexUniforms;
+    glGetIntegerv( GL_MAX_VERTEX_UNIFORM_VECTORS, &maxVertexUniforms );
+    GLuint maxKeyframes = (maxVertexUniforms - PLAYBACK_RESERVED_UNIFORMS -
+            (GLint) userData->wall.count) / 2;
+    if ( maxKeyframes > PLAYBACK_MAX_KEYFRAMES ) {
+        maxKeyframes = PLAYBACK_MAX_KEYFRAMES;
+    }
+    if ( maxKeyframes < NUM_PARTICLES ) {
+        maxKeyframes = NUM_PARTICLES;
+        userData->playbackEnabled = FALSE;
+    }
+    char prefix[64];
+    snprintf( prefix, sizeof(prefix), "#define MAX_KEYFRAMES %u\n"
+            "#define MAX_CELLS %u\n", maxKeyframes, userData->wall.count );
+
+    char * vShaderStr = PrefixShader( prefix,
+            TakeShader( userData, "shader/billiards.vert" ) );
+    char * fShaderStr = TakeShader( userData, "shader/billiards.frag" );
+    if ( vShaderStr == NULL || fShaderStr == NULL ) {
+        free(vShaderStr);
+        free(fShaderStr);
+        return FALSE;
+    }
 
     // Load the shaders and get a linked program object
-    userData->particlesProgram = esLoadProgram ( vShaderStr, fShaderStr );
+    userData->particlesProgram = ProgramCacheLoad( &userData->programCache,
+            vShaderStr, fShaderStr );
     free(vShaderStr);
     free(fShaderStr);
+    TimelineMark( "particle program linked" );
 
     // Get the attribute locations
     userData->particlesStartPositionLoc = glGetAttribLocation ( userData->particlesProgram, "a_startPosition" );
@@ -411,59 +668,39 @@ int InitParticles ( ESContext *esContext )
     userData->particlesTimeLoc = glGetUniformLocation ( userData->particlesProgram, "u_time" );
     userData->particlesColorLoc = glGetUniformLocation ( userData->particlesProgram, "u_color" );
     userData->particlesSamplerLoc = glGetUniformLocation ( userData->particlesProgram, "s_texture" );
-    // Fill in particle data array
-    //srand ( 0 );
-    float poolPts [] = {
-              //-4 * H_TICK - (2*BALL_SIZE),    0.0f, // white ball
-
-              0.0f,        0.0f, // row 1
-
-          BALL_SIZE, -BALL_SIZE, // row 2
-          BALL_SIZE,  BALL_SIZE,
-
-        2*BALL_SIZE, -2*BALL_SIZE, // row 3
-        2*BALL_SIZE,         0.0f,
-        2*BALL_SIZE,  2*BALL_SIZE,
-
-        3*BALL_SIZE, -3*BALL_SIZE, // row 4
-        3*BALL_SIZE,   -BALL_SIZE,
-        3*BALL_SIZE,    BALL_SIZE,
-        3*BALL_SIZE,  3*BALL_SIZE,
-
-        4*BALL_SIZE, -4*BALL_SIZE, // row 5
-        4*BALL_SIZE, -2*BALL_SIZE,
-        4*BALL_SIZE,         0.0f,
-        4*BALL_SIZE,  2*BALL_SIZE,
-        4*BALL_SIZE,  4*BALL_SIZE,
-    };
-    GLfloat *pt = &poolPts[0];
-    {
-        GLfloat *particleData = &userData->particleData[0 * PARTICLE_SIZE];
-        particleData[0] = INFINITY;
-        particleData[1] = INFINITY;
-        particleData[2] = 0.0f;
-        particleData[3] = 0.0f;
+    userData->particlesPlaybackLoc = glGetUniformLocation ( userData->particlesProgram, "u_playback" );
+    userData->particlesKeyframesLoc = glGetUniformLocation ( userData->particlesProgram, "u_keyframes" );
+    userData->particlesKeyframeTimesLoc = glGetUniformLocation ( userData->particlesProgram, "u_keyframeTimes" );
+    userData->particlesKeyframeRangeLoc = glGetAttribLocation ( userData->particlesProgram, "a_keyframes" );
+    userData->particlesCellLoc = glGetAttribLocation ( userData->particlesProgram, "a_cell" );
+    userData->particlesCellsLoc = glGetUniformLocation ( userData->particlesProgram, "u_cells" );
+
+    if ( userData->playbackEnabled ) {
+        if ( !TrajectoryInit( &userData->trajectory, maxKeyframes ) ) {
+            return FALSE;
+        }
+        userData->playbackKeyframes = malloc( sizeof(GLfloat) * 4 * maxKeyframes );
+        userData->playbackKeyframeTimes = malloc( sizeof(GLfloat) * maxKeyframes );
+        if ( userData->playbackKeyframes == NULL ||
+             userData->playbackKeyframeTimes == NULL ) {
+            return FALSE;
+        }
+        glGenBuffers( 1, &userData->playbackBuffer );
     }
-    for ( i = 1; i < NUM_PARTICLES; i++ )
-    {
-        GLfloat *particleData = &userData->particleData[i * PARTICLE_SIZE];
-        GLfloat *particleQuadData = &userData->particleQuadData[i * PARTICLE_QUAD_SIZE];
-
-        // Start position of particle
-        GLfloat *ptr = particleData;
-
-        (*ptr++) = (*pt++) + ((2 * H_TICK) + (2*BALL_SIZE));
-        (*ptr++) = (*pt++);
-
-        // Velocities
-        (*ptr++) = 0.0f;
-        (*ptr++) = 0.0f;
-
-        ParticleToQuad(particleData, particleQuadData);
+    RackPositions( &userData->spec, &userData->particleData[0] );
+    for ( i = 0 ; i < userData->ballCount ; ++i ) {
+        ParticleToQuad( &userData->particleData[i * PARTICLE_SIZE],
+                userData->ballHalfSide,
+                &userData->particleQuadData[i * PARTICLE_QUAD_SIZE] );
     }
 
     //userData->particlesTextureId = LoadTexture ( "texture/smoke.tga" );
-    userData->particlesTextureId = LoadPngTexture( "texture/balls.png" );
+    userData->particlesTextureId = CreateAtlasTexture( userData,
+            &userData->ballAtlas );
+    if ( userData->particlesTextureId == 0 ) {
+        return FALSE;
+    }
+    TimelineMark( "ball texture uploaded" );
     //LoadBallTextures( userData->particlesTextures );
     //userData->particlesTextureId = LoadWhiteTex();
     //if ( userData->particlesTextureId <= 0 )
@@ -480,8 +717,8 @@ int InitParticles ( ESContext *esContext )
 
     esMatrixLoadIdentity( &modelview );
 
-    // Translate away from the viewer
-    esTranslate( &modelview, 0.0, 0.0, -1.9999 );
+    // Translate away from the viewer, further for bigger tables.
+    esTranslate( &modelview, 0.0, 0.0, -1.9999 * userData->spec.scale );
 
     esMatrixLoadIdentity( &perspective );
     esPerspective(&perspective, 60.0f, (float)esContext->width /
@@ -489,6 +726,8 @@ int InitParticles ( ESContext *esContext )
     esMatrixMultiply( &userData->particlesMVP, &modelview, &perspective );
 
     glUseProgram ( userData->particlesProgram );
+    glUniform4fv ( userData->particlesCellsLoc, userData->wall.count,
+            userData->wall.cells );
 
     //float centerPos[2];
     float color[4];
@@ -517,13 +756,21 @@ int InitQuad( ESContext *esContext )
     // Make the program
     char *vShaderStr = loadShader("shader/quad.vert");
     char *fShaderStr = loadShader("shader/quad.frag");
-    userData->quadProgram = esLoadProgram ( vShaderStr, fShaderStr );
+    if ( vShaderStr == NULL || fShaderStr == NULL ) {
+        free(vShaderStr);
+        free(fShaderStr);
+        return FALSE;
+    }
+    userData->quadProgram = ProgramCacheLoad( &userData->programCache,
+            vShaderStr, fShaderStr );
     free(vShaderStr);
     free(fShaderStr);
 
     // Get uniform locations
     userData->quadSamplerLoc = glGetUniformLocation( userData->quadProgram,
             "s_texture" );
+    userData->quadTexTransformLoc = glGetUniformLocation(
+            userData->quadProgram, "u_texTransform" );
 
     // Get attribute locations
     userData->quadPositionLoc = glGetAttribLocation ( userData->quadProgram,
@@ -535,21 +782,36 @@ int InitQuad( ESContext *esContext )
     return TRUE;
 }
 
+///
+// Models a table leaves out ("-") stay empty meshes and draw nothing.
+//
+int WaitForModel( UserData *userData, GLint model )
+{
+    const char *name = userData->spec.models[model];
+    return strcmp( name, "-" ) == 0 ||
+        AssetLoaderWait( userData->loader, name ) != NULL;
+}
+
 int InitTable( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    userData->table->tableElementsSize = loadObj(TABLE_MODEL,
-            &userData->table->vTable, &userData->table->eTable);
+    // Parsed into userData->table->table by the asset loader.
+    if ( !WaitForModel( userData, TABLE_MODEL_TABLE ) ) {
+        return FALSE;
+    }
 
     // Generate a model view matrix to rotate/translate the cube
     ESMatrix modelview;
     ESMatrix perspective;
+    GLfloat scale = userData->spec.scale;
 
     esMatrixLoadIdentity( &modelview );
 
-    // Translate away from the viewer
-    esTranslate( &modelview, 0.0, 0.0, -2.0 );
+    // Translate away from the viewer.  The models are all of a 9 ft table;
+    // the others stretch them and back off to keep it in view.
+    esTranslate( &modelview, 0.0, 0.0, -2.0 * scale );
+    esScale( &modelview, scale, scale, 1.0 );
 
     esMatrixLoadIdentity( &perspective );
     esPerspective(&perspective, 60.0f, (float)esContext->width /
@@ -562,8 +824,10 @@ int InitRails( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    userData->table->railsElementsSize = loadObj(RAILS_MODEL,
-            &userData->table->vRails, &userData->table->eRails);
+    // Parsed into userData->table->rails by the asset loader.
+    if ( !WaitForModel( userData, TABLE_MODEL_RAILS ) ) {
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -571,8 +835,10 @@ int InitHoles( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    userData->table->holesElementsSize = loadObj(HOLES_MODEL,
-            &userData->table->vHoles, &userData->table->eHoles);
+    // Parsed into userData->table->holes by the asset loader.
+    if ( !WaitForModel( userData, TABLE_MODEL_HOLES ) ) {
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -580,8 +846,10 @@ int InitTicks( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    userData->table->ticksElementsSize = loadObj(TICKS_MODEL,
-            &userData->table->vTicks, &userData->table->eTicks);
+    // Parsed into userData->table->ticks by the asset loader.
+    if ( !WaitForModel( userData, TABLE_MODEL_TICKS ) ) {
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -589,11 +857,9 @@ int InitCollision( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    userData->table->collisionElementsSize = loadObj(COLLISION_MODEL,
-            &userData->table->vCollision, &userData->table->eCollision);
-    userData->table->nCollision =
-            ComputeSurfaceNormals(userData->table->vCollision,
-            userData->table->eCollision, userData->table->collisionElementsSize);
+    if ( !WaitForModel( userData, TABLE_MODEL_COLLISION ) ) {
+        return FALSE;
+    }
     return TRUE;
 }
 
@@ -601,13 +867,24 @@ int InitBilliardsTable( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    char * vShaderStr = loadShader( "shader/table.vert" );
-    char * fShaderStr = loadShader( "shader/table.frag" );
+    char prefix[32];
+    snprintf( prefix, sizeof(prefix), "#define MAX_CELLS %u\n",
+            userData->wall.count );
+    char * vShaderStr = PrefixShader( prefix,
+            TakeShader( userData, "shader/table.vert" ) );
+    char * fShaderStr = TakeShader( userData, "shader/table.frag" );
+    if ( vShaderStr == NULL || fShaderStr == NULL ) {
+        free(vShaderStr);
+        free(fShaderStr);
+        return FALSE;
+    }
 
     // Load the shaders and get a linked program object
-    userData->tableProgram = esLoadProgram ( vShaderStr, fShaderStr );
+    userData->tableProgram = ProgramCacheLoad( &userData->programCache,
+            vShaderStr, fShaderStr );
     free(vShaderStr);
     free(fShaderStr);
+    TimelineMark( "table program linked" );
 
     // Get the attribute locations
     userData->tableStartPositionLoc = glGetAttribLocation ( userData->tableProgram, "a_startPosition" );
@@ -615,7 +892,12 @@ int InitBilliardsTable( ESContext *esContext )
     // Get the uniform locations
     //userData->tableTimeLoc = glGetUniformLocation ( userData->tableProgram, "u_time" );
     userData->tableColorLoc = glGetUniformLocation ( userData->tableProgram, "u_color" );
-    userData->tableMVPLoc = glGetUniformLocation ( userData->particlesProgram, "u_MVP" );
+    userData->tableMVPLoc = glGetUniformLocation ( userData->tableProgram, "u_MVP" );
+    userData->tableCellLoc = glGetAttribLocation ( userData->tableProgram, "a_cell" );
+    userData->tableCellsLoc = glGetUniformLocation ( userData->tableProgram, "u_cells" );
+    glUseProgram ( userData->tableProgram );
+    glUniform4fv ( userData->tableCellsLoc, userData->wall.count,
+            userData->wall.cells );
 
     if ( !InitTable(esContext) ) {
         return FALSE;
@@ -632,55 +914,221 @@ int InitBilliardsTable( ESContext *esContext )
     if ( !InitCollision(esContext) ) {
         return FALSE;
     }
+    TimelineMark( "table meshes ready" );
     return TRUE;
 }
 
-GLfloat PlaceBall( ESContext *esContext, struct ball ball, GLfloat *boundary )
+///
+// The mesh drawn for one of the TABLE_MODEL_* models before
+// TABLE_MODEL_COLLISION.
+//
+const struct Mesh * TableMesh( UserData *userData, GLint model )
 {
-    GLfloat left   = boundary[0];
-    GLfloat right  = boundary[1];
-    GLfloat top    = boundary[2];
-    GLfloat bottom = boundary[3];
-    char c;
-    struct timeval t1, t2;
-    struct timezone tz;
-    gettimeofday ( &t1 , &tz );
+    const struct Mesh *meshes[ TABLE_MODEL_COLLISION ] = {
+        &userData->table->table, &userData->table->rails,
+        &userData->table->holes, &userData->table->ticks };
+    return meshes[model];
+}
+
+///
+// Copy the table's meshes once per table on the wall, each copy's vertices
+// tagged with its table, and set up the other tables' sims and balls.
+//
+int InitWall( ESContext *esContext )
+{
+    UserData *userData = esContext->userData;
+    struct Wall *wall = &userData->wall;
+    GLint ballVertices = userData->ballCount *
+        (PARTICLE_QUAD_SIZE / PARTICLE_SIZE);
+    GLint model, slot;
+    GLuint t, i;
+
+    if ( wall->count == 1 ) {
+        return TRUE;
+    }
+    size_t size = ArenaSize( sizeof(GLfloat) * ballVertices * wall->count );
+    for ( model = 0 ; model < TABLE_MODEL_COLLISION ; ++model ) {
+        const struct Mesh *mesh = TableMesh( userData, model );
+        // Elements are GLushort.
+        if ( mesh->vertexCount * wall->count > 65536 ) {
+            fprintf( stderr, "%s has too many vertices for %u tables\n",
+                    userData->spec.models[model], wall->count );
+            return FALSE;
+        }
+        size += ArenaSize( sizeof(GLfloat) * 2 * mesh->vertexCount *
+                wall->count ) +
+            ArenaSize( sizeof(GLfloat) * mesh->vertexCount * wall->count ) +
+            ArenaSize( sizeof(GLushort) * mesh->elementsSize * wall->count );
+    }
+    if ( !ArenaInit( &userData->wallArena, size ) ) {
+        return FALSE;
+    }
 
-    do {
+    for ( model = 0 ; model < TABLE_MODEL_COLLISION ; ++model ) {
+        const struct Mesh *mesh = TableMesh( userData, model );
+        struct Mesh *copy = &userData->wallMeshes[model];
+        if ( mesh->elementsSize == 0 ) {
+            continue;
+        }
+        GLfloat *v = ArenaAlloc( &userData->wallArena,
+                sizeof(GLfloat) * 2 * mesh->vertexCount * wall->count );
+        GLfloat *cells = ArenaAlloc( &userData->wallArena,
+                sizeof(GLfloat) * mesh->vertexCount * wall->count );
+        GLushort *e = ArenaAlloc( &userData->wallArena,
+                sizeof(GLushort) * mesh->elementsSize * wall->count );
+        for ( t = 0 ; t < wall->count ; ++t ) {
+            memcpy( &v[ t * 2 * mesh->vertexCount ], mesh->v,
+                    sizeof(GLfloat) * 2 * mesh->vertexCount );
+            for ( i = 0 ; i < mesh->vertexCount ; ++i ) {
+                cells[ t * mesh->vertexCount + i ] = (GLfloat) t;
+            }
+            for ( i = 0 ; i < (GLuint) mesh->elementsSize ; ++i ) {
+                e[ t * mesh->elementsSize + i ] = (GLushort)
+                    ( mesh->e[i] + t * mesh->vertexCount );
+            }
+        }
+        copy->v = v;
+        copy->e = e;
+        copy->vertexCount = mesh->vertexCount * wall->count;
+        copy->elementsSize = mesh->elementsSize * wall->count;
+        userData->wallMeshCells[model] = cells;
+    }
 
-        GLfloat x, y;
-        do {
-            printf("Enter position [%.3f, %.3f], [%.3f, %.3f]: ", left, right, bottom, top);
-            scanf("%f %f", &x, &y);
-        } while( x < left || x > right || y < bottom || y > top );
+    userData->wallBallCells = ArenaAlloc( &userData->wallArena,
+            sizeof(GLfloat) * ballVertices * wall->count );
+    for ( t = 0 ; t < wall->count ; ++t ) {
+        for ( i = 0 ; i < (GLuint) ballVertices ; ++i ) {
+            userData->wallBallCells[ t * ballVertices + i ] = (GLfloat) t;
+        }
+    }
 
-        ball.position[0] = x;
-        ball.position[1] = y;
+    if ( !WallStart( wall, userData->table, &userData->spec,
+                userData->rackSeed ) ) {
+        return FALSE;
+    }
+    for ( t = 1 ; t < wall->count ; ++t ) {
+        struct WallTable *wallTable = &wall->tables[t - 1];
+        GLfloat *quads = &userData->particleQuadData[ t *
+            userData->ballCount * PARTICLE_QUAD_SIZE ];
+        GLint ballOrder[ NUM_PARTICLES ];
+        if ( wallTable->live != NULL ) {
+            // Shared state is by ball number already.
+            for ( slot = 0 ; slot < userData->ballCount ; ++slot ) {
+                ballOrder[slot] = slot;
+            }
+        } else {
+            RackShuffle( &userData->spec, ballOrder, wallTable->rackSeed );
+        }
+        for ( slot = 0 ; slot < userData->ballCount ; ++slot ) {
+            const struct AtlasSprite *sprite = AtlasFind(
+                    &userData->ballAtlas,
+                    userData->spec.balls[ ballOrder[slot] ].sprite );
+            if ( sprite == NULL ) {
+                return FALSE;
+            }
+            ParticleToQuad( &wallTable->particleData[slot * PARTICLE_SIZE],
+                    userData->ballHalfSide,
+                    &quads[slot * PARTICLE_QUAD_SIZE] );
+            AddTextureToQuad( &quads[slot * PARTICLE_QUAD_SIZE], sprite->uv );
+        }
+        if ( wallTable->live == NULL ) {
+            wallTable->currentState = *SimThreadLatest( &wallTable->sim );
+        }
+    }
+    fprintf( stderr, "Wall of %u tables, %ux%u, %u live, %u replays\n",
+            wall->count, wall->columns, wall->rows, wall->liveCount,
+            wall->replayCount );
+    return TRUE;
+}
 
-        ball.velocity[0] = 0.0f;
-        ball.velocity[1] = 0.0f;
+void SubmitCommand( UserData *userData, GLint type, GLint ball, GLfloat x,
+        GLfloat y )
+{
+    struct SimCommand command;
+    command.type = type;
+    command.ball = ball;
+    command.value[0] = x;
+    command.value[1] = y;
+    if ( SimThreadSubmit( &userData->sim, &command ) ) {
+        ++userData->commandsSubmitted;
+        if ( userData->recorder != NULL ) {
+            ReplayRecord( userData->recorder, &command );
+        }
+    }
+}
 
-        ParticleToQuad(ball.position, ball.quad);
+///
+// Ask for the cue ball somewhere inside left, right, top, bottom.
+//
+void StartPlacing( UserData *userData, GLfloat left, GLfloat right,
+        GLfloat top, GLfloat bottom )
+{
+    userData->placeBoundary[0] = left;
+    userData->placeBoundary[1] = right;
+    userData->placeBoundary[2] = top;
+    userData->placeBoundary[3] = bottom;
+    userData->hasCandidate = FALSE;
+    userData->playState = PLAY_PLACING;
+    printf( "Enter position [%.3f, %.3f], [%.3f, %.3f]: ", left, right, bottom,
+            top );
+    fflush( stdout );
+}
 
-        glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
-        Draw(esContext);
-        eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
+void StartAiming( UserData *userData )
+{
+    userData->hasCandidate = FALSE;
+    userData->aim[0] = 0.0f;
+    userData->aim[1] = 0.0f;
+    userData->playState = PLAY_AIMING;
+    printf( "Enter Velocity: " );
+    fflush( stdout );
+}
 
-        printf("Confirm [y/n]: ");
-        scanf(" %c", &c);
-    } while ( c != 'y' );
+int InsideBoundary( const GLfloat *boundary, GLfloat x, GLfloat y )
+{
+    return x >= boundary[0] && x <= boundary[1] &&
+           y >= boundary[3] && y <= boundary[2];
+}
 
-    gettimeofday ( &t2, &tz );
-    GLfloat scanfTime = (float)(t2.tv_sec - t1.tv_sec + (t2.tv_usec - t1.tv_usec) * 1e-6);
-    return scanfTime;
+///
+// Put the replay cursor where --replay-shot or --replay-time asked.
+//
+int SeekReplay( UserData *userData, const struct Options *options )
+{
+    const struct Replay *replay = userData->replay;
+    const struct ReplayIndexEntry *entry = &replay->index[0];
+    GLuint tick = 0;
+
+    if ( options->replayTime >= 0.0 ) {
+        tick = (GLuint) ( options->replayTime * SIM_RATE + 0.5 );
+        entry = ReplayFindTick( replay, tick );
+    } else if ( options->replayShot > 0 ) {
+        entry = ReplayFindShot( replay, options->replayShot - 1 );
+        if ( entry == NULL ) {
+            fprintf( stderr, "%s has %u shots\n", options->replayPath,
+                    replay->header.shotCount );
+            return FALSE;
+        }
+        tick = entry->tick;
+    }
+    if ( !ReplaySeek( &userData->replayCursor, replay, entry ) ) {
+        return FALSE;
+    }
+    ReplayAdvance( &userData->replayCursor, userData->table, tick );
+    return TRUE;
 }
 
 ///
 // Initialize the shader and program object
 //
-int Init ( ESContext *esContext )
+int Init ( ESContext *esContext, const struct Options *options )
 {
     UserData *userData = esContext->userData;
+    const struct TableSpec *spec = &userData->spec;
+    GLint i;
+    if ( !InitArena(esContext) ) {
+        return FALSE;
+    }
     if ( !InitBalls(esContext) ) {
         return FALSE;
     }
@@ -690,299 +1138,372 @@ int Init ( ESContext *esContext )
     if ( !InitBilliardsTable(esContext) ) {
         return FALSE;
     }
+    if ( !InitWall(esContext) ) {
+        return FALSE;
+    }
     glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
     Draw(esContext);
     eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
-    char c;
-    do {
-        GLfloat x, y;
-        do {
-            printf("Enter white ball start position [%.3f, %.3f], [%.3f, %.3f]: ", -WIDTH, -2*H_TICK, -HEIGHT, HEIGHT);
-            scanf("%f %f", &x, &y);
-        } while(x < -WIDTH || x > -2*H_TICK || y < -HEIGHT || y > 2*HEIGHT);
-
-        GLfloat *particleData = &userData->particleData[ 0 ];
-        GLfloat *particleQuadData = &userData->particleQuadData[ 0 ];
-        particleData[0] = x;
-        particleData[1] = y;
-        ParticleToQuad(particleData, particleQuadData);
-
-        glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
-        Draw(esContext);
-        eglSwapBuffers(esContext->eglDisplay, esContext->eglSurface);
-
-        printf("Confirm [y/n]: ");
-        scanf(" %c", &c);
-
-    } while( c != 'y' );
+    TimelineMark( "first frame" );
+    TimelineReport( stderr, userData->loader );
+    if ( userData->programCache.enabled ) {
+        fprintf( stderr, "Program cache %s: %u hits, %u misses\n",
+                userData->programCache.directory, userData->programCache.hits,
+                userData->programCache.misses );
+    }
     //if ( !InitQuad(esContext) ) {
     //    return FALSE;
     //}
-    //if ( !InitFBO(esContext) ) {
+    //if ( !InitRenderTarget(&userData->renderToTex, RENDER_TO_TEX_WIDTH,
+    //        RENDER_TO_TEX_HEIGHT) ) {
     //    return FALSE;
     //}
     glClearColor ( 0.0f, 0.0f, 0.0f, 1.0f );
 
     userData->time = 0.0f;
-    glEnable( GL_DEPTH_TEST );
+
+    // Clients and viewers see balls by number, the sim only knows slots.
+    // The empty slots keep the numbers they were started with.
+    for ( i = 0 ; i < userData->ballCount ; ++i ) {
+        const struct ball *ball = &userData->balls[i];
+        GLint slot = (ball->position - &userData->particleData[0]) /
+            PARTICLE_SIZE;
+        if ( userData->control != NULL ) {
+            userData->control->ballNumbers[slot] = ball->number;
+        }
+        if ( userData->shared != NULL ) {
+            userData->shared->ballNumbers[slot] = ball->number;
+        }
+    }
+    if ( userData->control != NULL ) {
+        userData->sim.ticks = &userData->control->ticks;
+    }
+    userData->sim.shared = userData->shared;
+    if ( userData->replay != NULL ) {
+        if ( !SeekReplay( userData, options ) ) {
+            return FALSE;
+        }
+        memcpy( &userData->particleData[0], userData->replayCursor.particleData,
+                sizeof(userData->replayCursor.particleData) );
+    }
+    if ( userData->recorder != NULL &&
+            !ReplayRecorderStart( userData->recorder, options->recordPath,
+                options->tablePath, userData->spec.name, userData->table,
+                &userData->particleData[0], userData->rackSeed ) ) {
+        return FALSE;
+    }
+    if ( !SimThreadStart( &userData->sim, userData->table,
+            &userData->particleData[0] ) ) {
+        return FALSE;
+    }
+    userData->commandsSubmitted = 0;
+    userData->currentState = *SimThreadLatest( &userData->sim );
+
+    if ( userData->replay != NULL ) {
+        userData->playState = PLAY_WAITING;
+    } else if ( userData->particleData[0] == INFINITY ) {
+        // The break is taken from behind the head string.
+        StartPlacing( userData, -spec->size[0], spec->headString,
+                spec->size[1], -spec->size[1] );
+    } else {
+        // Carom games start with the cue ball on its spot.
+        StartAiming( userData );
+    }
     return TRUE;
 }
 
-void RewindToImpact(GLfloat *pos1, GLfloat *pos2, GLfloat *posQuad1, GLfloat
-        *posQuad2, GLfloat *particleData, GLfloat *particleQuadData, GLuint
-        recursionLevel)
+///
+// Blend a table's newest tick, from where it began to where it ended, into
+// particleData and rebuild the quads.  Drawing lags the sim by up to one
+// tick in exchange for smooth motion at any frame rate.
+//
+void BlendTable ( UserData *userData, const struct SimState *currentState,
+        GLfloat *particleData, GLfloat *particleQuadData )
 {
-    if ( pos1 == pos2 ) {
-        fprintf(stderr, "RewindToImpact Error: pos1 == pos2\n");
-        return;
+    // The state is one tick old when it's published, so alpha runs from 0
+    // to 1 over the next tick's worth of time.
+    GLfloat alpha = (GLfloat) ((SimThreadNow() -
+            currentState->publishTime) * SIM_RATE);
+    if ( alpha < 0.0f ) {
+        alpha = 0.0f;
+    } else if ( alpha > 1.0f ) {
+        alpha = 1.0f;
     }
+    int i;
+    for ( i = 0 ; i < userData->ballCount ; ++i ) {
+        const GLfloat *from =
+            &currentState->previousParticleData[i * PARTICLE_SIZE];
+        const GLfloat *to = &currentState->particleData[i * PARTICLE_SIZE];
+        GLfloat *particle = &particleData[i * PARTICLE_SIZE];
+        GLfloat *quad = &particleQuadData[i * PARTICLE_QUAD_SIZE];
+
+        // Pocketed balls sit at INFINITY; don't blend towards or away from it.
+        if ( from[0] == INFINITY || to[0] == INFINITY ) {
+            memcpy( particle, to, sizeof(GLfloat) * PARTICLE_SIZE );
+        } else {
+            particle[0] = from[0] + (to[0] - from[0]) * alpha;
+            particle[1] = from[1] + (to[1] - from[1]) * alpha;
+            particle[2] = to[2];
+            particle[3] = to[3];
+        }
+        ParticleToQuad(particle, userData->ballHalfSide, quad);
+    }
+}
 
-    GLfloat tmpPos1[2];
-    GLfloat tmpPos2[2];
-
-    GLfloat tmpVec[2];
-
-    GLfloat initialDiff;
-    GLfloat impactDistanceSquared = 4*POINT_RADIUS*POINT_RADIUS;
-    distanceSquared(&initialDiff, &pos1[0], &pos2[0], 2);
-
-    // Copy positions from points to tmpPos.
-    memcpy(&tmpPos1[0], &pos1[0], sizeof(GLfloat) * 2);
-    memcpy(&tmpPos2[0], &pos2[0], sizeof(GLfloat) * 2);
-
-    GLfloat initialRewindFactor = 0.003f; // arbitrary small step.
-
-    // Take the first small step.
-    scale(&tmpVec[0], &pos1[2], initialRewindFactor, 2);
-    UMinusV(&tmpPos1[0], &pos1[0], &tmpVec[0], 2);
-    scale(&tmpVec[0], &pos2[2], initialRewindFactor, 2);
-    UMinusV(&tmpPos2[0], &pos2[0], &tmpVec[0], 2);
-
-    GLfloat secondDiff;
-    distanceSquared(&secondDiff, &tmpPos1[0], &tmpPos2[0], 2);
-
-    // Calculate how many more steps to take.
-    GLfloat numSteps = 100.0f;
-    if (impactDistanceSquared > 0.0f) {
-        numSteps = (1.0f - (secondDiff / impactDistanceSquared)) / ((secondDiff
-                - initialDiff) / impactDistanceSquared);
-    }
-
-    //numSteps += 350.0f; // TODO: bad bad fudge factor
-    numSteps += numSteps;
-
-    scale(&tmpVec[0], &pos1[2], numSteps * (fabs(secondDiff - initialDiff)),
-            2);
-    UMinusV(&tmpPos1[0], &pos1[0], &tmpVec[0], 2);
-    scale(&tmpVec[0], &pos2[2], numSteps * (fabs(secondDiff - initialDiff)),
-            2);
-    UMinusV(&tmpPos2[0], &pos2[0], &tmpVec[0], 2);
-
-    //printf("Moving (%f, %f) to (%f, %f)\n", pos1[0], pos1[1], tmpPos1[0], tmpPos1[1]);
-    //printf("Moving (%f, %f) to (%f, %f)\n\n", pos2[0], pos2[1], tmpPos2[0], tmpPos2[1]);
-    memcpy(&pos1[0], &tmpPos1[0], sizeof(GLfloat) * 2);
-    memcpy(&pos2[0], &tmpPos2[0], sizeof(GLfloat) * 2);
-    ParticleToQuad(pos1, posQuad1);
-    ParticleToQuad(pos2, posQuad2);
-    // This is mainly for the break when all balls are close together.
-    // Rewinding tends to get into another's space.
-    unsigned int i;
-    if(recursionLevel < 2) {
-        for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
-            GLfloat *pt = &particleData[i * PARTICLE_SIZE];
-            GLfloat *ptQuad = &particleQuadData[ i * PARTICLE_QUAD_SIZE ];
-            GLfloat distance;
-            if (pos1 != pt) {
-                distanceSquared(&distance, &pos1[0], &pt[0], 2);
-                if (distance <= 4*POINT_RADIUS*POINT_RADIUS ) {
-                    RewindToImpact(pos1, pt, posQuad1, ptQuad, particleData,
-                            particleQuadData, recursionLevel+1);
-                }
-            }
-            if (pos2 != pt) {
-                distanceSquared(&distance, &pos2[0], &pt[0], 2);
-                if (distance <= 4*POINT_RADIUS*POINT_RADIUS ) {
-                    RewindToImpact(pos2, pt, posQuad2, ptQuad, particleData,
-                            particleQuadData, recursionLevel+1);
-                }
-            }
+void InterpolateParticles ( UserData *userData )
+{
+    userData->currentState = *SimThreadLatest( &userData->sim );
+    BlendTable( userData, &userData->currentState,
+            &userData->particleData[0], &userData->particleQuadData[0] );
+}
+
+///
+// The wall's other tables, which look after themselves.
+//
+void UpdateWall ( UserData *userData )
+{
+    GLuint t;
+    for ( t = 1 ; t < userData->wall.count ; ++t ) {
+        struct WallTable *wallTable = &userData->wall.tables[t - 1];
+        if ( wallTable->live != NULL ) {
+            WallPoll( wallTable, userData->ballCount );
+        } else {
+            wallTable->currentState = *SimThreadLatest( &wallTable->sim );
         }
+        BlendTable( userData, &wallTable->currentState,
+                &wallTable->particleData[0], &userData->particleQuadData[ t *
+                    userData->ballCount * PARTICLE_QUAD_SIZE ] );
+        WallFeed( wallTable, userData->ballCount );
     }
 }
 
-void ParticleCollision(GLfloat *pos1, GLfloat *pos2)
+///
+// Solve the shot from the current (resting) positions with the cue ball
+// given velocity, and upload it once.  Returns FALSE if the shot doesn't fit
+// in the keyframes the shader has room for, in which case the sim plays it.
+//
+int StartPlayback ( UserData *userData, GLfloat x, GLfloat y )
 {
-    if (pos1 == pos2) {
-        fprintf(stderr, "Collision Error: pos1 == pos2\n");
-        return;
+    struct Trajectory *trajectory = &userData->trajectory;
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLfloat center[] = { 0.0f, 0.0f };
+    GLfloat corners[ PARTICLE_QUAD_SIZE ];
+    GLuint i, j;
+
+    memcpy( particleData, userData->particleData, sizeof(particleData) );
+    particleData[2] = x;
+    particleData[3] = y;
+    if ( !BuildTrajectory( trajectory, particleData, userData->table ) ) {
+        fprintf( stderr, "Shot too long for playback, simulating it\n" );
+        return FALSE;
     }
-    GLfloat newVel1[2];
-    GLfloat newVel2[2];
-    GLfloat dir1[2];
-    GLfloat dir2[2];
-    GLfloat tmpVec[2];
 
-    UMinusV(&dir1[0], &pos2[0], &pos1[0], 2);
-    UMinusV(&dir2[0], &pos1[0], &pos2[0], 2);
+    for ( i = 0 ; i < trajectory->keyframeCount ; ++i ) {
+        const struct Keyframe *keyframe = &trajectory->keyframes[i];
+        userData->playbackKeyframes[4 * i + 0] = keyframe->position[0];
+        userData->playbackKeyframes[4 * i + 1] = keyframe->position[1];
+        userData->playbackKeyframes[4 * i + 2] = keyframe->velocity[0];
+        userData->playbackKeyframes[4 * i + 3] = keyframe->velocity[1];
+        userData->playbackKeyframeTimes[i] = keyframe->time;
+    }
+    glUseProgram ( userData->particlesProgram );
+    glUniform4fv ( userData->particlesKeyframesLoc, trajectory->keyframeCount,
+            userData->playbackKeyframes );
+    glUniform1fv ( userData->particlesKeyframeTimesLoc,
+            trajectory->keyframeCount, userData->playbackKeyframeTimes );
+
+    // Each vertex is its corner's offset from the centre, its texture coords
+    // and its ball's keyframes.
+    ParticleToQuad( center, userData->ballHalfSide, corners );
+    GLfloat *vertex = &userData->playbackVertices[0];
+    for ( i = 0 ; i < (GLuint) userData->ballCount ; ++i ) {
+        const GLfloat *quad = &userData->particleQuadData[i * PARTICLE_QUAD_SIZE];
+        for ( j = 0 ; j < PARTICLE_QUAD_SIZE / PARTICLE_SIZE ; ++j ) {
+            (*vertex++) = corners[j * PARTICLE_SIZE];
+            (*vertex++) = corners[j * PARTICLE_SIZE + 1];
+            (*vertex++) = quad[j * PARTICLE_SIZE + 2];
+            (*vertex++) = quad[j * PARTICLE_SIZE + 3];
+            (*vertex++) = (GLfloat) trajectory->first[i];
+            (*vertex++) = (GLfloat) trajectory->count[i];
+        }
+    }
+    glBindBuffer( GL_ARRAY_BUFFER, userData->playbackBuffer );
+    glBufferData( GL_ARRAY_BUFFER, (GLsizeiptr) ( vertex -
+                userData->playbackVertices ) * sizeof(GLfloat),
+            userData->playbackVertices, GL_STATIC_DRAW );
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+
+    userData->playing = TRUE;
+    userData->playbackFinished = FALSE;
+    userData->playbackStart = userData->time;
+    return TRUE;
+}
 
-    memcpy(&newVel1[0], &pos1[2], sizeof(GLfloat) * 2);
-    memcpy(&newVel2[0], &pos2[2], sizeof(GLfloat) * 2);
+///
+// Once the shot is over, tell the sim where everything ended up.  Keep
+// showing the last playback frame until it has taken the new positions so
+// the balls don't flash back to where the shot started.
+//
+void UpdatePlayback ( UserData *userData )
+{
+    struct Trajectory *trajectory = &userData->trajectory;
+    float playbackTime = userData->time - userData->playbackStart;
+    GLint i;
 
-    projectUonV2f(&tmpVec[0], &pos2[2], &dir1[0]);
-    UPlusV(&newVel1[0], &newVel1[0], &tmpVec[0], 2);
-    projectUonV2f(&tmpVec[0], &pos1[2], &dir2[0]);
-    UMinusV(&newVel1[0], &newVel1[0], &tmpVec[0], 2);
+    if ( !userData->playbackFinished && playbackTime >= trajectory->duration ) {
+        for ( i = 0 ; i < userData->ballCount ; ++i ) {
+            const GLfloat *point = &trajectory->finalParticleData[i * PARTICLE_SIZE];
+            SubmitCommand( userData, SIM_COMMAND_PLACE, i, point[0], point[1] );
+        }
+        userData->playbackFinished = TRUE;
+    }
+    if ( userData->playbackFinished ) {
+        const struct SimState *state = SimThreadLatest( &userData->sim );
+        if ( state->commandsApplied == userData->commandsSubmitted ) {
+            userData->currentState = *state;
+            userData->playing = FALSE;
+            return;
+        }
+        playbackTime = trajectory->duration;
+    }
+    glUniform1f ( userData->particlesTimeLoc, playbackTime );
+}
 
-    projectUonV2f(&tmpVec[0], &pos1[2], &dir1[0]);
-    UPlusV(&newVel2[0], &newVel2[0], &tmpVec[0], 2);
-    projectUonV2f(&tmpVec[0], &pos2[2], &dir2[0]);
-    UMinusV(&newVel2[0], &newVel2[0], &tmpVec[0], 2);
+void PlaceCueBall( UserData *userData )
+{
+    // The sim addresses balls by their slot in particleData.
+    const struct ball *ball = &userData->balls[0];
+    GLint slot = (ball->position - &userData->particleData[0]) / PARTICLE_SIZE;
+    SubmitCommand( userData, SIM_COMMAND_PLACE, slot, userData->candidate[0],
+            userData->candidate[1] );
+    userData->playState = PLAY_WAITING;
+}
 
-    memcpy(&pos1[2], &newVel1[0], sizeof(GLfloat) * 2);
-    memcpy(&pos2[2], &newVel2[0], sizeof(GLfloat) * 2);
+void Shoot( UserData *userData, GLfloat x, GLfloat y )
+{
+    if ( !userData->playbackEnabled || !StartPlayback( userData, x, y ) ) {
+        SubmitCommand( userData, SIM_COMMAND_SHOOT, 0, x, y );
+    } else if ( userData->recorder != NULL ) {
+        // The sim only gets the end positions, which the recorder will take
+        // as places after it has rolled the shot itself.
+        struct SimCommand command = { SIM_COMMAND_SHOOT, 0, { x, y } };
+        ReplayRecord( userData->recorder, &command );
+    }
+    userData->playState = PLAY_WAITING;
 }
 
-void CheckForParticleCollisions ( GLfloat *particleData, GLfloat *particleQuadData )
+void HandlePlacing( UserData *userData, const struct InputCommand *command )
 {
-    int i;
-    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
-        int j;
-        GLfloat *point1 = &particleData[i * PARTICLE_SIZE];
-        GLfloat *pointQuad1 = &particleQuadData[ i * PARTICLE_QUAD_SIZE ];
-        for ( j = i+1 ; j < NUM_PARTICLES ; ++j ) {
-            GLfloat *point2 = &particleData[j * PARTICLE_SIZE];
-            GLfloat *pointQuad2 = &particleQuadData[ j * PARTICLE_QUAD_SIZE  ];
-            GLfloat diff1 = point1[0] - point2[0];
-            GLfloat diff2 = point1[1] - point2[1];
-
-            if (diff1*diff1 + diff2*diff2 <= 4*POINT_RADIUS*POINT_RADIUS) {
-                //printf("Collision: (%f, %f), (%f, %f)\n", point1[0], point1[1],
-                //        point2[0], point2[1]);
-                RewindToImpact(point1, point2, pointQuad1, pointQuad2,
-                        particleData, particleQuadData, 0);
-                ParticleCollision(point1, point2);
+    const GLfloat *boundary = &userData->placeBoundary[0];
+    GLfloat *candidate = &userData->candidate[0];
+    GLfloat x = command->value[0];
+    GLfloat y = command->value[1];
+
+    switch ( command->type ) {
+        case INPUT_POINT:
+        case INPUT_PLACE:
+            if ( !InsideBoundary( boundary, x, y ) ) {
+                StartPlacing( userData, boundary[0], boundary[1], boundary[2],
+                        boundary[3] );
+                break;
             }
-        }
+            candidate[0] = x;
+            candidate[1] = y;
+            userData->hasCandidate = TRUE;
+            if ( command->type == INPUT_PLACE ) {
+                PlaceCueBall( userData );
+            } else {
+                printf( "Confirm [y/n]: " );
+                fflush( stdout );
+            }
+            break;
+        case INPUT_MOVE:
+            if ( !userData->hasCandidate ) {
+                candidate[0] = ( boundary[0] + boundary[1] ) * 0.5f;
+                candidate[1] = ( boundary[2] + boundary[3] ) * 0.5f;
+                userData->hasCandidate = TRUE;
+            }
+            candidate[0] = fminf( fmaxf( candidate[0] + x, boundary[0] ),
+                    boundary[1] );
+            candidate[1] = fminf( fmaxf( candidate[1] + y, boundary[3] ),
+                    boundary[2] );
+            break;
+        case INPUT_CONFIRM:
+            if ( userData->hasCandidate ) {
+                PlaceCueBall( userData );
+                break;
+            }
+            // Fall through, nothing to confirm yet.
+        case INPUT_CANCEL:
+            StartPlacing( userData, boundary[0], boundary[1], boundary[2],
+                    boundary[3] );
+            break;
+        default:
+            fprintf( stderr, "Place the cue ball first\n" );
+            break;
     }
 }
 
-void CheckForBoundaryCollisions( GLfloat *particleData, GLfloat *v, GLushort
-        *e, GLint elementsSize, GLfloat *n )
+void HandleAiming( UserData *userData, const struct InputCommand *command )
 {
-    // boundaryPoints is counter-clockwise starting at the lower left
-    int i;
-    for( i = 0 ; i < NUM_PARTICLES ; ++i ) {
-        GLfloat *point = &particleData[i * PARTICLE_SIZE];
-        if ( point[0] == INFINITY )
-            continue;
-        unsigned int i;
-        for ( i = 1 ; i < elementsSize ; i+=2 ) {
-            GLfloat v1[2], v2[2], v3[2], v4[2], v5[2];
-            GLfloat point2[2];
-            // TODO: maybe precompute this.
-            v1[0] = v[2*e[i]] - v[2*e[i-1]];
-            v1[1] = v[2*e[i]+1] - v[2*e[i-1]+1];
-            normalize2f(&v1[0]);
-
-            v2[0] = point[0] - v[2*e[i-1]];
-            v2[1] = point[1] - v[2*e[i-1]+1];
-            normalize2f(&v2[0]);
-
-            v3[0] = point[0] - v[2*e[i]];
-            v3[1] = point[1] - v[2*e[i]+1];
-            normalize2f(&v3[0]);
-
-            // point2 is just point1 moved along its velocity a small time step.
-            point2[0] = point[0] + (SMALL_TIME_STEP * point[2]);
-            point2[1] = point[1] + (SMALL_TIME_STEP * point[3]);
-
-            v4[0] = point2[0] - v[2*e[i-1]];
-            v4[1] = point2[1] - v[2*e[i-1]+1];
-
-            v5[0] = point2[0] - v[2*e[i]];
-            v5[1] = point2[1] - v[2*e[i]+1];
-
-            GLfloat result1, result2, result3, result4, result5;
-            UDotV(&result1, &v1[0], &v2[0], 2);
-            result1 = acos(result1);
-
-            scalarU(&v1[0], &v1[0], -1.0f, 2);
-            UDotV(&result2, &v1, &v3, 2);
-            result2 = acos(result2);
-
-            GLfloat normal[2];
-
-            normal[0] = v1[1];
-            normal[1] = -v1[0];
-
-            UDotV(&result3, &point[2], &normal[0], 2);
-            GLfloat size;
-
-            UDotV(&result4, &v4[0], &normal[0], 2);
-            UDotV(&result5, &v5[0], &normal[0], 2);
-
-            distanceSquared(&size, &v[2*e[i]], &v[2*e[i-1]], 2);
-            size = sqrt(size);
-
-            if ( result3 < 0.0f && result1 < HALFPI && result2 < HALFPI ) {
-                if( ((result1 <= -0.14707f * size + 0.21279f && result2 < HALFPI)
-                        || (result2 <= -0.14707f * size + 0.21279f && result1 <
-                        HALFPI)) || result4 < 0.0f || result5 < 0.0f ) {
-                    if(((i - 1) / 2) % 4 == 1) {
-                        // This makes me cringe.
-                        point[0] = INFINITY;
-                        point[1] = INFINITY;
-                        point[2] = 0.0f;
-                        point[3] = 0.0f;
-                    } else {
-                        reflectAboutNormal2f(&point[2], &point[2], &normal[0]);
-                    }
-                }
-            }
-        }
+    switch ( command->type ) {
+        case INPUT_POINT:
+        case INPUT_SHOOT:
+            Shoot( userData, command->value[0], command->value[1] );
+            break;
+        case INPUT_MOVE:
+            userData->aim[0] += command->value[0];
+            userData->aim[1] += command->value[1];
+            break;
+        case INPUT_CONFIRM:
+            Shoot( userData, userData->aim[0], userData->aim[1] );
+            break;
+        case INPUT_CANCEL:
+            userData->aim[0] = 0.0f;
+            userData->aim[1] = 0.0f;
+            break;
+        default:
+            fprintf( stderr, "The cue ball can only be moved after a "
+                    "scratch\n" );
+            break;
     }
 }
 
-int CheckForMovement( GLfloat *particleData )
+///
+// Instead of asking the player, give the sim the replay's commands up to and
+// including the next shot.  At the end of the replay the player takes over.
+//
+void HandleReplay( UserData *userData )
 {
-    int i;
-    for ( i=0 ; i < NUM_PARTICLES ; ++i ) {
-        GLfloat *point = &particleData[i * PARTICLE_SIZE];
-        if (fabs(point[2]) > 0.0f || fabs(point[3]) > 0.0f) {
-            return 1;
+    struct SimCommand command;
+    while ( ReplayNextCommand( &userData->replayCursor, &command ) ) {
+        SubmitCommand( userData, command.type, command.ball, command.value[0],
+                command.value[1] );
+        if ( command.type == SIM_COMMAND_SHOOT ) {
+            return;
         }
     }
-    return 0;
+    printf( "End of replay\n" );
+    ReplayFree( userData->replay );
+    free( userData->replay );
+    userData->replay = NULL;
 }
 
-void UpdatePositions ( ESContext *esContext, float deltaTime )
+///
+// Take whatever the input thread has queued, as long as we're asking for
+// something.  While the balls are rolling commands wait in the queue, so
+// typing ahead works like it did with a blocking read.
+//
+void HandleInput( UserData *userData )
 {
-    UserData *userData = esContext->userData;
-    GLfloat *particleData = &userData->particleData[0];
-    GLfloat *particleQuadData = &userData->particleQuadData[0];
-    CheckForParticleCollisions( particleData, particleQuadData );
-    CheckForBoundaryCollisions( particleData, userData->table->vCollision,
-            userData->table->eCollision, userData->table->collisionElementsSize,
-            userData->table->nCollision );
-    {
-        int i;
-        for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
-            particleData = &userData->particleData[i * PARTICLE_SIZE];
-            particleQuadData = &userData->particleQuadData[i * PARTICLE_QUAD_SIZE];
-
-            particleData[0] += particleData[2] * deltaTime;
-            particleData[1] += particleData[3] * deltaTime;
-            ParticleToQuad(particleData, particleQuadData);
-
-            GLfloat tmpAccelVec[2];
-            scale(&tmpAccelVec[0], &particleData[2], POINT_ACCELERATION * deltaTime, 2);
-            UPlusV(&particleData[2], &particleData[2], &tmpAccelVec[0], 2);
-            if(fabs(particleData[2]) < 0.01f) {
-                particleData[2] = 0.0f;
-            }
-            if(fabs(particleData[3]) < 0.01f) {
-                particleData[3] = 0.0f;
-            }
+    struct InputCommand command;
+    while ( userData->playState != PLAY_WAITING &&
+            ( InputPoll( &userData->input, &command ) ||
+              ControlServerPoll( userData->control, &command ) ) ) {
+        if ( userData->playState == PLAY_PLACING ) {
+            HandlePlacing( userData, &command );
+        } else {
+            HandleAiming( userData, &command );
         }
     }
 }
@@ -993,8 +1514,10 @@ void UpdatePositions ( ESContext *esContext, float deltaTime )
 void Update ( ESContext *esContext, float deltaTime )
 {
     UserData *userData = esContext->userData;
-    GLfloat *particleData = &userData->particleData[0];
 
+    if ( FramePacerBegin( &userData->pacer ) ) {
+        FramePacerReport( &userData->pacer, stderr );
+    }
     userData->time += deltaTime;
     // Load uniform time variable
 
@@ -1002,39 +1525,95 @@ void Update ( ESContext *esContext, float deltaTime )
     glUniform1f ( userData->particlesTimeLoc, userData->time );
     //glUseProgram ( userData->tableProgram );
     //glUniform1f ( userData->tableTimeLoc, userData->time );
-    float scanfTime = 0.0f;
-    if (!CheckForMovement( particleData )) {
-        if ( userData->balls[0].position[0] == INFINITY &&
-             userData->balls[0].position[1] == INFINITY ) {
-            GLfloat boundary[] = { -WIDTH, WIDTH, HEIGHT, -HEIGHT };
-            scanfTime += PlaceBall( esContext, userData->balls[0], &boundary[0] );
+    if ( userData->playing ) {
+        UpdatePlayback( userData );
+        if ( userData->playing ) {
+            return;
+        }
+    }
+    InterpolateParticles( userData );
+    UpdateWall( userData );
+
+    // Only ask for the next shot once the sim has seen every command we sent
+    // and everything has come to rest.
+    const struct SimState *state = &userData->currentState;
+    if ( userData->playState == PLAY_WAITING &&
+         state->commandsApplied == userData->commandsSubmitted &&
+         !state->moving ) {
+        if ( userData->replay != NULL ) {
+            HandleReplay( userData );
+        } else if ( state->particleData[0] == INFINITY &&
+             state->particleData[1] == INFINITY ) {
+            const struct TableSpec *spec = &userData->spec;
+            StartPlacing( userData, -spec->size[0], spec->size[0],
+                    spec->size[1], -spec->size[1] );
+        } else {
+            StartAiming( userData );
         }
-        printf("Enter Velocity: ");
-        float x, y;
-        struct timeval t1, t2;
-        struct timezone tz;
-        gettimeofday ( &t1 , &tz );
-        scanf("%f %f", &x, &y);
-        gettimeofday( &t2, &tz );
-        scanfTime += (float)(t2.tv_sec - t1.tv_sec + (t2.tv_usec - t1.tv_usec) * 1e-6);
-        particleData[2] = (GLfloat) x;
-        particleData[3] = (GLfloat) y;
-    }
-    UpdatePositions( esContext, deltaTime - userData->pauseTime );
-    userData->pauseTime = scanfTime;
+    }
+    HandleInput( userData );
+
+    if ( userData->hasCandidate ) {
+        const struct ball *ball = &userData->balls[0];
+        ball->position[0] = userData->candidate[0];
+        ball->position[1] = userData->candidate[1];
+        ball->position[2] = 0.0f;
+        ball->position[3] = 0.0f;
+        ParticleToQuad( ball->position, userData->ballHalfSide, ball->quad );
+    }
 }
 
-void DrawParticles ( ESContext *esContext )
+///
+// Balls during playback.  Everything comes from the buffer uploaded by
+// StartPlayback; the shader positions them from u_time.
+//
+void DrawPlayback ( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
-    //glEnable( GL_DEPTH_TEST );
-    //glClearDepthf(1.0f);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable( GL_BLEND );
+    GLsizei stride = PLAYBACK_VERTEX_SIZE * sizeof(GLfloat);
+
+    glUniform1i ( userData->particlesPlaybackLoc, 1 );
+    glBindBuffer ( GL_ARRAY_BUFFER, userData->playbackBuffer );
+    glVertexAttribPointer ( userData->particlesStartPositionLoc, 2, GL_FLOAT,
+            GL_FALSE, stride, (const void *) 0 );
+    glVertexAttribPointer ( userData->particlesQuadTexLoc, 2, GL_FLOAT,
+            GL_FALSE, stride, (const void *) (2 * sizeof(GLfloat)) );
+    glVertexAttribPointer ( userData->particlesKeyframeRangeLoc, 2, GL_FLOAT,
+            GL_FALSE, stride, (const void *) (4 * sizeof(GLfloat)) );
+    glEnableVertexAttribArray ( userData->particlesStartPositionLoc );
+    glEnableVertexAttribArray ( userData->particlesQuadTexLoc );
+    glEnableVertexAttribArray ( userData->particlesKeyframeRangeLoc );
 
+    glUniform1i ( userData->particlesSamplerLoc, 0 );
+    glUniformMatrix4fv(userData->particlesMVPLoc, 1, GL_FALSE,
+                       &userData->particlesMVP.m[0][0]);
+    glUniform4fv ( userData->particlesColorLoc, 1, &userData->particlesColor[0] );
 
-    // Use the program object
-    glUseProgram ( userData->particlesProgram );
+    glDrawArrays( GL_TRIANGLES, 0, userData->ballCount *
+            (PARTICLE_QUAD_SIZE / PARTICLE_SIZE) );
+
+    glDisableVertexAttribArray ( userData->particlesKeyframeRangeLoc );
+    glBindBuffer ( GL_ARRAY_BUFFER, 0 );
+}
+
+///
+// The balls' RenderItem.  The queue has the program and atlas bound.
+//
+void DrawParticles ( void *context, const struct RenderItem *item )
+{
+    ESContext *esContext = context;
+    UserData *userData = esContext->userData;
+    GLint vertices = userData->ballCount * (PARTICLE_QUAD_SIZE / PARTICLE_SIZE);
+    (void) item;
+
+    if ( userData->playing ) {
+        DrawPlayback( esContext );
+        return;
+    }
+    glUniform1i ( userData->particlesPlaybackLoc, 0 );
+    if ( userData->particlesKeyframeRangeLoc >= 0 ) {
+        glDisableVertexAttribArray ( userData->particlesKeyframeRangeLoc );
+    }
 
     //glVertexAttribPointer ( userData->particlesStartPositionLoc, 2, GL_FLOAT,
     //        GL_FALSE, PARTICLE_SIZE * sizeof(GLfloat),
@@ -1056,14 +1635,6 @@ void DrawParticles ( ESContext *esContext )
 
     glEnableVertexAttribArray ( userData->particlesStartPositionLoc );
     glEnableVertexAttribArray ( userData->particlesQuadTexLoc );
-    // Blend particles
-    //glEnable ( GL_BLEND );
-    //glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
-
-    // Bind the texture
-    glActiveTexture ( GL_TEXTURE0 );
-    glBindTexture ( GL_TEXTURE_2D, userData->particlesTextureId );
-    glEnable ( GL_TEXTURE_2D );
 
     // Set the sampler texture unit to 0
     glUniform1i ( userData->particlesSamplerLoc, 0 );
@@ -1087,15 +1658,38 @@ void DrawParticles ( ESContext *esContext )
     //    glViewport ( 0, 0, esContext->width, esContext->height );
     //}
     glUniform4fv ( userData->particlesColorLoc, 1, &userData->particlesColor[0] );
-    glDrawArrays( GL_TRIANGLES, 0, NUM_PARTICLES * (PARTICLE_QUAD_SIZE / PARTICLE_SIZE) );
+    if ( userData->wall.count == 1 ) {
+        glDrawArrays( GL_TRIANGLES, 0, vertices );
+        return;
+    }
+    // Every table's balls at once.
+    glVertexAttribPointer ( userData->particlesCellLoc, 1, GL_FLOAT, GL_FALSE,
+            0, userData->wallBallCells );
+    glEnableVertexAttribArray ( userData->particlesCellLoc );
+    glDrawArrays( GL_TRIANGLES, 0, vertices * userData->wall.count );
+    glDisableVertexAttribArray ( userData->particlesCellLoc );
 }
 
-void DrawQuad( ESContext *esContext )
+///
+// Stretch the width x height corner of target over the bound framebuffer.
+//
+void DrawQuad( ESContext *esContext, const struct RenderTarget *target,
+        GLint width, GLint height )
 {
     UserData *userData = esContext->userData;
 
     glUseProgram( userData->quadProgram );
 
+    // From the centre of the first texel to the centre of the last, so the
+    // filter never reaches past the corner.
+    GLfloat texTransform[4] = {
+        (GLfloat) (width - 1) / target->width,
+        (GLfloat) (height - 1) / target->height,
+        0.5f / target->width,
+        0.5f / target->height,
+    };
+    glUniform4fv( userData->quadTexTransformLoc, 1, texTransform );
+
     glEnableVertexAttribArray ( userData->quadPositionLoc );
     glEnableVertexAttribArray ( userData->quadTexCoord );
 
@@ -1105,9 +1699,8 @@ void DrawQuad( ESContext *esContext )
     glVertexAttribPointer ( userData->quadTexCoord, 2, GL_FLOAT, GL_FALSE, 4 *
             sizeof(GLfloat), &userData->quad->v[2] );
 
-    // TODO: replace with renderToTexTexture.
     glActiveTexture ( GL_TEXTURE0 );
-    glBindTexture ( GL_TEXTURE_2D, userData->renderToTexTexture );
+    glBindTexture ( GL_TEXTURE_2D, target->colorTexture );
     glEnable ( GL_TEXTURE_2D );
 
     // Set the sampler texture unit to 0
@@ -1118,155 +1711,203 @@ void DrawQuad( ESContext *esContext )
             GL_UNSIGNED_SHORT, &userData->quad->e[0] );
 }
 
-void DrawTable( ESContext *esContext )
-{
-    UserData *userData = esContext->userData;
-
-    glUseProgram ( userData->tableProgram );
-    GLfloat color[] = { 0.0f, 0.2f, 0.0f, 1.0f };
-    glUniform4fv ( userData->tableColorLoc, 1, color );
-
-    glVertexAttribPointer ( userData->tableStartPositionLoc, 2, GL_FLOAT,
-            GL_FALSE, 0, &userData->table->vTable[0] );
-    glEnableVertexAttribArray ( userData->tableStartPositionLoc );
-    //glDisable( GL_DEPTH_TEST );
-    glEnable ( GL_BLEND );
-    glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
-    glDrawElements ( GL_TRIANGLES, userData->table->tableElementsSize,
-            GL_UNSIGNED_SHORT, &userData->table->eTable[0] );
-}
+// The table's meshes are opaque.  They used to be added onto each other, so
+// each colour is what that sum came to: the rails and holes lie on the felt,
+// the ticks on the felt alone.
+static const GLfloat tableColor[] = { 0.0f, 0.2f, 0.0f, 1.0f };
+static const GLfloat railsColor[] = { 0.0f, 0.4f, 0.0f, 1.0f };
+static const GLfloat holesColor[] = { 0.0f, 0.4f, 0.0f, 1.0f };
+static const GLfloat ticksColor[] = { 0.4f, 0.4f, 0.4f, 1.0f };
 
-void DrawRails( ESContext *esContext )
+///
+// A table mesh's RenderItem.  The queue has tableProgram bound.
+//
+void DrawTableMesh( void *context, const struct RenderItem *item )
 {
+    ESContext *esContext = context;
     UserData *userData = esContext->userData;
 
-    glUseProgram ( userData->tableProgram );
-    GLfloat color[] = { 0.0f, 0.2f, 0.0f, 1.0f };
-    glUniform4fv ( userData->tableColorLoc, 1, color );
+    glUniformMatrix4fv(userData->tableMVPLoc, 1, GL_FALSE,
+                       &userData->tableMVP.m[0][0]);
+    glUniform4fv ( userData->tableColorLoc, 1, item->color );
 
     glVertexAttribPointer ( userData->tableStartPositionLoc, 2, GL_FLOAT,
-            GL_FALSE, 0, &userData->table->vRails[0] );
+            GL_FALSE, 0, &item->mesh->v[0] );
     glEnableVertexAttribArray ( userData->tableStartPositionLoc );
-    glDisable( GL_DEPTH_TEST );
-    glEnable ( GL_BLEND );
-    //glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
-    glDrawElements ( GL_TRIANGLES, userData->table->railsElementsSize,
-            GL_UNSIGNED_SHORT, &userData->table->eRails[0] );
+    // On a wall, which table each vertex is on.
+    if ( item->data != NULL ) {
+        glVertexAttribPointer ( userData->tableCellLoc, 1, GL_FLOAT,
+                GL_FALSE, 0, item->data );
+        glEnableVertexAttribArray ( userData->tableCellLoc );
+    }
+    glDrawElements ( GL_TRIANGLES, item->mesh->elementsSize,
+            GL_UNSIGNED_SHORT, &item->mesh->e[0] );
+    if ( item->data != NULL ) {
+        glDisableVertexAttribArray ( userData->tableCellLoc );
+    }
 }
 
-void DrawHoles( ESContext *esContext )
+void QueueTableMesh( ESContext *esContext, GLint model,
+        const GLfloat *color, GLint layer )
 {
     UserData *userData = esContext->userData;
+    const struct Mesh *mesh = TableMesh( userData, model );
+    struct RenderItem *item;
 
-    glUseProgram ( userData->tableProgram );
-    GLfloat color[] = { 0.0f, 0.2f, 0.0f, 1.0f };
-    glUniform4fv ( userData->tableColorLoc, 1, color );
-
-    glVertexAttribPointer ( userData->tableStartPositionLoc, 2, GL_FLOAT,
-            GL_FALSE, 0, &userData->table->vHoles[0] );
-    glEnableVertexAttribArray ( userData->tableStartPositionLoc );
-    //glDisable( GL_DEPTH_TEST );
-    //glDisable ( GL_BLEND );
-    glDrawElements ( GL_TRIANGLES, userData->table->holesElementsSize,
-            GL_UNSIGNED_SHORT, &userData->table->eHoles[0] );
+    // Models a table leaves out have nothing to draw.
+    if ( mesh->elementsSize == 0 ||
+            ( item = RenderQueueAdd( &userData->renderQueue ) ) == NULL ) {
+        return;
+    }
+    item->mesh = mesh;
+    if ( userData->wall.count > 1 ) {
+        item->mesh = &userData->wallMeshes[model];
+        item->data = userData->wallMeshCells[model];
+    }
+    item->color = color;
+    item->program = userData->tableProgram;
+    item->blend = RENDER_BLEND_OPAQUE;
+    item->layer = layer;
+    item->draw = DrawTableMesh;
+    item->context = esContext;
 }
 
-void DrawTicks( ESContext *esContext )
+void QueueBilliardsTable( ESContext *esContext )
 {
-    UserData *userData = esContext->userData;
-
-    glUseProgram ( userData->tableProgram );
-    GLfloat color[] = { 0.4f, 0.2f, 0.4f, 1.0f };
-    glUniform4fv ( userData->tableColorLoc, 1, color );
-
-    glVertexAttribPointer ( userData->tableStartPositionLoc, 2, GL_FLOAT,
-            GL_FALSE, 0, &userData->table->vTicks[0] );
-    glEnableVertexAttribArray ( userData->tableStartPositionLoc );
-    //glDisable( GL_DEPTH_TEST );
-    glEnable ( GL_BLEND );
-    glBlendFunc ( GL_SRC_ALPHA, GL_ONE );
-    glDrawElements ( GL_TRIANGLES, userData->table->ticksElementsSize,
-            GL_UNSIGNED_SHORT, &userData->table->eTicks[0] );
+    QueueTableMesh( esContext, TABLE_MODEL_TABLE, tableColor, LAYER_TABLE );
+    QueueTableMesh( esContext, TABLE_MODEL_RAILS, railsColor, LAYER_RAILS );
+    QueueTableMesh( esContext, TABLE_MODEL_HOLES, holesColor, LAYER_HOLES );
+    QueueTableMesh( esContext, TABLE_MODEL_TICKS, ticksColor, LAYER_TICKS );
 }
 
-void DrawBilliardsTable( ESContext *esContext )
+void QueueParticles( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
-    glUseProgram (userData->tableProgram);
-
-    glUniformMatrix4fv(userData->tableMVPLoc, 1, GL_FALSE,
-                       &userData->tableMVP.m[0][0]);
-    DrawTable(esContext);
-    DrawRails(esContext);
-    DrawHoles(esContext);
-    DrawTicks(esContext);
-    //UserData *userData = esContext->userData;
-
-    //glUseProgram ( userData->particlesProgram );
-    //glUniform1i ( userData->particlesUseTexture, 0 );
+    struct RenderItem *item = RenderQueueAdd( &userData->renderQueue );
 
-    //glVertexAttribPointer ( userData->particlesStartPositionLoc, 2, GL_FLOAT,
-    //        GL_FALSE, 0, &userData->table->v[0] );
-    //glDrawElements ( GL_TRIANGLES, userData->table->elementsSize,
-    //        GL_UNSIGNED_SHORT, &userData->table->e[0] );
+    if ( item == NULL ) {
+        return;
+    }
+    item->program = userData->particlesProgram;
+    item->texture = userData->particlesTextureId;
+    // The atlas tool premultiplies so its mip levels filter correctly.
+    item->blend = userData->ballAtlas.premultiplied ?
+        RENDER_BLEND_PREMULTIPLIED : RENDER_BLEND_ALPHA;
+    item->layer = LAYER_BALLS;
+    item->draw = DrawParticles;
+    item->context = esContext;
 }
 
-int ReadPixels( ESContext *esContext )
+///
+// Pick what glReadPixels should return.  The implementation's preferred
+// format saves a conversion in the driver, but we only take it when it is
+// 8 bits per channel; otherwise fall back to GL_RGBA/GL_UNSIGNED_BYTE, which
+// every implementation must support.
+//
+GLuint GetReadFormat( GLenum *readFormat, GLenum *readType )
 {
-    UserData *userData = esContext->userData;
-
-    GLenum readType, readFormat;
-    GLubyte *pixels;
-
-    glBindFramebuffer( GL_FRAMEBUFFER, userData->renderToTexFramebuffer );
-    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &readType);
-    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &readFormat);
+    GLint format, type;
+    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &type);
+    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &format);
 
-    unsigned int bytesPerPixel = 0;
+    *readFormat = GL_RGBA;
+    *readType = GL_UNSIGNED_BYTE;
+    unsigned int bytesPerPixel = 4;
 
-    switch (readType) {
+    switch (type) {
         case GL_UNSIGNED_BYTE:
-            switch (readFormat) {
+            switch (format) {
                 case GL_RGBA:
-                    bytesPerPixel = 4;
                     break;
                 case GL_RGB:
+                    *readFormat = GL_RGB;
                     bytesPerPixel = 3;
                     break;
-                case GL_LUMINANCE_ALPHA:
-                    bytesPerPixel = 2;
-                    break;
-                case GL_ALPHA:
-                case GL_LUMINANCE:
-                    bytesPerPixel = 1;
-                    break;
             }
             break;
             //case GL_UNSIGNED_SHORT_4444:
             //case GL_UNSIGNED_SHORT_555_1:
             //case GL_UNSIGNED_SHORT_565:
             default:
-                bytesPerPixel = 2;
                 break;
     }
-    pixels = (GLubyte*) malloc(RENDER_TO_TEX_WIDTH * RENDER_TO_TEX_HEIGHT *
-            bytesPerPixel);
-    glReadPixels(0, 0, RENDER_TO_TEX_WIDTH, RENDER_TO_TEX_HEIGHT, readFormat,
-            readType, pixels );
-    int retval = FALSE;
-    {
-        int i;
-        for( i = 0 ; i < (RENDER_TO_TEX_WIDTH * RENDER_TO_TEX_HEIGHT) / 4 ; ++i ){
-            //printf("%d %d %d %d\n", pixels[4*i], pixels[4*i+1], pixels[4*i+2],
-            //        pixels[4*i+3]);
-            if (pixels[4*i] == 255 && pixels[4*i+1] == 0 && pixels[4*i+2] == 0) {
-                retval = TRUE;
-            }
+    return bytesPerPixel;
+}
+
+///
+// Read the bound framebuffer into a pooled frame.  The frame's format must
+// come from GetReadFormat.
+//
+void ReadPixels( GLuint framebuffer, struct Frame *frame )
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadPixels( 0, 0, frame->width, frame->height, frame->format,
+            frame->type, frame->pixels );
+}
+
+///
+// Hand the frame just drawn to the capture workers.  This blocks only when
+// every pooled buffer is still waiting to be encoded.
+//
+void CaptureFrame( UserData *userData )
+{
+    struct Frame *frame = FrameCaptureAcquire( &userData->capture );
+    frame->format = userData->readFormat;
+    frame->type = userData->readType;
+    ReadPixels( userData->captureFramebuffer, frame );
+    FrameCaptureSubmit( &userData->capture, frame );
+}
+
+int StartCapture( ESContext *esContext, const struct Options *options )
+{
+    UserData *userData = esContext->userData;
+    GLuint bytesPerPixel;
+
+    if ( options->captureDirectory == NULL && options->videoPath == NULL ) {
+        return TRUE;
+    }
+    glBindFramebuffer( GL_FRAMEBUFFER, userData->captureFramebuffer );
+    bytesPerPixel = GetReadFormat( &userData->readFormat, &userData->readType );
+
+    if ( options->videoPath != NULL ) {
+        if ( !VideoOutOpen( &userData->video, options->videoPath,
+                options->videoFormat, esContext->width, esContext->height,
+                options->videoFps ) ) {
+            return FALSE;
+        }
+        // One worker keeps the frames in order.
+        if ( !FrameCaptureInit( &userData->capture, esContext->width,
+                esContext->height, bytesPerPixel, 1, FrameEncodeVideo,
+                &userData->video ) ) {
+            VideoOutClose( &userData->video );
+            return FALSE;
+        }
+    } else {
+        if ( !FrameCaptureInit( &userData->capture, esContext->width,
+                esContext->height, bytesPerPixel, options->captureWorkers,
+                options->captureEncode, (void *) options->captureDirectory ) ) {
+            return FALSE;
         }
     }
-    free(pixels);
-    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
-    return retval;
+    fprintf( stderr, "Capturing %dx%d frames (format 0x%x type 0x%x) to %s\n",
+            esContext->width, esContext->height, userData->readFormat,
+            userData->readType, options->videoPath != NULL ?
+            options->videoPath : options->captureDirectory );
+    userData->capturing = TRUE;
+    return TRUE;
+}
+
+void StopCapture( UserData *userData )
+{
+    if ( !userData->capturing ) {
+        return;
+    }
+    FrameCaptureFinish( &userData->capture );
+    if ( userData->capture.encode == FrameEncodeVideo ) {
+        VideoOutClose( &userData->video );
+    }
+    userData->capturing = FALSE;
 }
 
 ///
@@ -1274,20 +1915,47 @@ int ReadPixels( ESContext *esContext )
 //
 void Draw ( ESContext *esContext )
 {
-    //UserData *userData = esContext->userData;
+    UserData *userData = esContext->userData;
+    GLint width = esContext->width;
+    GLint height = esContext->height;
+
+    if ( userData->scaling ) {
+        width = (GLint) ( width * userData->renderScale.scale + 0.5f );
+        height = (GLint) ( height * userData->renderScale.scale + 0.5f );
+        glBindFramebuffer( GL_FRAMEBUFFER, userData->sceneTarget.framebuffer );
+    }
 
     // Set the viewport for Particles
-    glViewport ( 0, 0, esContext->width, esContext->height );
+    glViewport ( 0, 0, width, height );
 
     // Clear the color buffer
     glClearDepthf( 1.0f );
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    DrawBilliardsTable( esContext );
-    DrawParticles( esContext );
-    //int hasRedPix = ReadPixels( esContext );
-    //printf("%d\n", hasRedPix);
-    //DrawQuad( esContext );
+    RenderQueueReset( &userData->renderQueue );
+    QueueBilliardsTable( esContext );
+    QueueParticles( esContext );
+    RenderQueueRun( &userData->renderQueue );
+
+    if ( userData->scaling ) {
+        // Back to the window, or renderToTex when headless.
+        glBindFramebuffer( GL_FRAMEBUFFER, userData->captureFramebuffer );
+        glViewport ( 0, 0, esContext->width, esContext->height );
+        DrawQuad( esContext, &userData->sceneTarget, width, height );
+    }
+    if ( userData->capturing ) {
+        CaptureFrame( userData );
+    }
+    if ( userData->renderScale.automatic ) {
+        // GLES 2 has no timer queries on the Pi, so wait for the GPU and
+        // time the whole frame from the CPU.
+        glFinish();
+    }
+    FramePacerDrawn( &userData->pacer );
+    if ( userData->renderScale.automatic ) {
+        RenderScaleUpdate( &userData->renderScale,
+                FramePacerBusy( &userData->pacer ) );
+    }
 }
 
 ///
@@ -1297,19 +1965,11 @@ void FreeTable( ESContext *esContext )
 {
     UserData *userData = esContext->userData;
 
-    free(userData->table->vTable);
-    free(userData->table->vRails);
-    free(userData->table->vHoles);
-    free(userData->table->vTicks);
-    free(userData->table->vCollision);
-
-    free(userData->table->eTable);
-    free(userData->table->eRails);
-    free(userData->table->eHoles);
-    free(userData->table->eTicks);
-    free(userData->table->eCollision);
-
-    free(userData->table->nCollision);
+    FreeMesh( &userData->table->table );
+    FreeMesh( &userData->table->rails );
+    FreeMesh( &userData->table->holes );
+    FreeMesh( &userData->table->ticks );
+    FreeMesh( &userData->table->collision );
 }
 
 void ShutDown ( ESContext *esContext )
@@ -1322,13 +1982,374 @@ void ShutDown ( ESContext *esContext )
 
     // Delete program object
     glDeleteProgram ( userData->particlesProgram );
+    StopCapture ( userData );
+    if ( userData->playbackEnabled ) {
+        glDeleteBuffers ( 1, &userData->playbackBuffer );
+        TrajectoryFree ( &userData->trajectory );
+        free ( userData->playbackKeyframes );
+        free ( userData->playbackKeyframeTimes );
+    }
+    FreeRenderTarget ( &userData->renderToTex );
+    if ( userData->scaling ) {
+        if ( userData->renderScale.automatic ) {
+            fprintf( stderr, "Render scale %.2f, changed %u times\n",
+                    userData->renderScale.scale,
+                    userData->renderScale.changes );
+        }
+        glDeleteProgram ( userData->quadProgram );
+        FreeRenderTarget ( &userData->sceneTarget );
+    }
+    if ( userData->pacer.frames > 0 ) {
+        FramePacerReport( &userData->pacer, stderr );
+    }
+    SimThreadStop( &userData->sim );
+    WallStop( &userData->wall );
+    // The recorder steps the same table, so it stops before that's freed.
+    if ( userData->recorder != NULL ) {
+        ReplayRecorderStop( userData->recorder );
+        free( userData->recorder );
+        userData->recorder = NULL;
+    }
+    ArenaFree( &userData->wallArena );
+    const struct StepStats *stats = &userData->sim.stats;
+    if ( stats->steps > 0 ) {
+        fprintf( stderr, "Physics: %u steps in %u substeps, %u hit the cap "
+                "of %d\n", stats->steps, stats->substeps, stats->capped,
+                SUBSTEP_MAX );
+    }
+    if ( userData->shared != NULL ) {
+        SharedStateDestroy( userData->shared );
+        free( userData->shared );
+        userData->shared = NULL;
+    }
     FreeTable( esContext );
+    ArenaFree( &userData->arena );
+    InputStop( &userData->input );
+    if ( userData->control != NULL ) {
+        ControlServerStop( userData->control );
+        free( userData->control );
+        userData->control = NULL;
+    }
+    if ( userData->replay != NULL ) {
+        ReplayFree( userData->replay );
+        free( userData->replay );
+        userData->replay = NULL;
+    }
+}
+
+///
+// Render without a window.  Frames go into the offscreen target, which stays
+// bound the whole time.
+//
+void HeadlessMainLoop ( ESContext *esContext, const struct Options *options )
+{
+    double lastTime = SimThreadNow();
+    GLuint frameNumber;
+    for ( frameNumber = 0 ; options->frames == 0 ||
+            frameNumber < options->frames ; ++frameNumber ) {
+        double now = SimThreadNow();
+        Update( esContext, (float) (now - lastTime) );
+        lastTime = now;
+        Draw( esContext );
+        glFinish();
+    }
+}
+
+void Usage ( const char *name )
+{
+    fprintf( stderr, "Usage: %s [--size WxH] [--headless [--frames N]] "
+            "[--capture DIR] [--capture-format png|raw] "
+            "[--capture-workers N] [--video-out PATH|-] "
+            "[--video-format y4m|rgb] [--video-fps N] [--gpu-playback] "
+            "[--fps N] [--swap-interval N] [--frame-stats SECONDS] "
+            "[--render-scale SCALE|auto] "
+            "[--assets DIR] [--table FILE] "
+            "[--input FILE|FIFO|/dev/input/eventN] "
+            "[--control SOCKET] [--shared-state NAME] [--record FILE] "
+            "[--replay FILE [--replay-shot N | --replay-time SECONDS]] "
+            "[--wall N [--wall-live NAME]... [--wall-replay FILE]...]\n"
+            "       %s --script FILE [--accuracy] [--results FILE] "
+            "[--table FILE]\n",
+            name, name );
+}
+
+int ParseArguments ( int argc, char *argv[], struct Options *options )
+{
+    int i;
+    options->headless = FALSE;
+    options->width = DEFAULT_WIDTH;
+    options->height = DEFAULT_HEIGHT;
+    options->frames = 0;
+    options->captureDirectory = NULL;
+    options->captureEncode = FrameEncodePng;
+    options->captureWorkers = CAPTURE_DEFAULT_WORKERS;
+    options->videoPath = NULL;
+    options->videoFormat = VIDEO_Y4M;
+    options->videoFps = VIDEO_DEFAULT_FPS;
+    options->gpuPlayback = FALSE;
+    options->fps = 0;
+    options->swapInterval = -1;
+    options->frameStatsInterval = 0.0;
+    options->renderScale = 1.0f;
+    options->inputPath = NULL;
+    options->scriptPath = NULL;
+    options->resultsPath = NULL;
+    options->accuracy = FALSE;
+    options->controlPath = NULL;
+    options->sharedStateName = NULL;
+    options->recordPath = NULL;
+    options->replayPath = NULL;
+    options->tablePath = TABLE_SPEC_DEFAULT;
+    options->wall = 1;
+    options->wallReplayCount = 0;
+    options->wallLiveCount = 0;
+    options->replayShot = 0;
+    options->replayTime = -1.0;
+    // Development override for the embedded shaders, models and textures.
+    AssetSetDirectory( getenv( "BILLIARDS_ASSETS" ) );
+
+    for ( i = 1 ; i < argc ; ++i ) {
+        const char *arg = argv[i];
+        const char *value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if ( strcmp( arg, "--headless" ) == 0 ) {
+            options->headless = TRUE;
+            continue;
+        }
+        if ( strcmp( arg, "--gpu-playback" ) == 0 ) {
+            options->gpuPlayback = TRUE;
+            continue;
+        }
+        if ( strcmp( arg, "--accuracy" ) == 0 ) {
+            options->accuracy = TRUE;
+            continue;
+        }
+        if ( value == NULL ) {
+            Usage( argv[0] );
+            return FALSE;
+        }
+        ++i;
+        if ( strcmp( arg, "--size" ) == 0 ) {
+            if ( sscanf( value, "%dx%d", &options->width, &options->height ) != 2
+                    || options->width <= 0 || options->height <= 0 ) {
+                fprintf( stderr, "Bad size %s\n", value );
+                return FALSE;
+            }
+        } else if ( strcmp( arg, "--frames" ) == 0 ) {
+            options->frames = (GLuint) strtoul( value, NULL, 10 );
+        } else if ( strcmp( arg, "--capture" ) == 0 ) {
+            options->captureDirectory = value;
+        } else if ( strcmp( arg, "--capture-format" ) == 0 ) {
+            if ( strcmp( value, "png" ) == 0 ) {
+                options->captureEncode = FrameEncodePng;
+            } else if ( strcmp( value, "raw" ) == 0 ) {
+                options->captureEncode = FrameEncodeRaw;
+            } else {
+                fprintf( stderr, "Unknown capture format %s\n", value );
+                return FALSE;
+            }
+        } else if ( strcmp( arg, "--capture-workers" ) == 0 ) {
+            options->captureWorkers = (GLuint) strtoul( value, NULL, 10 );
+        } else if ( strcmp( arg, "--video-out" ) == 0 ) {
+            options->videoPath = value;
+        } else if ( strcmp( arg, "--video-format" ) == 0 ) {
+            if ( strcmp( value, "y4m" ) == 0 ) {
+                options->videoFormat = VIDEO_Y4M;
+            } else if ( strcmp( value, "rgb" ) == 0 ) {
+                options->videoFormat = VIDEO_RGB;
+            } else {
+                fprintf( stderr, "Unknown video format %s\n", value );
+                return FALSE;
+            }
+        } else if ( strcmp( arg, "--video-fps" ) == 0 ) {
+            long videoFps = strtol( value, NULL, 10 );
+            if ( videoFps < 1 ) {
+                fprintf( stderr, "Bad video fps %s\n", value );
+                return FALSE;
+            }
+            options->videoFps = (GLuint) videoFps;
+        } else if ( strcmp( arg, "--fps" ) == 0 ) {
+            options->fps = (GLuint) strtoul( value, NULL, 10 );
+        } else if ( strcmp( arg, "--swap-interval" ) == 0 ) {
+            options->swapInterval = (GLint) strtol( value, NULL, 10 );
+        } else if ( strcmp( arg, "--frame-stats" ) == 0 ) {
+            options->frameStatsInterval = strtod( value, NULL );
+            if ( options->frameStatsInterval < 0.0 ) {
+                fprintf( stderr, "Bad frame stats interval %s\n", value );
+                return FALSE;
+            }
+        } else if ( strcmp( arg, "--render-scale" ) == 0 ) {
+            options->renderScale = strcmp( value, "auto" ) == 0 ? 0.0f :
+                strtof( value, NULL );
+            if ( options->renderScale != 0.0f &&
+                    ( options->renderScale < 0.1f ||
+                      options->renderScale > 1.0f ) ) {
+                fprintf( stderr, "Bad render scale %s\n", value );
+                return FALSE;
+            }
+        } else if ( strcmp( arg, "--assets" ) == 0 ) {
+            AssetSetDirectory( value );
+        } else if ( strcmp( arg, "--table" ) == 0 ) {
+            options->tablePath = value;
+        } else if ( strcmp( arg, "--input" ) == 0 ) {
+            options->inputPath = value;
+        } else if ( strcmp( arg, "--script" ) == 0 ) {
+            options->scriptPath = value;
+        } else if ( strcmp( arg, "--results" ) == 0 ) {
+            options->resultsPath = value;
+        } else if ( strcmp( arg, "--control" ) == 0 ) {
+            options->controlPath = value;
+        } else if ( strcmp( arg, "--shared-state" ) == 0 ) {
+            options->sharedStateName = value;
+        } else if ( strcmp( arg, "--record" ) == 0 ) {
+            options->recordPath = value;
+        } else if ( strcmp( arg, "--replay" ) == 0 ) {
+            options->replayPath = value;
+        } else if ( strcmp( arg, "--replay-shot" ) == 0 ) {
+            options->replayShot = (GLuint) strtoul( value, NULL, 10 );
+        } else if ( strcmp( arg, "--wall" ) == 0 ) {
+            options->wall = (GLuint) strtoul( value, NULL, 10 );
+            if ( options->wall < 1 || options->wall > WALL_MAX_TABLES ) {
+                fprintf( stderr, "Bad wall %s, 1 to %d tables\n", value,
+                        WALL_MAX_TABLES );
+                return FALSE;
+            }
+        } else if ( strcmp( arg, "--wall-replay" ) == 0 ) {
+            if ( options->wallReplayCount == WALL_MAX_TABLES - 1 ) {
+                fprintf( stderr, "More than %d wall replays\n",
+                        WALL_MAX_TABLES - 1 );
+                return FALSE;
+            }
+            options->wallReplays[ options->wallReplayCount++ ] = value;
+        } else if ( strcmp( arg, "--wall-live" ) == 0 ) {
+            if ( options->wallLiveCount == WALL_MAX_TABLES - 1 ) {
+                fprintf( stderr, "More than %d wall live tables\n",
+                        WALL_MAX_TABLES - 1 );
+                return FALSE;
+            }
+            options->wallLive[ options->wallLiveCount++ ] = value;
+        } else if ( strcmp( arg, "--replay-time" ) == 0 ) {
+            options->replayTime = strtod( value, NULL );
+            if ( options->replayTime < 0.0 ) {
+                fprintf( stderr, "Bad replay time %s\n", value );
+                return FALSE;
+            }
+        } else {
+            Usage( argv[0] );
+            return FALSE;
+        }
+    }
+    if ( options->captureDirectory != NULL && options->videoPath != NULL ) {
+        fprintf( stderr, "--capture and --video-out can't be used together\n" );
+        return FALSE;
+    }
+    if ( options->recordPath != NULL && options->replayPath != NULL ) {
+        fprintf( stderr, "--record and --replay can't be used together\n" );
+        return FALSE;
+    }
+    if ( options->wall > 1 && options->gpuPlayback ) {
+        fprintf( stderr, "--wall and --gpu-playback can't be used together\n" );
+        return FALSE;
+    }
+    if ( options->wallReplayCount > 0 && options->wall == 1 ) {
+        fprintf( stderr, "--wall-replay needs --wall\n" );
+        return FALSE;
+    }
+    if ( options->wallLiveCount >= options->wall ) {
+        fprintf( stderr, "--wall %u has room for %u --wall-live tables\n",
+                options->wall, options->wall - 1 );
+        return FALSE;
+    }
+    if ( options->accuracy && options->scriptPath == NULL ) {
+        fprintf( stderr, "--accuracy needs --script\n" );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+///
+// --script: no context, no window, just the collision mesh and the physics.
+//
+int RunScriptOnly ( const struct Options *options )
+{
+    struct TableSpec spec;
+    struct Table table;
+    struct Arena arena;
+    FILE *out = stdout;
+
+    memset( &table, 0, sizeof(table) );
+    memset( &arena, 0, sizeof(arena) );
+    if ( !LoadTableSpec( &spec, options->tablePath ) ||
+            !LoadMesh( &table.collision, spec.models[TABLE_MODEL_COLLISION],
+                TRUE ) ) {
+        return 1;
+    }
+    if ( !ArenaInit( &arena, TableSpecArenaSize( &spec, &table ) ) ||
+            !TableSpecApply( &spec, &table, &arena ) ) {
+        FreeMesh( &table.collision );
+        return 1;
+    }
+    if ( options->resultsPath != NULL &&
+            ( out = fopen( options->resultsPath, "w" ) ) == NULL ) {
+        fprintf( stderr, "Can't write %s\n", options->resultsPath );
+        ArenaFree( &arena );
+        FreeMesh( &table.collision );
+        return 1;
+    }
+    long cores = sysconf( _SC_NPROCESSORS_ONLN );
+    int status = options->accuracy ?
+        RunAccuracy( options->scriptPath, &table, &spec, out ) :
+        RunScript( options->scriptPath, &table, &spec, out,
+                cores > 0 ? (GLuint) cores : 1 );
+    if ( out != stdout && fclose( out ) != 0 ) {
+        fprintf( stderr, "Can't write %s\n", options->resultsPath );
+        status = 1;
+    }
+    ArenaFree( &arena );
+    FreeMesh( &table.collision );
+    return status;
 }
 
 int main ( int argc, char *argv[] )
 {
     ESContext esContext;
     UserData  userData;
+    struct Options options;
+
+    TimelineMark( "main" );
+    if ( !ParseArguments( argc, argv, &options ) ) {
+        return 1;
+    }
+    if ( options.scriptPath != NULL ) {
+        return RunScriptOnly( &options );
+    }
+    memset( &userData, 0, sizeof(userData) );
+    userData.rackSeed = (unsigned int) time( NULL );
+    if ( options.replayPath != NULL ) {
+        userData.replay = malloc( sizeof(struct Replay) );
+        if ( userData.replay == NULL ||
+                !ReplayLoad( userData.replay, options.replayPath ) ) {
+            return 1;
+        }
+        userData.rackSeed = userData.replay->header.rackSeed;
+        // Replays are played on the table they were recorded on.
+        options.tablePath = userData.replay->header.table;
+    }
+    if ( !LoadTableSpec( &userData.spec, options.tablePath ) ) {
+        return 1;
+    }
+    WallLayout( &userData.wall, options.wall );
+    if ( !WallLoadReplays( &userData.wall, options.wallReplays,
+                options.wallReplayCount, &userData.spec ) ||
+            !WallOpenLive( &userData.wall, options.wallLive,
+                options.wallLiveCount, &userData.spec ) ) {
+        return 1;
+    }
+    if ( options.recordPath != NULL ) {
+        userData.recorder = malloc( sizeof(struct ReplayRecorder) );
+        if ( userData.recorder == NULL ) {
+            return 1;
+        }
+    }
 
     // Setup the Quad struct
     struct Quad quad;
@@ -1379,17 +2400,117 @@ int main ( int argc, char *argv[] )
     */
     userData.table = &table;
 
-    // Setup renderToTexTexWidth/Height
-    userData.renderToTexTexWidth = RENDER_TO_TEX_WIDTH;
-    userData.renderToTexTexHeight = RENDER_TO_TEX_HEIGHT;
+    // Everything that doesn't need GL is read and parsed while EGL and the
+    // window come up.  The context thread keeps one core to itself.
+    struct AssetLoader loader;
+    memset( &loader, 0, sizeof(loader) );
+    AssetLoaderAddShader( &loader, "shader/billiards.vert" );
+    AssetLoaderAddShader( &loader, "shader/billiards.frag" );
+    if ( !LoadAtlas( &userData.ballAtlas, BALL_ATLAS ) ) {
+        return 1;
+    }
+    GLuint level;
+    for ( level = 0 ; level < userData.ballAtlas.levelCount ; ++level ) {
+        AssetLoaderAddPng( &loader, userData.ballAtlas.levels[level] );
+    }
+    AssetLoaderAddShader( &loader, "shader/table.vert" );
+    AssetLoaderAddShader( &loader, "shader/table.frag" );
+    memset( &table, 0, sizeof(table) );
+    struct Mesh *meshes[ TABLE_MODEL_COUNT ] = { &table.table, &table.rails,
+        &table.holes, &table.ticks, &table.collision };
+    GLint model;
+    for ( model = 0 ; model < TABLE_MODEL_COUNT ; ++model ) {
+        if ( strcmp( userData.spec.models[model], "-" ) != 0 ) {
+            AssetLoaderAddMesh( &loader, userData.spec.models[model],
+                    meshes[model], model == TABLE_MODEL_COLLISION );
+        }
+    }
+    long cores = sysconf( _SC_NPROCESSORS_ONLN );
+    AssetLoaderStart( &loader, cores > 1 ? cores - 1 : 1 );
+    userData.loader = &loader;
+    TimelineMark( "asset loader started" );
 
     esInitContext ( &esContext );
     esContext.userData = &userData;
+    userData.playbackEnabled = options.gpuPlayback;
+
+    if ( options.headless ) {
+        if ( !HeadlessCreateContext( &esContext, options.width,
+                options.height ) ) {
+            return 1;
+        }
+        if ( !InitRenderTarget( &userData.renderToTex, options.width,
+                options.height ) ) {
+            return 1;
+        }
+        glBindFramebuffer( GL_FRAMEBUFFER, userData.renderToTex.framebuffer );
+    } else {
+        if ( !esCreateWindow ( &esContext, "ParticleSystem", options.width,
+                options.height, ES_WINDOW_RGB | ES_WINDOW_DEPTH |
+                ES_WINDOW_ALPHA ) ) {
+            return 1;
+        }
+    }
+
+    // Vsync on the Pi and most desktops; 0 lets --fps do the pacing.
+    if ( options.swapInterval >= 0 &&
+            !eglSwapInterval( esContext.eglDisplay, options.swapInterval ) ) {
+        fprintf( stderr, "Swap interval %d not supported\n",
+                options.swapInterval );
+    }
+    TimelineMark( "context created" );
+    ProgramCacheInit( &userData.programCache );
 
-    esCreateWindow ( &esContext, "ParticleSystem", 1920, 1080, ES_WINDOW_RGB | ES_WINDOW_DEPTH | ES_WINDOW_ALPHA );
+    // Headless draws into renderToTex, a window into its back buffer.
+    userData.captureFramebuffer = userData.renderToTex.framebuffer;
+    if ( !StartCapture( &esContext, &options ) ) {
+        return 1;
+    }
 
-    if ( !Init ( &esContext ) )
+    if ( !InputStart( &userData.input, options.inputPath ) ) {
+        return 1;
+    }
+    if ( options.controlPath != NULL ) {
+        userData.control = malloc( sizeof(struct ControlServer) );
+        if ( userData.control == NULL ||
+                !ControlServerStart( userData.control, options.controlPath ) ) {
+            return 1;
+        }
+    }
+    if ( options.sharedStateName != NULL ) {
+        userData.shared = malloc( sizeof(struct SharedStatePublisher) );
+        if ( userData.shared == NULL ||
+                !SharedStateCreate( userData.shared, options.sharedStateName,
+                    userData.spec.name, SIM_RATE ) ) {
+            return 1;
+        }
+    }
+    // The workers are joined whether or not Init got everything it needed.
+    int initialized = Init ( &esContext, &options );
+    AssetLoaderFinish( &loader );
+    userData.loader = NULL;
+    if ( !initialized ) {
+        return 1;
+    }
+    if ( options.renderScale != 1.0f ) {
+        if ( !InitQuad( &esContext ) ||
+                !InitRenderTarget( &userData.sceneTarget, esContext.width,
+                    esContext.height ) ) {
+            return 1;
+        }
+        RenderScaleInit( &userData.renderScale, options.renderScale,
+                options.fps > 0 ? 1.0 / options.fps : RENDER_SCALE_BUDGET );
+        userData.scaling = TRUE;
+    }
+    FramePacerInit( &userData.pacer, options.fps, options.swapInterval,
+            options.frameStatsInterval );
+
+    if ( options.headless ) {
+        HeadlessMainLoop( &esContext, &options );
+        ShutDown( &esContext );
+        HeadlessDestroyContext( &esContext );
         return 0;
+    }
 
     esRegisterDrawFunc ( &esContext, Draw );
     esRegisterUpdateFunc ( &esContext, Update );
@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "controlServer.h"
+
+static int SetNonBlocking( int fd )
+{
+    int flags = fcntl( fd, F_GETFL );
+    return flags != -1 && fcntl( fd, F_SETFL, flags | O_NONBLOCK ) == 0;
+}
+
+static void CloseClient( struct ControlClient *client )
+{
+    close( client->fd );
+    client->fd = -1;
+}
+
+// Write whatever the socket will take right now.
+static void Flush( struct ControlClient *client )
+{
+    while ( client->outStart < client->outEnd ) {
+        ssize_t sent = send( client->fd, client->out + client->outStart,
+                client->outEnd - client->outStart, MSG_NOSIGNAL );
+        if ( sent < 0 ) {
+            if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR ) {
+                CloseClient( client );
+            }
+            return;
+        }
+        client->outStart += sent;
+    }
+    client->outStart = client->outEnd = 0;
+}
+
+static int Append( struct ControlClient *client, uint16_t type,
+        const void *payload, uint16_t size )
+{
+    struct ControlHeader header;
+    size_t total = sizeof(header) + size;
+    if ( CONTROL_CLIENT_QUEUE - client->outEnd < total &&
+            client->outStart > 0 ) {
+        memmove( client->out, client->out + client->outStart,
+                client->outEnd - client->outStart );
+        client->outEnd -= client->outStart;
+        client->outStart = 0;
+    }
+    if ( CONTROL_CLIENT_QUEUE - client->outEnd < total ) {
+        return 0;
+    }
+    header.type = type;
+    header.size = size;
+    memcpy( client->out + client->outEnd, &header, sizeof(header) );
+    memcpy( client->out + client->outEnd + sizeof(header), payload, size );
+    client->outEnd += total;
+    return 1;
+}
+
+///
+// Queue a message, or count it as dropped if the client's queue is full.
+// The count goes out ahead of the next message that fits.
+//
+static void Send( struct ControlClient *client, uint16_t type,
+        const void *payload, uint16_t size )
+{
+    if ( client->dropped > 0 ) {
+        if ( !Append( client, CONTROL_DROPPED, &client->dropped,
+                sizeof(client->dropped) ) ) {
+            ++client->dropped;
+            return;
+        }
+        client->dropped = 0;
+    }
+    if ( !Append( client, type, payload, size ) ) {
+        ++client->dropped;
+    }
+}
+
+static void SendState( struct ControlServer *server,
+        struct ControlClient *client )
+{
+    struct ControlState state;
+    GLint slot;
+    state.tick = server->state.tick;
+    state.moving = server->state.moving;
+    for ( slot = 0 ; slot < NUM_PARTICLES ; ++slot ) {
+        memcpy( state.balls[ server->ballNumbers[slot] ],
+                &server->state.particleData[slot * PARTICLE_SIZE],
+                sizeof(state.balls[0]) );
+    }
+    Send( client, CONTROL_STATE, &state, sizeof(state) );
+}
+
+static void SendEvents( struct ControlServer *server,
+        struct ControlClient *client )
+{
+    const struct ContactList *contacts = &server->state.contacts;
+    GLuint count = contacts->count < CONTACT_LIST_SIZE ? contacts->count :
+        CONTACT_LIST_SIZE;
+    GLuint i;
+    for ( i = 0 ; i < count ; ++i ) {
+        const struct Contact *contact = &contacts->contacts[i];
+        struct ControlEvent event;
+        event.tick = server->state.tick;
+        event.type = contact->type;
+        event.a = server->ballNumbers[ contact->a ];
+        event.b = contact->b < 0 ? -1 : server->ballNumbers[ contact->b ];
+        event.padding = 0;
+        Send( client, CONTROL_EVENT, &event, sizeof(event) );
+    }
+}
+
+static void DrainTicks( struct ControlServer *server )
+{
+    GLuint i;
+    while ( RingPop( &server->ticks, &server->state ) ) {
+        server->hasState = 1;
+        for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+            struct ControlClient *client = &server->clients[i];
+            if ( client->fd < 0 ) {
+                continue;
+            }
+            if ( client->subscriptions & CONTROL_SUBSCRIBE_TICKS ||
+                    client->wantsSnapshot ) {
+                SendState( server, client );
+                client->wantsSnapshot = 0;
+            }
+            if ( client->subscriptions & CONTROL_SUBSCRIBE_EVENTS ) {
+                SendEvents( server, client );
+            }
+        }
+    }
+}
+
+static void PushCommand( struct ControlServer *server, GLint type,
+        const struct ControlVector *vector )
+{
+    struct InputCommand command;
+    command.type = type;
+    command.value[0] = vector->x;
+    command.value[1] = vector->y;
+    if ( !RingPush( &server->commands, &command ) ) {
+        fprintf( stderr, "%s: Command queue full\n", __FILE__ );
+    }
+}
+
+static void HandleMessage( struct ControlServer *server,
+        struct ControlClient *client, const struct ControlHeader *header,
+        const unsigned char *payload )
+{
+    struct ControlVector vector;
+    uint32_t flags;
+    switch ( header->type ) {
+        case CONTROL_PLACE:
+        case CONTROL_SHOOT:
+            if ( header->size != sizeof(vector) ) {
+                break;
+            }
+            memcpy( &vector, payload, sizeof(vector) );
+            PushCommand( server, header->type == CONTROL_PLACE ? INPUT_PLACE :
+                    INPUT_SHOOT, &vector );
+            break;
+        case CONTROL_SNAPSHOT:
+            if ( server->hasState ) {
+                SendState( server, client );
+            } else {
+                client->wantsSnapshot = 1;
+            }
+            break;
+        case CONTROL_SUBSCRIBE:
+            if ( header->size == sizeof(flags) ) {
+                memcpy( &flags, payload, sizeof(flags) );
+                client->subscriptions = flags;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void ReadClient( struct ControlServer *server,
+        struct ControlClient *client )
+{
+    ssize_t size = recv( client->fd, client->in + client->inSize,
+            sizeof(client->in) - client->inSize, 0 );
+    if ( size <= 0 ) {
+        if ( size == 0 || ( errno != EAGAIN && errno != EINTR ) ) {
+            CloseClient( client );
+        }
+        return;
+    }
+    client->inSize += size;
+
+    size_t offset = 0;
+    while ( client->inSize - offset >= sizeof(struct ControlHeader) ) {
+        struct ControlHeader header;
+        memcpy( &header, client->in + offset, sizeof(header) );
+        if ( header.size > sizeof(client->in) - sizeof(header) ) {
+            fprintf( stderr, "%s: Dropping client, %u byte message\n",
+                    __FILE__, header.size );
+            CloseClient( client );
+            return;
+        }
+        if ( client->inSize - offset < sizeof(header) + header.size ) {
+            break;
+        }
+        HandleMessage( server, client, &header,
+                client->in + offset + sizeof(header) );
+        offset += sizeof(header) + header.size;
+    }
+    memmove( client->in, client->in + offset, client->inSize - offset );
+    client->inSize -= offset;
+}
+
+static void Accept( struct ControlServer *server )
+{
+    int fd = accept( server->listenFd, NULL, NULL );
+    if ( fd < 0 ) {
+        return;
+    }
+    GLuint i;
+    for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+        struct ControlClient *client = &server->clients[i];
+        if ( client->fd < 0 ) {
+            uint32_t version = CONTROL_PROTOCOL_VERSION;
+            memset( client, 0, sizeof(*client) );
+            client->fd = fd;
+            if ( !SetNonBlocking( fd ) ) {
+                CloseClient( client );
+                return;
+            }
+            Send( client, CONTROL_HELLO, &version, sizeof(version) );
+            return;
+        }
+    }
+    fprintf( stderr, "%s: Too many clients\n", __FILE__ );
+    close( fd );
+}
+
+static void * ControlServerMain( void *arg )
+{
+    struct ControlServer *server = arg;
+    struct pollfd fds[ CONTROL_MAX_CLIENTS + 2 ];
+    GLint owner[ CONTROL_MAX_CLIENTS + 2 ];
+    GLuint i;
+
+    for ( ;; ) {
+        nfds_t count = 0;
+        fds[count].fd = server->wake[0];
+        fds[count].events = POLLIN;
+        owner[count++] = -1;
+        fds[count].fd = server->listenFd;
+        fds[count].events = POLLIN;
+        owner[count++] = -1;
+        for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+            struct ControlClient *client = &server->clients[i];
+            if ( client->fd >= 0 ) {
+                fds[count].fd = client->fd;
+                fds[count].events = POLLIN |
+                    ( client->outEnd > client->outStart ? POLLOUT : 0 );
+                owner[count++] = i;
+            }
+        }
+        // Wake about once a tick to pass on what the sim has done.
+        if ( poll( fds, count, CONTROL_POLL_MS ) < 0 && errno != EINTR ) {
+            fprintf( stderr, "%s: poll failed\n", __FILE__ );
+            return NULL;
+        }
+        if ( fds[0].revents != 0 ) {
+            return NULL;
+        }
+        if ( fds[1].revents & POLLIN ) {
+            Accept( server );
+        }
+        for ( i = 2 ; i < count ; ++i ) {
+            struct ControlClient *client = &server->clients[ owner[i] ];
+            if ( client->fd >= 0 && fds[i].revents & ( POLLIN | POLLHUP |
+                    POLLERR ) ) {
+                ReadClient( server, client );
+            }
+        }
+        DrainTicks( server );
+        for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+            if ( server->clients[i].fd >= 0 ) {
+                Flush( &server->clients[i] );
+            }
+        }
+    }
+}
+
+///
+// Listen on path, replacing a stale socket left by an earlier run.
+//
+int ControlServerStart( struct ControlServer *server, const char *path )
+{
+    struct sockaddr_un address;
+    GLuint i;
+
+    memset( server, 0, sizeof(*server) );
+    for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+        server->clients[i].fd = -1;
+    }
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        server->ballNumbers[i] = i;
+    }
+    if ( strlen( path ) >= sizeof(address.sun_path) ) {
+        fprintf( stderr, "%s: Socket path too long: %s\n", __FILE__, path );
+        return 0;
+    }
+    strcpy( server->path, path );
+
+    memset( &address, 0, sizeof(address) );
+    address.sun_family = AF_UNIX;
+    strcpy( address.sun_path, path );
+    server->listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if ( server->listenFd < 0 ) {
+        fprintf( stderr, "%s: socket failed\n", __FILE__ );
+        return 0;
+    }
+    unlink( path );
+    if ( bind( server->listenFd, (struct sockaddr *) &address,
+                sizeof(address) ) != 0 ||
+            listen( server->listenFd, CONTROL_MAX_CLIENTS ) != 0 ||
+            !SetNonBlocking( server->listenFd ) ) {
+        fprintf( stderr, "%s: Can't listen on %s: %s\n", __FILE__, path,
+                strerror( errno ) );
+        close( server->listenFd );
+        return 0;
+    }
+
+    if ( !RingInit( &server->ticks, sizeof(struct SimTick),
+                CONTROL_TICK_QUEUE ) ||
+            !RingInit( &server->commands, sizeof(struct InputCommand),
+                CONTROL_COMMAND_QUEUE ) ||
+            pipe( server->wake ) != 0 ) {
+        RingFree( &server->ticks );
+        RingFree( &server->commands );
+        close( server->listenFd );
+        unlink( path );
+        return 0;
+    }
+    if ( pthread_create( &server->thread, NULL, ControlServerMain,
+            server ) != 0 ) {
+        fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+        close( server->wake[0] );
+        close( server->wake[1] );
+        RingFree( &server->ticks );
+        RingFree( &server->commands );
+        close( server->listenFd );
+        unlink( path );
+        return 0;
+    }
+    server->started = 1;
+    return 1;
+}
+
+void ControlServerStop( struct ControlServer *server )
+{
+    GLuint i;
+    if ( !server->started ) {
+        return;
+    }
+    if ( write( server->wake[1], "", 1 ) != 1 ) {
+        fprintf( stderr, "%s: Can't wake the control thread\n", __FILE__ );
+    }
+    pthread_join( server->thread, NULL );
+    for ( i = 0 ; i < CONTROL_MAX_CLIENTS ; ++i ) {
+        if ( server->clients[i].fd >= 0 ) {
+            CloseClient( &server->clients[i] );
+        }
+    }
+    close( server->wake[0] );
+    close( server->wake[1] );
+    close( server->listenFd );
+    unlink( server->path );
+    RingFree( &server->ticks );
+    RingFree( &server->commands );
+    server->started = 0;
+}
+
+int ControlServerPoll( struct ControlServer *server,
+        struct InputCommand *command )
+{
+    return server != NULL && server->started &&
+        RingPop( &server->commands, command );
+}
@@ -0,0 +1,78 @@
+// Build tool: writes a C file holding the given files as embeddedAssets.
+//
+//     embedAssets assetData.c shader/billiards.vert model/table.obj ...
+//
+// Names are stored exactly as passed, so run it from the directory the game
+// would otherwise load them relative to.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int CompareNames( const void *a, const void *b )
+{
+    return strcmp( *(char * const *)a, *(char * const *)b );
+}
+
+static long WriteAsset( FILE *outputFile, const char *name, int index )
+{
+    FILE *inputFile = fopen( name, "rb" );
+    if ( inputFile == NULL ) {
+        fprintf( stderr, "%s: Error Loading %s\n", __FILE__, name );
+        return -1;
+    }
+    // Aligned so binary assets can be read in place.
+    fprintf( outputFile, "static const unsigned char asset%d[] "
+            "__attribute__((aligned(16))) = {", index );
+    long size = 0;
+    int c;
+    while ( ( c = fgetc( inputFile ) ) != EOF ) {
+        fprintf( outputFile, "%s0x%02x,", size % 16 ? "" : "\n    ", c );
+        ++size;
+    }
+    fclose( inputFile );
+    fprintf( outputFile, "\n    0x00\n};\n\n" );
+    return size;
+}
+
+int main( int argc, char **argv )
+{
+    if ( argc < 2 ) {
+        fprintf( stderr, "usage: %s output.c asset...\n", argv[0] );
+        return 1;
+    }
+    int count = argc - 2;
+    char **names = &argv[2];
+    qsort( names, count, sizeof(char *), CompareNames );
+
+    FILE *outputFile = fopen( argv[1], "w" );
+    if ( outputFile == NULL ) {
+        fprintf( stderr, "%s: Error opening %s\n", __FILE__, argv[1] );
+        return 1;
+    }
+    fprintf( outputFile, "// Generated by embedAssets, do not edit.\n"
+            "#include \"assets.h\"\n\n" );
+    long *sizes = malloc( sizeof(long) * ( count + 1 ) );
+    int i;
+    for ( i = 0 ; i < count ; ++i ) {
+        sizes[i] = WriteAsset( outputFile, names[i], i );
+        if ( sizes[i] < 0 ) {
+            fclose( outputFile );
+            remove( argv[1] );
+            return 1;
+        }
+    }
+    fprintf( outputFile, "const struct Asset embeddedAssets[] = {\n" );
+    for ( i = 0 ; i < count ; ++i ) {
+        fprintf( outputFile, "    { \"%s\", asset%d, %ld },\n", names[i], i,
+                sizes[i] );
+    }
+    // Keep the array non-empty for compilers that reject zero length ones.
+    fprintf( outputFile, "    { 0, 0, 0 }\n};\n\n"
+            "const unsigned int embeddedAssetCount = %d;\n", count );
+    free( sizes );
+    if ( fclose( outputFile ) != 0 ) {
+        remove( argv[1] );
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+#include "frameCapture.h"
+
+static void * FrameCaptureWorker( void *arg )
+{
+    struct FrameCapture *capture = arg;
+    for ( ;; ) {
+        pthread_mutex_lock( &capture->lock );
+        while ( capture->queueHead == NULL && !capture->stopping ) {
+            pthread_cond_wait( &capture->frameQueued, &capture->lock );
+        }
+        struct Frame *frame = capture->queueHead;
+        if ( frame == NULL ) {
+            // Stopping and nothing left to encode.
+            pthread_mutex_unlock( &capture->lock );
+            return NULL;
+        }
+        capture->queueHead = frame->next;
+        if ( capture->queueHead == NULL ) {
+            capture->queueTail = NULL;
+        }
+        pthread_mutex_unlock( &capture->lock );
+
+        capture->encode( capture, frame );
+
+        pthread_mutex_lock( &capture->lock );
+        frame->next = capture->freeList;
+        capture->freeList = frame;
+        pthread_cond_signal( &capture->frameFree );
+        pthread_mutex_unlock( &capture->lock );
+    }
+}
+
+int FrameCaptureInit( struct FrameCapture *capture, GLint width, GLint height,
+        GLuint bytesPerPixel, GLuint workerCount, FrameEncodeFunc encode,
+        void *encodeData )
+{
+    size_t frameSize = (size_t) width * height * bytesPerPixel;
+    GLuint i;
+
+    if ( workerCount < 1 ) {
+        workerCount = 1;
+    } else if ( workerCount > CAPTURE_MAX_WORKERS ) {
+        workerCount = CAPTURE_MAX_WORKERS;
+    }
+
+    // One allocation for the whole pool.
+    capture->pixels = malloc( frameSize * CAPTURE_FRAME_COUNT );
+    if ( capture->pixels == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        return 0;
+    }
+    capture->freeList = NULL;
+    for ( i = 0 ; i < CAPTURE_FRAME_COUNT ; ++i ) {
+        struct Frame *frame = &capture->frames[i];
+        frame->pixels = capture->pixels + i * frameSize;
+        frame->width = width;
+        frame->height = height;
+        frame->bytesPerPixel = bytesPerPixel;
+        frame->next = capture->freeList;
+        capture->freeList = frame;
+    }
+    capture->queueHead = NULL;
+    capture->queueTail = NULL;
+    capture->stopping = 0;
+    capture->encode = encode;
+    capture->encodeData = encodeData;
+    capture->framesSubmitted = 0;
+    pthread_mutex_init( &capture->lock, NULL );
+    pthread_cond_init( &capture->frameFree, NULL );
+    pthread_cond_init( &capture->frameQueued, NULL );
+
+    capture->workerCount = 0;
+    for ( i = 0 ; i < workerCount ; ++i ) {
+        if ( pthread_create( &capture->workers[i], NULL, FrameCaptureWorker,
+                capture ) != 0 ) {
+            fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+            break;
+        }
+        ++capture->workerCount;
+    }
+    if ( capture->workerCount == 0 ) {
+        free( capture->pixels );
+        return 0;
+    }
+    return 1;
+}
+
+///
+// Get an empty frame to read into, waiting for a worker if they are all busy.
+//
+struct Frame * FrameCaptureAcquire( struct FrameCapture *capture )
+{
+    pthread_mutex_lock( &capture->lock );
+    while ( capture->freeList == NULL ) {
+        pthread_cond_wait( &capture->frameFree, &capture->lock );
+    }
+    struct Frame *frame = capture->freeList;
+    capture->freeList = frame->next;
+    pthread_mutex_unlock( &capture->lock );
+    return frame;
+}
+
+void FrameCaptureSubmit( struct FrameCapture *capture, struct Frame *frame )
+{
+    frame->number = capture->framesSubmitted++;
+    frame->next = NULL;
+    pthread_mutex_lock( &capture->lock );
+    if ( capture->queueTail != NULL ) {
+        capture->queueTail->next = frame;
+    } else {
+        capture->queueHead = frame;
+    }
+    capture->queueTail = frame;
+    pthread_cond_signal( &capture->frameQueued );
+    pthread_mutex_unlock( &capture->lock );
+}
+
+///
+// Encode everything still queued, then stop the workers and free the pool.
+//
+void FrameCaptureFinish( struct FrameCapture *capture )
+{
+    GLuint i;
+    pthread_mutex_lock( &capture->lock );
+    capture->stopping = 1;
+    pthread_cond_broadcast( &capture->frameQueued );
+    pthread_mutex_unlock( &capture->lock );
+    for ( i = 0 ; i < capture->workerCount ; ++i ) {
+        pthread_join( capture->workers[i], NULL );
+    }
+    pthread_mutex_destroy( &capture->lock );
+    pthread_cond_destroy( &capture->frameFree );
+    pthread_cond_destroy( &capture->frameQueued );
+    free( capture->pixels );
+}
+
+void FrameEncodePng( struct FrameCapture *capture, struct Frame *frame )
+{
+    char fileName[1024];
+    snprintf( fileName, sizeof(fileName), "%s/frame-%06u.png",
+            (const char *) capture->encodeData, frame->number );
+
+    int colorType;
+    if ( frame->type == GL_UNSIGNED_BYTE && frame->format == GL_RGBA ) {
+        colorType = PNG_COLOR_TYPE_RGBA;
+    } else if ( frame->type == GL_UNSIGNED_BYTE && frame->format == GL_RGB ) {
+        colorType = PNG_COLOR_TYPE_RGB;
+    } else {
+        fprintf( stderr, "%s: %s can't write format 0x%x type 0x%x as png\n",
+                __FILE__, fileName, frame->format, frame->type );
+        return;
+    }
+
+    FILE *outputFile = fopen( fileName, "wb" );
+    if ( outputFile == NULL ) {
+        fprintf( stderr, "%s: Error opening %s\n", __FILE__, fileName );
+        return;
+    }
+    png_structp png_ptr = png_create_write_struct( PNG_LIBPNG_VER_STRING,
+            NULL, NULL, NULL );
+    png_infop info_ptr = png_ptr ? png_create_info_struct( png_ptr ) : NULL;
+    if ( info_ptr == NULL ) {
+        fprintf( stderr, "%s: %s png_create_info_struct\n", __FILE__,
+                fileName );
+        png_destroy_write_struct( &png_ptr, NULL );
+        fclose( outputFile );
+        return;
+    }
+    // A worker has no business exiting the game over one bad frame.
+    if ( setjmp( png_jmpbuf(png_ptr) ) ) {
+        fprintf( stderr, "%s: %s Error writing image\n", __FILE__, fileName );
+        png_destroy_write_struct( &png_ptr, &info_ptr );
+        fclose( outputFile );
+        return;
+    }
+    png_init_io( png_ptr, outputFile );
+    // Speed over size; these are intermediates for an encoder.
+    png_set_compression_level( png_ptr, 1 );
+    png_set_IHDR( png_ptr, info_ptr, frame->width, frame->height, 8,
+            colorType, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
+            PNG_FILTER_TYPE_BASE );
+    png_write_info( png_ptr, info_ptr );
+
+    // glReadPixels is bottom-up; png is top-down.
+    size_t stride = (size_t) frame->width * frame->bytesPerPixel;
+    GLint y;
+    for ( y = frame->height - 1 ; y >= 0 ; --y ) {
+        png_write_row( png_ptr, frame->pixels + y * stride );
+    }
+    png_write_end( png_ptr, NULL );
+    png_destroy_write_struct( &png_ptr, &info_ptr );
+    fclose( outputFile );
+}
+
+void FrameEncodeRaw( struct FrameCapture *capture, struct Frame *frame )
+{
+    char fileName[1024];
+    snprintf( fileName, sizeof(fileName), "%s/frame-%06u.raw",
+            (const char *) capture->encodeData, frame->number );
+
+    FILE *outputFile = fopen( fileName, "wb" );
+    if ( outputFile == NULL ) {
+        fprintf( stderr, "%s: Error opening %s\n", __FILE__, fileName );
+        return;
+    }
+    size_t stride = (size_t) frame->width * frame->bytesPerPixel;
+    GLint y;
+    for ( y = frame->height - 1 ; y >= 0 ; --y ) {
+        if ( fwrite( frame->pixels + y * stride, 1, stride, outputFile ) !=
+                stride ) {
+            fprintf( stderr, "%s: Write error %s\n", __FILE__, fileName );
+            break;
+        }
+    }
+    fclose( outputFile );
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "framePacer.h"
+
+static double Now( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static void SleepUntil( double time )
+{
+    struct timespec until;
+    until.tv_sec = (time_t) time;
+    until.tv_nsec = (long) ( ( time - until.tv_sec ) * 1e9 );
+    while ( clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &until,
+            NULL ) == EINTR ) {
+        // Interrupted by a signal, go back to sleep.  Anything else won't go
+        // away by retrying, so the frame just starts early.
+    }
+}
+
+static void ResetCounts( struct FramePacer *pacer )
+{
+    pacer->frames = 0;
+    pacer->missed = 0;
+    pacer->frameTotal = 0.0;
+    pacer->frameMin = 0.0;
+    pacer->frameMax = 0.0;
+    pacer->swapTotal = 0.0;
+    pacer->swapMax = 0.0;
+    pacer->sleepTotal = 0.0;
+    memset( pacer->histogram, 0, sizeof(pacer->histogram) );
+}
+
+void FramePacerInit( struct FramePacer *pacer, GLuint fps,
+        GLint swapInterval, double reportInterval )
+{
+    memset( pacer, 0, sizeof(*pacer) );
+    pacer->interval = fps > 0 ? 1.0 / fps : 0.0;
+    if ( fps > 0 ) {
+        pacer->target = pacer->interval;
+    } else {
+        pacer->target = ( swapInterval < 0 ? 1 : swapInterval ) /
+            (double) FRAME_REFRESH_RATE;
+    }
+    pacer->reportInterval = reportInterval;
+    pacer->lastReport = Now();
+    pacer->nextFrame = pacer->lastReport;
+    ResetCounts( pacer );
+}
+
+int FramePacerBegin( struct FramePacer *pacer )
+{
+    static const double edges[] = FRAME_HISTOGRAM_EDGES;
+    double now = Now();
+    double swap = pacer->drawn > 0.0 ? now - pacer->drawn : 0.0;
+    double slept = 0.0;
+    if ( pacer->interval > 0.0 ) {
+        if ( now < pacer->nextFrame ) {
+            SleepUntil( pacer->nextFrame );
+            slept = Now() - now;
+            now += slept;
+        }
+        // Late frames push the schedule back instead of bunching up.
+        pacer->nextFrame = ( now > pacer->nextFrame + pacer->interval ?
+                now : pacer->nextFrame ) + pacer->interval;
+    }
+
+    if ( pacer->drawn > 0.0 ) {
+        double frame = now - pacer->frameStart;
+        int bucket = 0;
+        while ( bucket < FRAME_HISTOGRAM_BUCKETS - 1 &&
+                frame * 1000.0 >= edges[bucket] ) {
+            ++bucket;
+        }
+        ++pacer->histogram[bucket];
+        if ( pacer->frames == 0 || frame < pacer->frameMin ) {
+            pacer->frameMin = frame;
+        }
+        if ( frame > pacer->frameMax ) {
+            pacer->frameMax = frame;
+        }
+        if ( pacer->target > 0.0 &&
+                frame > pacer->target * FRAME_MISSED_FACTOR ) {
+            ++pacer->missed;
+        }
+        pacer->frameTotal += frame;
+        pacer->swapTotal += swap;
+        if ( swap > pacer->swapMax ) {
+            pacer->swapMax = swap;
+        }
+        pacer->sleepTotal += slept;
+        ++pacer->frames;
+    }
+    pacer->frameStart = now;
+    return pacer->reportInterval > 0.0 &&
+        now - pacer->lastReport >= pacer->reportInterval;
+}
+
+void FramePacerDrawn( struct FramePacer *pacer )
+{
+    pacer->drawn = Now();
+}
+
+double FramePacerBusy( const struct FramePacer *pacer )
+{
+    return pacer->drawn - pacer->frameStart;
+}
+
+void FramePacerReport( struct FramePacer *pacer, FILE *out )
+{
+    static const double edges[] = FRAME_HISTOGRAM_EDGES;
+    double now = Now();
+    double elapsed = now - pacer->lastReport;
+    GLuint frames = pacer->frames > 0 ? pacer->frames : 1;
+    int i;
+
+    fprintf( out, "Frames: %u in %.2f s (%.1f fps)", pacer->frames, elapsed,
+            elapsed > 0.0 ? pacer->frames / elapsed : 0.0 );
+    if ( pacer->target > 0.0 ) {
+        fprintf( out, ", target %.0f fps, %u missed", 1.0 / pacer->target,
+                pacer->missed );
+    }
+    fprintf( out, "\n  frame ms min %.2f mean %.2f max %.2f; swap ms mean "
+            "%.2f max %.2f; slept ms mean %.2f\n  ms", pacer->frameMin * 1e3,
+            pacer->frameTotal / frames * 1e3, pacer->frameMax * 1e3,
+            pacer->swapTotal / frames * 1e3, pacer->swapMax * 1e3,
+            pacer->sleepTotal / frames * 1e3 );
+    for ( i = 0 ; i < FRAME_HISTOGRAM_BUCKETS - 1 ; ++i ) {
+        fprintf( out, " <%.0f:%u", edges[i], pacer->histogram[i] );
+    }
+    fprintf( out, " >=%.0f:%u\n", edges[i - 1], pacer->histogram[i] );
+    fflush( out );
+
+    pacer->lastReport = now;
+    ResetCounts( pacer );
+}
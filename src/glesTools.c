@@ -3,32 +3,24 @@
 #include <string.h>
 #include <GLES2/gl2.h>
 #include "glesTools.h"
+#include "assets.h"
 #include <math.h>
 #include <png.h>
 
 char * loadShader( const char * _fileName )
 {
-    FILE * inputFile = fopen( _fileName, "rb" );
-    if ( inputFile == NULL ) {
-        fprintf( stderr, "%s: Error Loading %s", __FILE__, _fileName );
-        exit(1);
+    struct AssetData asset;
+    if ( !AssetOpen( _fileName, &asset ) ) {
+        return NULL;
     }
-    fseek( inputFile, 0, SEEK_END );
-    long fileSize = ftell( inputFile );
-    rewind( inputFile );
-
-    char * buffer;
-    buffer = (char *) malloc(sizeof(char) * (fileSize+1));
+    char * buffer = (char *) malloc(sizeof(char) * (asset.size+1));
     if (buffer == NULL) {
         fprintf( stderr, "%s: Memory Error", __FILE__ );
-        exit(1);
-    }
-    size_t result = fread(buffer, 1, fileSize, inputFile);
-    if ( result != fileSize ) {
-        fprintf(stderr, "%s: Read error", __FILE__);
+        AssetClose( &asset );
+        return NULL;
     }
-    fclose(inputFile);
-    buffer[fileSize] = '\0';
+    memcpy( buffer, asset.data, asset.size + 1 );
+    AssetClose( &asset );
     return buffer;
 }
 
@@ -37,68 +29,499 @@ float randFloat( void )
     return ((float)rand() / RAND_MAX);
 }
 
-GLuint loadObj( const char* _fileName, GLfloat **_vertices, GLushort **_elements )
+// Growable arrays for the OBJ parser.  Capacities only ever double so a mesh
+// costs a handful of reallocs no matter how many lines it has.
+static int ObjReserve( void **array, GLuint *capacity, GLuint needed,
+        size_t elementSize )
 {
-    FILE * inputFile = fopen( _fileName, "r" );
-    if ( inputFile == NULL ) {
-        fprintf( stderr, "%s: Error Loading %s\n", __FILE__, _fileName );
-        exit(1);
-    }
-    int mem = 64;
-    char *str = malloc(mem);
-
-    int verticesSize = 100;
-    int elementsSize = 100;
-    (*_vertices) = (GLfloat *)malloc(sizeof(GLfloat) * verticesSize);
-    (*_elements) = (GLushort *)malloc(sizeof(GLushort) * elementsSize);
-    int verticesPosition = 0;
-    int elementsPosition = 0;
-    if (str == NULL) {
-        fprintf( stderr, "%s: Memory Error", __FILE__ );
-        exit(1);
-    }
-    while (fgets(str, mem, inputFile) != NULL) {
-        while (str[strlen(str)-1]!='\n') {
-            mem *= 2;
-            str = realloc(str,mem);
-            fgets(str + mem/2 - 1, mem/2 + 1,inputFile);
-        }
-        float x, y;
-        int a, b, c;
-        if (sscanf(str, "v %f %f %*f", &x, &y) == 2) {
-            if (verticesPosition + 2 > verticesSize-1) {
-                verticesSize *= 2;
-                (*_vertices) = realloc(*_vertices, sizeof(GLfloat) * verticesSize);
+    if ( needed <= *capacity ) {
+        return 1;
+    }
+    GLuint newCapacity = *capacity ? *capacity : 64;
+    while ( newCapacity < needed ) {
+        newCapacity *= 2;
+    }
+    void *grown = realloc( *array, elementSize * newCapacity );
+    if ( grown == NULL ) {
+        return 0;
+    }
+    *array = grown;
+    *capacity = newCapacity;
+    return 1;
+}
+
+static const char * ObjSkipSpace( const char *c, const char *end )
+{
+    while ( c < end && ( *c == ' ' || *c == '\t' || *c == '\r' ) ) {
+        ++c;
+    }
+    return c;
+}
+
+static const char * ObjSkipLine( const char *c, const char *end )
+{
+    while ( c < end && *c != '\n' ) {
+        ++c;
+    }
+    return c;
+}
+
+static int ObjParseInt( const char **cursor, const char *end, int *value )
+{
+    const char *c = *cursor;
+    int negative = 0;
+    if ( c < end && ( *c == '-' || *c == '+' ) ) {
+        negative = *c++ == '-';
+    }
+    if ( c == end || *c < '0' || *c > '9' ) {
+        return 0;
+    }
+    long result = 0;
+    while ( c < end && *c >= '0' && *c <= '9' ) {
+        if ( result < 0x7fffffffL ) {
+            result = result * 10 + ( *c - '0' );
+        }
+        ++c;
+    }
+    *value = negative ? -(int)result : (int)result;
+    *cursor = c;
+    return 1;
+}
+
+static int ObjParseFloat( const char **cursor, const char *end, GLfloat *value )
+{
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+        1e13, 1e14, 1e15, 1e16, 1e17, 1e18
+    };
+    const char *c = *cursor;
+    int negative = 0;
+    if ( c < end && ( *c == '-' || *c == '+' ) ) {
+        negative = *c++ == '-';
+    }
+    // Up to 18 significant digits are accumulated exactly in an integer,
+    // the rest only move the exponent.
+    unsigned long long mantissa = 0;
+    long long exponent = 0;
+    int digits = 0, any = 0;
+    while ( c < end && *c >= '0' && *c <= '9' ) {
+        if ( digits < 18 ) {
+            mantissa = mantissa * 10 + ( *c - '0' );
+            digits += mantissa != 0;
+        } else {
+            ++exponent;
+        }
+        ++c;
+        any = 1;
+    }
+    if ( c < end && *c == '.' ) {
+        ++c;
+        while ( c < end && *c >= '0' && *c <= '9' ) {
+            if ( digits < 18 ) {
+                mantissa = mantissa * 10 + ( *c - '0' );
+                digits += mantissa != 0;
+                --exponent;
+            }
+            ++c;
+            any = 1;
+        }
+    }
+    if ( !any ) {
+        return 0;
+    }
+    if ( c < end && ( *c == 'e' || *c == 'E' ) ) {
+        const char *e = c + 1;
+        int power;
+        if ( ObjParseInt( &e, end, &power ) ) {
+            exponent += power;
+            c = e;
+        }
+    }
+    // Past 10^64 either way a GLfloat is inf or 0 whatever the mantissa, so
+    // a silly exponent doesn't keep the loops below going.
+    if ( exponent > 64 ) {
+        exponent = 64;
+    } else if ( exponent < -64 ) {
+        exponent = -64;
+    }
+    double result = (double)mantissa;
+    while ( exponent > 18 ) {
+        result *= 1e18;
+        exponent -= 18;
+    }
+    while ( exponent < -18 ) {
+        result /= 1e18;
+        exponent += 18;
+    }
+    result = exponent < 0 ? result / powers[-exponent] :
+        result * powers[exponent];
+    *value = (GLfloat)( negative ? -result : result );
+    *cursor = c;
+    return 1;
+}
+
+// Output vertices are unique (position, texCoord, normal) triples from the
+// face corners.  They are looked up in an open addressed table that stores
+// vertex number + 1, 0 meaning empty.
+struct ObjParser
+{
+    GLfloat *positions, *texCoords, *normals;
+    GLuint positionsCount, texCoordsCount, normalsCount;
+    GLuint positionsCapacity, texCoordsCapacity, normalsCapacity;
+
+    GLint *corners; // 3 per output vertex, -1 for a missing attribute.
+    GLuint vertexCount, cornersCapacity;
+    GLuint *hash;
+    GLuint hashCapacity;
+
+    GLuint *triangles, *lines;
+    GLuint trianglesSize, linesSize;
+    GLuint trianglesCapacity, linesCapacity;
+};
+
+static GLuint ObjHash( const GLint *corner )
+{
+    GLuint h = (GLuint)corner[0] * 73856093u;
+    h ^= (GLuint)corner[1] * 19349663u;
+    h ^= (GLuint)corner[2] * 83492791u;
+    return h;
+}
+
+static int ObjRehash( struct ObjParser *parser )
+{
+    GLuint capacity = parser->hashCapacity ? parser->hashCapacity * 2 : 1024;
+    GLuint *hash = calloc( capacity, sizeof(GLuint) );
+    if ( hash == NULL ) {
+        return 0;
+    }
+    GLuint i;
+    for ( i = 0 ; i < parser->vertexCount ; ++i ) {
+        GLuint slot = ObjHash( &parser->corners[3*i] ) & (capacity - 1);
+        while ( hash[slot] ) {
+            slot = ( slot + 1 ) & (capacity - 1);
+        }
+        hash[slot] = i + 1;
+    }
+    free( parser->hash );
+    parser->hash = hash;
+    parser->hashCapacity = capacity;
+    return 1;
+}
+
+static int ObjVertex( struct ObjParser *parser, const GLint *corner,
+        GLuint *index )
+{
+    if ( 2 * ( parser->vertexCount + 1 ) > parser->hashCapacity &&
+            !ObjRehash( parser ) ) {
+        return 0;
+    }
+    GLuint mask = parser->hashCapacity - 1;
+    GLuint slot = ObjHash( corner ) & mask;
+    while ( parser->hash[slot] ) {
+        const GLint *other = &parser->corners[3 * (parser->hash[slot] - 1)];
+        if ( other[0] == corner[0] && other[1] == corner[1] &&
+                other[2] == corner[2] ) {
+            *index = parser->hash[slot] - 1;
+            return 1;
+        }
+        slot = ( slot + 1 ) & mask;
+    }
+    if ( !ObjReserve( (void **)&parser->corners, &parser->cornersCapacity,
+                3 * ( parser->vertexCount + 1 ), sizeof(GLint) ) ) {
+        return 0;
+    }
+    memcpy( &parser->corners[3 * parser->vertexCount], corner,
+            3 * sizeof(GLint) );
+    parser->hash[slot] = ++parser->vertexCount;
+    *index = parser->vertexCount - 1;
+    return 1;
+}
+
+// Resolves a 1 based or negative (relative to the end) OBJ index.
+static int ObjResolve( int index, GLuint count, GLint *resolved )
+{
+    if ( index > 0 && (GLuint)index <= count ) {
+        *resolved = index - 1;
+    } else if ( index < 0 && (GLuint)-index <= count ) {
+        *resolved = (GLint)count + index;
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+static int ObjParseCorner( struct ObjParser *parser, const char **cursor,
+        const char *end, GLuint *index )
+{
+    GLint corner[3] = { -1, -1, -1 };
+    int value;
+    if ( !ObjParseInt( cursor, end, &value ) ||
+            !ObjResolve( value, parser->positionsCount, &corner[0] ) ) {
+        return 0;
+    }
+    if ( *cursor < end && **cursor == '/' ) {
+        ++*cursor;
+        if ( ObjParseInt( cursor, end, &value ) &&
+                !ObjResolve( value, parser->texCoordsCount, &corner[1] ) ) {
+            return 0;
+        }
+        if ( *cursor < end && **cursor == '/' ) {
+            ++*cursor;
+            if ( ObjParseInt( cursor, end, &value ) &&
+                    !ObjResolve( value, parser->normalsCount, &corner[2] ) ) {
+                return 0;
+            }
+        }
+    }
+    return ObjVertex( parser, corner, index );
+}
+
+static int ObjPush( GLuint **array, GLuint *size, GLuint *capacity,
+        const GLuint *indices, GLuint count )
+{
+    if ( !ObjReserve( (void **)array, capacity, *size + count,
+                sizeof(GLuint) ) ) {
+        return 0;
+    }
+    memcpy( &(*array)[*size], indices, count * sizeof(GLuint) );
+    *size += count;
+    return 1;
+}
+
+// f lines are triangulated as a fan, two corner faces and l polylines become
+// line segments.
+static int ObjParseElement( struct ObjParser *parser, const char **cursor,
+        const char *end, int polyline )
+{
+    GLuint first = 0, previous = 0, current;
+    GLuint corners = 0;
+    for ( ;; ) {
+        *cursor = ObjSkipSpace( *cursor, end );
+        if ( *cursor == end || **cursor == '\n' || **cursor == '#' ) {
+            break;
+        }
+        if ( !ObjParseCorner( parser, cursor, end, &current ) ) {
+            return 0;
+        }
+        if ( corners == 0 ) {
+            first = current;
+        } else if ( polyline ) {
+            GLuint segment[2] = { previous, current };
+            if ( !ObjPush( &parser->lines, &parser->linesSize,
+                        &parser->linesCapacity, segment, 2 ) ) {
+                return 0;
             }
-            (*_vertices)[verticesPosition++] = x;
-            (*_vertices)[verticesPosition++] = y;
-        } else if(sscanf(str, "f %d %d %d", &a, &b, &c) == 3) {
-            if(elementsPosition + 3 > elementsSize-1) {
-                elementsSize *= 2;
-                (*_elements) = realloc((*_elements), sizeof(GLushort) * elementsSize);
+        } else if ( corners >= 2 ) {
+            GLuint triangle[3] = { first, previous, current };
+            if ( !ObjPush( &parser->triangles, &parser->trianglesSize,
+                        &parser->trianglesCapacity, triangle, 3 ) ) {
+                return 0;
+            }
+        }
+        previous = current;
+        ++corners;
+    }
+    if ( !polyline && corners == 2 ) {
+        GLuint segment[2] = { first, previous };
+        return ObjPush( &parser->lines, &parser->linesSize,
+                &parser->linesCapacity, segment, 2 );
+    }
+    return corners >= 2;
+}
+
+static int ObjParseFloats( const char **cursor, const char *end,
+        GLfloat **array, GLuint *count, GLuint *capacity, int components,
+        int required )
+{
+    if ( !ObjReserve( (void **)array, capacity,
+                components * ( *count + 1 ), sizeof(GLfloat) ) ) {
+        return 0;
+    }
+    GLfloat *value = &(*array)[components * *count];
+    int i;
+    for ( i = 0 ; i < components ; ++i ) {
+        *cursor = ObjSkipSpace( *cursor, end );
+        if ( !ObjParseFloat( cursor, end, &value[i] ) ) {
+            if ( i < required ) {
+                return 0;
             }
-            (*_elements)[elementsPosition++] = a-1;
-            (*_elements)[elementsPosition++] = b-1;
-            (*_elements)[elementsPosition++] = c-1;
-        } else if(sscanf(str, "f %d %d", &a, &b) == 2) {
-            if(elementsPosition + 2 > elementsSize-1) {
-                elementsSize *= 2;
-                (*_elements) = realloc((*_elements), sizeof(GLushort) * elementsSize);
+            value[i] = 0.0f;
+        }
+    }
+    ++*count;
+    return 1;
+}
+
+static void ObjFreeParser( struct ObjParser *parser )
+{
+    free( parser->positions );
+    free( parser->texCoords );
+    free( parser->normals );
+    free( parser->corners );
+    free( parser->hash );
+    free( parser->triangles );
+    free( parser->lines );
+}
+
+int ParseObj( const char *data, size_t size, struct ObjMesh *mesh )
+{
+    struct ObjParser parser;
+    memset( &parser, 0, sizeof(parser) );
+    memset( mesh, 0, sizeof(*mesh) );
+
+    const char *c = data;
+    const char *end = data + size;
+    GLuint line = 1;
+    int ok = 1;
+    while ( ok && c < end ) {
+        c = ObjSkipSpace( c, end );
+        if ( c + 1 < end && c[0] == 'v' && ( c[1] == ' ' || c[1] == '\t' ) ) {
+            c += 1;
+            ok = ObjParseFloats( &c, end, &parser.positions,
+                    &parser.positionsCount, &parser.positionsCapacity, 3, 2 );
+        } else if ( c + 2 < end && c[0] == 'v' && c[1] == 't' ) {
+            c += 2;
+            ok = ObjParseFloats( &c, end, &parser.texCoords,
+                    &parser.texCoordsCount, &parser.texCoordsCapacity, 2, 1 );
+        } else if ( c + 2 < end && c[0] == 'v' && c[1] == 'n' ) {
+            c += 2;
+            ok = ObjParseFloats( &c, end, &parser.normals,
+                    &parser.normalsCount, &parser.normalsCapacity, 3, 3 );
+        } else if ( c + 1 < end && ( c[0] == 'f' || c[0] == 'l' ) &&
+                ( c[1] == ' ' || c[1] == '\t' ) ) {
+            int polyline = c[0] == 'l';
+            c += 1;
+            ok = ObjParseElement( &parser, &c, end, polyline );
+        }
+        // Everything else (comments, o, g, s, usemtl, ...) is ignored.
+        c = ObjSkipLine( c, end );
+        if ( c < end ) {
+            ++c;
+            ++line;
+        }
+    }
+    if ( !ok ) {
+        fprintf( stderr, "%s: Bad OBJ data on line %u\n", __FILE__, line );
+        ObjFreeParser( &parser );
+        return 0;
+    }
+
+    // Expand the unique corners into flat arrays.
+    GLuint vertexCount = parser.vertexCount;
+    int haveTexCoords = 0, haveNormals = 0;
+    GLuint i;
+    for ( i = 0 ; i < vertexCount ; ++i ) {
+        haveTexCoords |= parser.corners[3*i+1] >= 0;
+        haveNormals |= parser.corners[3*i+2] >= 0;
+    }
+    GLuint indicesSize = parser.trianglesSize + parser.linesSize;
+    mesh->positions = malloc( sizeof(GLfloat) * 3 * vertexCount + 1 );
+    mesh->texCoords = haveTexCoords ?
+        malloc( sizeof(GLfloat) * 2 * vertexCount ) : NULL;
+    mesh->normals = haveNormals ?
+        malloc( sizeof(GLfloat) * 3 * vertexCount ) : NULL;
+    mesh->indexType = vertexCount > 0xffff ? GL_UNSIGNED_INT :
+        GL_UNSIGNED_SHORT;
+    mesh->indices = malloc( ( mesh->indexType == GL_UNSIGNED_INT ?
+                sizeof(GLuint) : sizeof(GLushort) ) * indicesSize + 1 );
+    if ( mesh->positions == NULL || mesh->indices == NULL ||
+            ( haveTexCoords && mesh->texCoords == NULL ) ||
+            ( haveNormals && mesh->normals == NULL ) ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        ObjFreeParser( &parser );
+        FreeObj( mesh );
+        return 0;
+    }
+    for ( i = 0 ; i < vertexCount ; ++i ) {
+        const GLint *corner = &parser.corners[3*i];
+        memcpy( &mesh->positions[3*i], &parser.positions[3*corner[0]],
+                3 * sizeof(GLfloat) );
+        if ( haveTexCoords ) {
+            mesh->texCoords[2*i] = corner[1] < 0 ? 0.0f :
+                parser.texCoords[2*corner[1]];
+            mesh->texCoords[2*i+1] = corner[1] < 0 ? 0.0f :
+                parser.texCoords[2*corner[1]+1];
+        }
+        if ( haveNormals ) {
+            if ( corner[2] < 0 ) {
+                memset( &mesh->normals[3*i], 0, 3 * sizeof(GLfloat) );
+            } else {
+                memcpy( &mesh->normals[3*i], &parser.normals[3*corner[2]],
+                        3 * sizeof(GLfloat) );
             }
-            (*_elements)[elementsPosition++] = a-1;
-            (*_elements)[elementsPosition++] = b-1;
         }
     }
-    (*_vertices) = realloc((*_vertices), sizeof(GLfloat) * verticesPosition);
-    (*_elements) = realloc((*_elements), sizeof(GLushort) * elementsPosition);
-    free(str);
-    return elementsPosition;
+    // Triangles first, then line segments, in one index array.
+    for ( i = 0 ; i < indicesSize ; ++i ) {
+        GLuint index = i < parser.trianglesSize ? parser.triangles[i] :
+            parser.lines[i - parser.trianglesSize];
+        if ( mesh->indexType == GL_UNSIGNED_INT ) {
+            ((GLuint *)mesh->indices)[i] = index;
+        } else {
+            ((GLushort *)mesh->indices)[i] = index;
+        }
+    }
+    mesh->vertexCount = vertexCount;
+    mesh->trianglesSize = parser.trianglesSize;
+    mesh->linesSize = parser.linesSize;
+    ObjFreeParser( &parser );
+    return 1;
+}
+
+void FreeObj( struct ObjMesh *mesh )
+{
+    free( mesh->positions );
+    free( mesh->texCoords );
+    free( mesh->normals );
+    free( mesh->indices );
+    memset( mesh, 0, sizeof(*mesh) );
+}
+
+GLuint loadObj( const char* _fileName, GLfloat **_vertices, GLushort **_elements )
+{
+    struct AssetData asset;
+    struct ObjMesh mesh;
+    int parsed = AssetOpen( _fileName, &asset ) &&
+            ParseObj( (const char *)asset.data, asset.size, &mesh );
+    AssetClose( &asset );
+    if ( !parsed ) {
+        fprintf( stderr, "%s: Error Loading %s\n", __FILE__, _fileName );
+        return 0;
+    }
+    if ( mesh.indexType != GL_UNSIGNED_SHORT ) {
+        fprintf( stderr, "%s: %s has %u vertices, too many for GLushort "
+                "elements\n", __FILE__, _fileName, mesh.vertexCount );
+        FreeObj( &mesh );
+        return 0;
+    }
+
+    // The table is flat, keep x and y.
+    GLuint i;
+    (*_vertices) = malloc( sizeof(GLfloat) * 2 * mesh.vertexCount + 1 );
+    if ( *_vertices == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        FreeObj( &mesh );
+        return 0;
+    }
+    for ( i = 0 ; i < mesh.vertexCount ; ++i ) {
+        (*_vertices)[2*i] = mesh.positions[3*i];
+        (*_vertices)[2*i+1] = mesh.positions[3*i+1];
+    }
+    (*_elements) = mesh.indices;
+    mesh.indices = NULL;
+    GLuint elementsSize = mesh.trianglesSize + mesh.linesSize;
+    FreeObj( &mesh );
+    return elementsSize;
 }
 
 GLfloat * ComputeSurfaceNormals( const GLfloat *points, const GLushort
         *elements, const GLuint elementsSize )
 {
     GLfloat *normals = malloc(sizeof(GLfloat) * elementsSize);
+    if ( normals == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        return NULL;
+    }
     GLfloat *normalsIterator = normals;
     unsigned int i = 0;
     for( i = 1 ; i < elementsSize ; i+=2 ) {
@@ -112,92 +535,107 @@ GLfloat * ComputeSurfaceNormals( const GLfloat *points, const GLushort
     return normals;
 }
 
-unsigned char* PngTexture(const char * _fileName, int **_width, int **_height)
+struct PngReader
 {
-    FILE * inputFile = fopen( _fileName, "rb" );
-    if ( inputFile == NULL ) {
-        fprintf( stderr, "%s: Error Loading %s\n", __FILE__, _fileName );
-        exit(1);
+    const unsigned char *data;
+    size_t size;
+    size_t position;
+};
+
+static void PngRead( png_structp png_ptr, png_bytep data, png_size_t length )
+{
+    struct PngReader *reader = png_get_io_ptr( png_ptr );
+    if ( length > reader->size - reader->position ) {
+        png_error( png_ptr, "read past end of data" );
     }
-    unsigned char sig[8];
-    fread(sig, 1, 8, inputFile);
-    if( !png_check_sig(sig, 8) ) {
+    memcpy( data, reader->data + reader->position, length );
+    reader->position += length;
+}
+
+int PngTexture( const char * _fileName, struct PngImage *image )
+{
+    struct AssetData asset;
+    if ( !AssetOpen( _fileName, &asset ) ) {
+        return 0;
+    }
+    struct PngReader reader = { asset.data, asset.size, 8 };
+    if ( asset.size < 8 || png_sig_cmp( (png_bytep)asset.data, 0, 8 ) ) {
         fprintf( stderr, "%s: Error: %s is not a png file\n", __FILE__, _fileName );
-        exit(1);
+        AssetClose( &asset );
+        return 0;
     }
-    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,0,0,0);
-    if(!png_ptr) {
-        fprintf(stderr, "%s: %s png_create_read_struct\n", __FILE__, _fileName);
-        exit(1);
+    png_structp png_ptr = png_create_read_struct( PNG_LIBPNG_VER_STRING, 0, 0, 0 );
+    png_infop info_ptr = png_ptr ? png_create_info_struct( png_ptr ) : NULL;
+    if ( info_ptr == NULL ) {
+        fprintf( stderr, "%s: %s png_create_read_struct\n", __FILE__, _fileName );
+        png_destroy_read_struct( &png_ptr, 0, 0 );
+        AssetClose( &asset );
+        return 0;
     }
-
-    png_infop info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr) {
-        png_destroy_read_struct(&png_ptr, 0, 0);
-        fprintf(stderr, "%s: %s png_create_info_struct\n", __FILE__, _fileName);
-        exit(1);
+    if ( setjmp( png_jmpbuf( png_ptr ) ) ) {
+        fprintf( stderr, "%s: %s Error reading image\n", __FILE__, _fileName );
+        png_destroy_read_struct( &png_ptr, &info_ptr, 0 );
+        AssetClose( &asset );
+        return 0;
     }
-    if(setjmp(png_ptr->jmpbuf)) {
-        fprintf(stderr, "%s: %s init_io\n", __FILE__, _fileName);
-        png_destroy_read_struct(&png_ptr, &info_ptr, 0);
-        exit(1);
-    }
-    png_init_io(png_ptr, inputFile);
-    png_set_sig_bytes(png_ptr, 8);
-    png_read_info(png_ptr, info_ptr);
-
-    int width = png_get_image_width(png_ptr, info_ptr);
-    int height = png_get_image_height(png_ptr, info_ptr);
-    (*_width) = malloc(sizeof(int));
-    (*_height) = malloc(sizeof(int));
-    memcpy((*_width), &width, sizeof(int));
-    memcpy((*_height), &height, sizeof(int));
-
-    png_byte color_type = png_get_color_type(png_ptr, info_ptr);
-    png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-
-    int number_of_passes = png_set_interlace_handling(png_ptr);
-    png_read_update_info(png_ptr, info_ptr);
+    png_set_read_fn( png_ptr, &reader, PngRead );
+    png_set_sig_bytes( png_ptr, 8 );
+    png_read_info( png_ptr, info_ptr );
 
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        fprintf(stderr, "%s: %s Error reading image\n", __FILE__, _fileName);
-        exit(1);
+    // Let libpng turn whatever is in the file into 8 bit RGBA.
+    png_byte color_type = png_get_color_type( png_ptr, info_ptr );
+    if ( color_type == PNG_COLOR_TYPE_PALETTE ) {
+        png_set_palette_to_rgb( png_ptr );
     }
-    png_bytep * row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * height);
-    int x, y;
-    for ( y=0 ; y < height ; ++y ) {
-        row_pointers[y] = (png_byte*) malloc(png_get_rowbytes(png_ptr,info_ptr));
+    if ( color_type == PNG_COLOR_TYPE_GRAY ||
+            color_type == PNG_COLOR_TYPE_GRAY_ALPHA ) {
+        png_set_expand_gray_1_2_4_to_8( png_ptr );
+        png_set_gray_to_rgb( png_ptr );
     }
+    if ( png_get_valid( png_ptr, info_ptr, PNG_INFO_tRNS ) ) {
+        png_set_tRNS_to_alpha( png_ptr );
+    } else if ( !( color_type & PNG_COLOR_MASK_ALPHA ) ) {
+        png_set_filler( png_ptr, 0xff, PNG_FILLER_AFTER );
+    }
+    png_set_strip_16( png_ptr );
+    int passes = png_set_interlace_handling( png_ptr );
+    png_read_update_info( png_ptr, info_ptr );
 
-    png_read_image(png_ptr, row_pointers);
-
-    fclose(inputFile);
-
-    if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_RGB) {
-        fprintf(stderr, "%s: %s input file is PNG_COLOR_TYPE_RGB but must be PNG_COLOR_TYPE_RGBA (lacks the alpha channel)\n", __FILE__, _fileName);
-        exit(1);
+    int width = png_get_image_width( png_ptr, info_ptr );
+    int height = png_get_image_height( png_ptr, info_ptr );
+    size_t rowBytes = png_get_rowbytes( png_ptr, info_ptr );
+    if ( rowBytes != 4 * (size_t)width ) {
+        png_error( png_ptr, "unexpected row size after transforms" );
     }
-    if (png_get_color_type(png_ptr, info_ptr) != PNG_COLOR_TYPE_RGBA) {
-        fprintf(stderr, "%s: %s color_type of input file must be PNG_COLOR_TYPE_RGBA (%d) (is %d)\n", __FILE__, _fileName, PNG_COLOR_TYPE_RGBA, png_get_color_type(png_ptr, info_ptr));
-        exit(1);
+    size_t size = rowBytes * height;
+    if ( size > image->capacity ) {
+        unsigned char *pixels = realloc( image->pixels, size );
+        if ( pixels == NULL ) {
+            png_error( png_ptr, "out of memory" );
+        }
+        image->pixels = pixels;
+        image->capacity = size;
     }
-    unsigned char *buffer = malloc( 4 * width * height );
-    unsigned char *bufferPos = buffer;
-    for( y = 0 ; y < height ; ++y ) {
-        png_byte* row = row_pointers[y];
-        for ( x = 0 ; x < width ; ++x ){
-            png_byte* ptr = &(row[x*4]);
-            int i = 0;
-            for ( ; i < 4 ; ++i )
-                (*bufferPos++) = (*ptr++);
-            //printf("Pixel at position [ %d - %d ] has RGBA values: %d - %d - %d - %d\n",
-            //       x, y, ptr[0], ptr[1], ptr[2], ptr[3]);
+
+    // Rows go straight to their place in the staging buffer.  Interlaced
+    // images take several passes over the same rows.
+    int pass, y;
+    for ( pass = 0 ; pass < passes ; ++pass ) {
+        for ( y = 0 ; y < height ; ++y ) {
+            png_read_row( png_ptr, image->pixels + y * rowBytes, NULL );
         }
     }
-    /* cleanup heap allocation */
-    for (y=0; y<height; y++)
-        free(row_pointers[y]);
-    free(row_pointers);
+    png_read_end( png_ptr, NULL );
+    png_destroy_read_struct( &png_ptr, &info_ptr, 0 );
+    AssetClose( &asset );
 
-    return buffer;
+    image->width = width;
+    image->height = height;
+    return 1;
+}
+
+void FreePngImage( struct PngImage *image )
+{
+    free( image->pixels );
+    memset( image, 0, sizeof(*image) );
 }
@@ -76,8 +76,8 @@ void scalarU(GLfloat *_result, const GLfloat *_vec, GLfloat _scalar, const GLuin
         _result[i] = _scalar * _vec[i];
     }
 }
-void distanceSquared(GLfloat *_result, GLfloat *_point1, GLfloat *_point2,
-        GLuint _dimension)
+void distanceSquared(GLfloat *_result, const GLfloat *_point1, const GLfloat
+        *_point2, GLuint _dimension)
 {
     int i;
     *_result = 0.0f;
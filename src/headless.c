@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "headless.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+typedef EGLDisplay (*GetPlatformDisplayProc)( EGLenum platform, void
+        *nativeDisplay, const EGLint *attribList );
+
+static EGLDisplay HeadlessGetDisplay( void )
+{
+    const char *extensions = eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS );
+    if ( extensions != NULL &&
+         strstr( extensions, "EGL_MESA_platform_surfaceless" ) != NULL ) {
+        GetPlatformDisplayProc getPlatformDisplay = (GetPlatformDisplayProc)
+                eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+        if ( getPlatformDisplay != NULL ) {
+            EGLDisplay display = getPlatformDisplay(
+                    EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL );
+            if ( display != EGL_NO_DISPLAY ) {
+                return display;
+            }
+        }
+    }
+    return eglGetDisplay( EGL_DEFAULT_DISPLAY );
+}
+
+int HeadlessCreateContext( ESContext *esContext, GLint width, GLint height )
+{
+    EGLint majorVersion, minorVersion;
+    EGLint numConfigs;
+    EGLConfig config;
+    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLint pbufferConfigAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    EGLint anyConfigAttribs[] = {
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+    // The pbuffer is only there to make the context current.  Everything is
+    // drawn into an FBO of the requested size.
+    EGLint pbufferAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+
+    EGLDisplay display = HeadlessGetDisplay();
+    if ( display == EGL_NO_DISPLAY ) {
+        fprintf( stderr, "%s: No EGL display\n", __FILE__ );
+        return 0;
+    }
+    if ( !eglInitialize( display, &majorVersion, &minorVersion ) ) {
+        fprintf( stderr, "%s: eglInitialize failed (0x%x)\n", __FILE__,
+                eglGetError() );
+        return 0;
+    }
+    eglBindAPI( EGL_OPENGL_ES_API );
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if ( eglChooseConfig( display, pbufferConfigAttribs, &config, 1,
+            &numConfigs ) && numConfigs > 0 ) {
+        surface = eglCreatePbufferSurface( display, config, pbufferAttribs );
+    }
+    if ( surface == EGL_NO_SURFACE ) {
+        const char *extensions = eglQueryString( display, EGL_EXTENSIONS );
+        if ( extensions == NULL ||
+             strstr( extensions, "EGL_KHR_surfaceless_context" ) == NULL ) {
+            fprintf( stderr, "%s: Neither pbuffers nor surfaceless contexts "
+                    "are available\n", __FILE__ );
+            eglTerminate( display );
+            return 0;
+        }
+        if ( !eglChooseConfig( display, anyConfigAttribs, &config, 1,
+                &numConfigs ) || numConfigs < 1 ) {
+            fprintf( stderr, "%s: No ES2 config\n", __FILE__ );
+            eglTerminate( display );
+            return 0;
+        }
+    }
+
+    EGLContext context = eglCreateContext( display, config, EGL_NO_CONTEXT,
+            contextAttribs );
+    if ( context == EGL_NO_CONTEXT ) {
+        fprintf( stderr, "%s: eglCreateContext failed (0x%x)\n", __FILE__,
+                eglGetError() );
+        eglTerminate( display );
+        return 0;
+    }
+    if ( !eglMakeCurrent( display, surface, surface, context ) ) {
+        fprintf( stderr, "%s: eglMakeCurrent failed (0x%x)\n", __FILE__,
+                eglGetError() );
+        eglDestroyContext( display, context );
+        eglTerminate( display );
+        return 0;
+    }
+
+    esContext->eglDisplay = display;
+    esContext->eglSurface = surface;
+    esContext->eglContext = context;
+    esContext->width = width;
+    esContext->height = height;
+    return 1;
+}
+
+void HeadlessDestroyContext( ESContext *esContext )
+{
+    eglMakeCurrent( esContext->eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+            EGL_NO_CONTEXT );
+    eglDestroyContext( esContext->eglDisplay, esContext->eglContext );
+    if ( esContext->eglSurface != EGL_NO_SURFACE ) {
+        eglDestroySurface( esContext->eglDisplay, esContext->eglSurface );
+    }
+    eglTerminate( esContext->eglDisplay );
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/input.h>
+#include "input.h"
+
+int InputParseLine( const char *line, struct InputCommand *command )
+{
+    char word[16];
+    GLfloat x, y;
+
+    memset( command, 0, sizeof(*command) );
+    if ( sscanf( line, "%f %f", &x, &y ) == 2 ) {
+        command->type = INPUT_POINT;
+    } else if ( sscanf( line, "%15s", word ) != 1 ) {
+        return 0;
+    } else if ( strcmp( word, "y" ) == 0 || strcmp( word, "yes" ) == 0 ) {
+        command->type = INPUT_CONFIRM;
+        return 1;
+    } else if ( strcmp( word, "n" ) == 0 || strcmp( word, "no" ) == 0 ) {
+        command->type = INPUT_CANCEL;
+        return 1;
+    } else if ( sscanf( line, "%*s %f %f", &x, &y ) != 2 ) {
+        return 0;
+    } else if ( strcmp( word, "place" ) == 0 ) {
+        command->type = INPUT_PLACE;
+    } else if ( strcmp( word, "shoot" ) == 0 ) {
+        command->type = INPUT_SHOOT;
+    } else if ( strcmp( word, "move" ) == 0 ) {
+        command->type = INPUT_MOVE;
+    } else {
+        return 0;
+    }
+    command->value[0] = x;
+    command->value[1] = y;
+    return 1;
+}
+
+// Hand a command to the render thread.  If it has fallen behind, wait for
+// room rather than drop a shot, but give up as soon as InputStop is called.
+static int InputPush( struct Input *input, GLint type, GLfloat x, GLfloat y )
+{
+    struct InputCommand command;
+    command.type = type;
+    command.value[0] = x;
+    command.value[1] = y;
+    while ( !RingPush( &input->commands, &command ) ) {
+        struct pollfd wake = { input->wake[0], POLLIN, 0 };
+        if ( poll( &wake, 1, 1 ) > 0 ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void InputEndLine( struct Input *input )
+{
+    struct InputCommand command;
+    input->line[ input->lineLength ] = '\0';
+    if ( InputParseLine( input->line, &command ) ) {
+        InputPush( input, command.type, command.value[0], command.value[1] );
+    } else if ( strspn( input->line, " \t\r" ) != input->lineLength ) {
+        fprintf( stderr, "%s: Ignoring \"%s\"\n", __FILE__, input->line );
+    }
+    input->lineLength = 0;
+}
+
+// Returns 0 at end of file.
+static int InputReadText( struct Input *input )
+{
+    char buffer[ INPUT_LINE_SIZE ];
+    ssize_t size = read( input->fd, buffer, sizeof(buffer) );
+    if ( size < 0 ) {
+        return errno == EINTR || errno == EAGAIN;
+    }
+    if ( size == 0 ) {
+        if ( input->lineLength > 0 ) {
+            InputEndLine( input );
+        }
+        return 0;
+    }
+    ssize_t i;
+    for ( i = 0 ; i < size ; ++i ) {
+        if ( buffer[i] == '\n' ) {
+            InputEndLine( input );
+        } else if ( input->lineLength < INPUT_LINE_SIZE - 1 ) {
+            input->line[ input->lineLength++ ] = buffer[i];
+        }
+    }
+    return 1;
+}
+
+static void InputKey( struct Input *input, const struct input_event *event )
+{
+    // value is 1 for a press, 2 for each autorepeat and 0 for the release.
+    // Arrows move on the press and repeat while held, everything else acts on
+    // the press alone.
+    if ( event->value == 0 ) {
+        return;
+    }
+    switch ( event->code ) {
+        case KEY_LEFT:
+            InputPush( input, INPUT_MOVE, -INPUT_KEY_STEP, 0.0f );
+            return;
+        case KEY_RIGHT:
+            InputPush( input, INPUT_MOVE, INPUT_KEY_STEP, 0.0f );
+            return;
+        case KEY_UP:
+            InputPush( input, INPUT_MOVE, 0.0f, INPUT_KEY_STEP );
+            return;
+        case KEY_DOWN:
+            InputPush( input, INPUT_MOVE, 0.0f, -INPUT_KEY_STEP );
+            return;
+    }
+    if ( event->value != 1 ) {
+        return;
+    }
+    switch ( event->code ) {
+        case BTN_LEFT:
+        case KEY_ENTER:
+        case KEY_KPENTER:
+        case KEY_SPACE:
+        case KEY_Y:
+            InputPush( input, INPUT_CONFIRM, 0.0f, 0.0f );
+            break;
+        case BTN_RIGHT:
+        case KEY_ESC:
+        case KEY_BACKSPACE:
+        case KEY_N:
+            InputPush( input, INPUT_CANCEL, 0.0f, 0.0f );
+            break;
+    }
+}
+
+// Returns 0 once the device has gone away.
+static int InputReadEvents( struct Input *input )
+{
+    struct input_event events[ 16 ];
+    ssize_t size = read( input->fd, events, sizeof(events) );
+    if ( size < 0 ) {
+        return errno == EINTR || errno == EAGAIN;
+    }
+    if ( size == 0 ) {
+        return 0;
+    }
+    size_t count = (size_t) size / sizeof(events[0]);
+    size_t i;
+    for ( i = 0 ; i < count ; ++i ) {
+        const struct input_event *event = &events[i];
+        if ( event->type == EV_KEY ) {
+            InputKey( input, event );
+        } else if ( event->type == EV_REL && event->code == REL_X ) {
+            input->move[0] += event->value * INPUT_MOUSE_SCALE;
+        } else if ( event->type == EV_REL && event->code == REL_Y ) {
+            // Screen y grows down, table y grows up.
+            input->move[1] -= event->value * INPUT_MOUSE_SCALE;
+        } else if ( event->type == EV_SYN && event->code == SYN_REPORT &&
+                ( input->move[0] != 0.0f || input->move[1] != 0.0f ) ) {
+            // One move per report instead of one per axis per count.
+            InputPush( input, INPUT_MOVE, input->move[0], input->move[1] );
+            input->move[0] = 0.0f;
+            input->move[1] = 0.0f;
+        }
+    }
+    return 1;
+}
+
+static void * InputMain( void *arg )
+{
+    struct Input *input = arg;
+    struct pollfd fds[2] = {
+        { input->fd, POLLIN, 0 },
+        { input->wake[0], POLLIN, 0 },
+    };
+    for ( ;; ) {
+        if ( poll( fds, 2, -1 ) < 0 ) {
+            if ( errno == EINTR ) {
+                continue;
+            }
+            fprintf( stderr, "%s: poll failed\n", __FILE__ );
+            return NULL;
+        }
+        if ( fds[1].revents != 0 ) {
+            return NULL;
+        }
+        if ( fds[0].revents != 0 ) {
+            int open = input->evdev ? InputReadEvents( input ) :
+                InputReadText( input );
+            if ( !open ) {
+                return NULL;
+            }
+        }
+    }
+}
+
+///
+// Open the source and start reading it.  A FIFO is opened read/write so it
+// stays open, rather than hitting end of file, between writers.
+//
+int InputStart( struct Input *input, const char *path )
+{
+    memset( input, 0, sizeof(*input) );
+    input->fd = STDIN_FILENO;
+    if ( path != NULL && strcmp( path, "-" ) != 0 ) {
+        struct stat info;
+        if ( stat( path, &info ) != 0 ) {
+            fprintf( stderr, "%s: Can't find %s\n", __FILE__, path );
+            return 0;
+        }
+        input->evdev = S_ISCHR( info.st_mode );
+        input->fd = open( path, S_ISFIFO( info.st_mode ) ? O_RDWR : O_RDONLY );
+        if ( input->fd < 0 ) {
+            fprintf( stderr, "%s: Can't open %s\n", __FILE__, path );
+            return 0;
+        }
+    }
+    if ( !RingInit( &input->commands, sizeof(struct InputCommand),
+            INPUT_QUEUE_SIZE ) ) {
+        return 0;
+    }
+    if ( pipe( input->wake ) != 0 ) {
+        fprintf( stderr, "%s: pipe failed\n", __FILE__ );
+        RingFree( &input->commands );
+        return 0;
+    }
+    if ( pthread_create( &input->thread, NULL, InputMain, input ) != 0 ) {
+        fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+        close( input->wake[0] );
+        close( input->wake[1] );
+        RingFree( &input->commands );
+        return 0;
+    }
+    input->started = 1;
+    return 1;
+}
+
+void InputStop( struct Input *input )
+{
+    if ( !input->started ) {
+        return;
+    }
+    if ( write( input->wake[1], "", 1 ) != 1 ) {
+        fprintf( stderr, "%s: Can't wake the input thread\n", __FILE__ );
+    }
+    pthread_join( input->thread, NULL );
+    close( input->wake[0] );
+    close( input->wake[1] );
+    if ( input->fd != STDIN_FILENO ) {
+        close( input->fd );
+    }
+    RingFree( &input->commands );
+    input->started = 0;
+}
+
+int InputPoll( struct Input *input, struct InputCommand *command )
+{
+    return input->started && RingPop( &input->commands, command );
+}
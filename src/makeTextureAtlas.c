@@ -1,166 +1,344 @@
+// Packs sprites into a texture atlas with a full mip chain.
+//
+//     makeTextureAtlas [--padding N] --output texture/balls in.png...
+//
+// writes texture/balls.png (level 0), texture/balls-1.png ... down to 1x1,
+// and texture/balls.atlas with the UV rectangle of every sprite.  A sprite is
+// named after its file up to the first '-' or '.', so texture/8-64x64.png is
+// "8".
+//
+// Each sprite gets padding pixels of its own edge extruded around it, and
+// cells start on multiples of 2^(cleanLevels-1) so the box filtered levels
+// never average two sprites together.  Bilinear sampling still reaches one
+// texel into the border, so levels stay free of bleeding while the border is
+// at least a texel wide: log2(padding) + 1 of them.  Pixels are stored with
+// premultiplied alpha, which is what makes averaging them correct.
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <png.h>
 
-png_byte color_type;
-png_byte bit_depth;
+#define ATLAS_MAX_SPRITES 64
+#define ATLAS_NAME_SIZE 32
+#define ATLAS_MAX_SIZE 4096
+#define ATLAS_DEFAULT_PADDING 8
 
-png_bytep * ReadPngTexture(const char * _fileName)
+struct Sprite
+{
+    char name[ ATLAS_NAME_SIZE ];
+    unsigned char *pixels; // RGBA, premultiplied.
+    int width;
+    int height;
+    int x; // Top left of the sprite itself, inside its padding.
+    int y;
+};
+
+unsigned char * ReadPngTexture( const char * _fileName, int *width, int *height )
 {
     FILE * inputFile = fopen( _fileName, "rb" );
     if ( inputFile == NULL ) {
         fprintf( stderr, "%s: Error Loading %s\n", __FILE__, _fileName );
         exit(1);
     }
-    unsigned char sig[8];
-    fread(sig, 1, 8, inputFile);
-    if( !png_check_sig(sig, 8) ) {
-        fprintf( stderr, "%s: Error: %s is not a png file\n", __FILE__, _fileName );
-        exit(1);
-    }
     png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING,0,0,0);
-    if(!png_ptr) {
+    png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+    if ( info_ptr == NULL ) {
         fprintf(stderr, "%s: %s png_create_read_struct\n", __FILE__, _fileName);
         exit(1);
     }
-
-    png_infop info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr) {
-        png_destroy_read_struct(&png_ptr, 0, 0);
-        fprintf(stderr, "%s: %s png_create_info_struct\n", __FILE__, _fileName);
-        exit(1);
-    }
-    if(setjmp(png_ptr->jmpbuf)) {
-        fprintf(stderr, "%s: %s init_io\n", __FILE__, _fileName);
-        png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+    if ( setjmp(png_jmpbuf(png_ptr)) ) {
+        fprintf(stderr, "%s: %s Error reading image\n", __FILE__, _fileName);
         exit(1);
     }
     png_init_io(png_ptr, inputFile);
-    png_set_sig_bytes(png_ptr, 8);
     png_read_info(png_ptr, info_ptr);
 
-    int width = png_get_image_width(png_ptr, info_ptr);
-    int height = png_get_image_height(png_ptr, info_ptr);
-
-    color_type = png_get_color_type(png_ptr, info_ptr);
-    bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-
-    int number_of_passes = png_set_interlace_handling(png_ptr);
+    png_byte color_type = png_get_color_type(png_ptr, info_ptr);
+    if ( color_type == PNG_COLOR_TYPE_PALETTE ) {
+        png_set_palette_to_rgb(png_ptr);
+    }
+    if ( color_type == PNG_COLOR_TYPE_GRAY ||
+            color_type == PNG_COLOR_TYPE_GRAY_ALPHA ) {
+        png_set_expand_gray_1_2_4_to_8(png_ptr);
+        png_set_gray_to_rgb(png_ptr);
+    }
+    if ( png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS) ) {
+        png_set_tRNS_to_alpha(png_ptr);
+    } else if ( !(color_type & PNG_COLOR_MASK_ALPHA) ) {
+        png_set_filler(png_ptr, 0xff, PNG_FILLER_AFTER);
+    }
+    png_set_strip_16(png_ptr);
+    png_set_interlace_handling(png_ptr);
     png_read_update_info(png_ptr, info_ptr);
 
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        fprintf(stderr, "%s: %s Error reading image\n", __FILE__, _fileName);
-        exit(1);
-    }
-    png_bytep * row_pointers = (png_bytep*) malloc(sizeof(png_bytep) * height);
+    *width = png_get_image_width(png_ptr, info_ptr);
+    *height = png_get_image_height(png_ptr, info_ptr);
+    unsigned char *pixels = malloc( 4 * *width * *height );
+    png_bytep *row_pointers = malloc( sizeof(png_bytep) * *height );
     int y;
-    for ( y=0 ; y < height ; ++y ) {
-        row_pointers[y] = (png_byte*) malloc(png_get_rowbytes(png_ptr,info_ptr));
+    for ( y = 0 ; y < *height ; ++y ) {
+        row_pointers[y] = pixels + 4 * *width * y;
     }
-
     png_read_image(png_ptr, row_pointers);
-
+    png_read_end(png_ptr, NULL);
+    png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+    free(row_pointers);
     fclose(inputFile);
-
-    if (png_get_color_type(png_ptr, info_ptr) == PNG_COLOR_TYPE_RGB) {
-        fprintf(stderr, "%s: %s input file is PNG_COLOR_TYPE_RGB but must be PNG_COLOR_TYPE_RGBA (lacks the alpha channel)\n", __FILE__, _fileName);
-        exit(1);
-    }  
-    if (png_get_color_type(png_ptr, info_ptr) != PNG_COLOR_TYPE_RGBA) {
-        fprintf(stderr, "%s: %s color_type of input file must be PNG_COLOR_TYPE_RGBA (%d) (is %d)\n", __FILE__, _fileName, PNG_COLOR_TYPE_RGBA, png_get_color_type(png_ptr, info_ptr));
-        exit(1);
-    }
-
-    return row_pointers;
+    return pixels;
 }
 
-void write_png_file( char *_fileName, png_bytep *row_pointers, int width, int height )
+void WritePngFile( const char *_fileName, const unsigned char *pixels,
+        int width, int height )
 {
-    FILE * inputFile = fopen( _fileName, "wb" );
-    if ( inputFile == NULL ) {
-        fprintf( stderr, "%s: Error Loading %s\n", __FILE__, _fileName );
+    FILE * outputFile = fopen( _fileName, "wb" );
+    if ( outputFile == NULL ) {
+        fprintf( stderr, "%s: Error opening %s\n", __FILE__, _fileName );
         exit(1);
     }
     png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if(!png_ptr) {
-        fprintf(stderr, "%s: %s png_create_read_struct\n", __FILE__, _fileName);
-        exit(1);
-    }
-    png_infop info_ptr = png_create_info_struct(png_ptr);
-    if (!info_ptr) {
-        png_destroy_read_struct(&png_ptr, 0, 0);
-        fprintf(stderr, "%s: %s png_create_info_struct\n", __FILE__, _fileName);
+    png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+    if ( info_ptr == NULL ) {
+        fprintf(stderr, "%s: %s png_create_write_struct\n", __FILE__, _fileName);
         exit(1);
     }
     if ( setjmp(png_jmpbuf(png_ptr)) ) {
-        fprintf(stderr, "%s: %s init_io\n", __FILE__, _fileName);
-        png_destroy_read_struct(&png_ptr, &info_ptr, 0);
-        exit(1);
-    }
-    png_init_io(png_ptr, inputFile);
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        fprintf(stderr, "%s: %s Error during writing bytes", __FILE__, _fileName);
+        fprintf(stderr, "%s: %s Error during writing\n", __FILE__, _fileName);
         exit(1);
     }
-
-    png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, color_type,
+    png_init_io(png_ptr, outputFile);
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGBA,
             PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
             PNG_FILTER_TYPE_BASE);
-
     png_write_info(png_ptr, info_ptr);
+    int y;
+    for ( y = 0 ; y < height ; ++y ) {
+        png_write_row(png_ptr, (png_bytep)pixels + 4 * width * y);
+    }
+    png_write_end(png_ptr, NULL);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(outputFile);
+}
 
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        fprintf(stderr, "%s: %s Error during writing bytes");
-        exit(1);
+static void SpriteName( const char *_fileName, char *name )
+{
+    const char *base = strrchr( _fileName, '/' );
+    base = base ? base + 1 : _fileName;
+    size_t length = strcspn( base, "-." );
+    if ( length >= ATLAS_NAME_SIZE ) {
+        length = ATLAS_NAME_SIZE - 1;
     }
+    memcpy( name, base, length );
+    name[length] = '\0';
+}
 
-    png_write_image(png_ptr, row_pointers);
-    if (setjmp(png_jmpbuf(png_ptr))) {
-        fprintf(stderr, "%s: %s Error during end of write");
-        exit(1);
+static void Premultiply( unsigned char *pixels, int count )
+{
+    int i;
+    for ( i = 0 ; i < count ; ++i, pixels += 4 ) {
+        int a = pixels[3];
+        pixels[0] = ( pixels[0] * a + 127 ) / 255;
+        pixels[1] = ( pixels[1] * a + 127 ) / 255;
+        pixels[2] = ( pixels[2] * a + 127 ) / 255;
     }
+}
 
-    png_write_end(png_ptr, NULL);
+static int AlignUp( int value, int alignment )
+{
+    return ( value + alignment - 1 ) / alignment * alignment;
+}
 
-    fclose(inputFile);
+static int CompareHeight( const void *a, const void *b )
+{
+    const struct Sprite *s1 = *(struct Sprite * const *)a;
+    const struct Sprite *s2 = *(struct Sprite * const *)b;
+    return s2->height - s1->height;
 }
 
-int main(int argc, char **argv)
+// Shelf packing, tallest first.  Fills in x and y and returns whether
+// everything fit in width x height.
+static int Pack( struct Sprite **sorted, int count, int padding, int alignment,
+        int width, int height )
 {
-    png_bytep *textures[16];
-    int i = 0;
-    for ( ; i < 16 ; ++i ) {
-        char str[21];
-        sprintf(str, "texture/resize/%d.png", i);
-        textures[i] = ReadPngTexture(str);
+    int shelfX = 0, shelfY = 0, shelfHeight = 0;
+    int i;
+    for ( i = 0 ; i < count ; ++i ) {
+        struct Sprite *sprite = sorted[i];
+        int cellWidth = AlignUp( sprite->width + 2 * padding, alignment );
+        int cellHeight = AlignUp( sprite->height + 2 * padding, alignment );
+        if ( shelfX + cellWidth > width ) {
+            shelfX = 0;
+            shelfY += shelfHeight;
+            shelfHeight = 0;
+        }
+        if ( cellWidth > width || shelfY + cellHeight > height ) {
+            return 0;
+        }
+        sprite->x = shelfX + padding;
+        sprite->y = shelfY + padding;
+        shelfX += cellWidth;
+        if ( cellHeight > shelfHeight ) {
+            shelfHeight = cellHeight;
+        }
     }
+    return 1;
+}
+
+// Copy a sprite in, clamping coordinates so its edge pixels are repeated
+// across the padding.
+static void Blit( unsigned char *atlas, int atlasWidth,
+        const struct Sprite *sprite, int padding )
+{
     int x, y;
-    png_byte *outputImage[256];
-    for ( i=0 ; i < 256 ; ++i ) {
-        outputImage[i] = malloc(4 * 256 * sizeof(png_byte));
-    }
-    i = 0;
-    for ( ; i < 16 ; ++i) {
-        int startX, startY;
-        startX = (i % 4) * 64;
-        startY = (i / 4) * 64;
-
-        for( y = 0 ; y < 64 ; ++y) {
-            png_byte *row = textures[i][y];
-            for( x = 0 ; x < 64 ; ++x ) {
-                png_byte* ptr = &(row[x*4]);
-                //memcpy(&(outputImage[startY + y][(startX + x) * 4]), row, 4 * sizeof(png_byte));
-                memcpy(&(outputImage[startY + y][(startX + x)*4]), ptr, 4 * sizeof(png_byte));
-                //printf("(%d, %d) (%d, %d, %d, %d)\n", startY + y, (startX + x), outputImage[startY + y][(startX + x) * 4], outputImage[startY + y][((startX + x) * 4) + 1], outputImage[startY + y][((startX + x) * 4) + 2], outputImage[startY + y][((startX + x) * 4) + 3]);
-                //printf("YO: (%d, %d)\n", startY + y, (startX + x) * 4);
+    for ( y = -padding ; y < sprite->height + padding ; ++y ) {
+        int sy = y < 0 ? 0 : y >= sprite->height ? sprite->height - 1 : y;
+        for ( x = -padding ; x < sprite->width + padding ; ++x ) {
+            int sx = x < 0 ? 0 : x >= sprite->width ? sprite->width - 1 : x;
+            memcpy( &atlas[4 * ( (sprite->y + y) * atlasWidth + sprite->x + x )],
+                    &sprite->pixels[4 * ( sy * sprite->width + sx )], 4 );
+        }
+    }
+}
+
+// 2x2 box filter.  Dimensions are powers of two, a side already at 1 stays 1.
+static unsigned char * Downsample( const unsigned char *pixels, int width,
+        int height, int *newWidth, int *newHeight )
+{
+    *newWidth = width > 1 ? width / 2 : 1;
+    *newHeight = height > 1 ? height / 2 : 1;
+    int stepX = width > 1 ? 1 : 0;
+    int stepY = height > 1 ? 1 : 0;
+    unsigned char *result = malloc( 4 * *newWidth * *newHeight );
+    int x, y, c;
+    for ( y = 0 ; y < *newHeight ; ++y ) {
+        const unsigned char *row0 = pixels + 4 * width * ( 2 * y );
+        const unsigned char *row1 = pixels + 4 * width * ( 2 * y + stepY );
+        for ( x = 0 ; x < *newWidth ; ++x ) {
+            int x0 = 4 * ( 2 * x ), x1 = 4 * ( 2 * x + stepX );
+            for ( c = 0 ; c < 4 ; ++c ) {
+                result[4 * ( y * *newWidth + x ) + c] = ( row0[x0 + c] +
+                        row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2 ) / 4;
             }
         }
     }
-    write_png_file("texture/resize/foo.png", outputImage, 256, 256);
-    for ( i = 0 ; i < 256 ; ++i) {
-        free(outputImage[i]);
+    return result;
+}
+
+static void Usage( const char *name )
+{
+    fprintf( stderr, "Usage: %s [--padding N] --output BASE sprite.png...\n",
+            name );
+}
+
+int main( int argc, char **argv )
+{
+    struct Sprite sprites[ ATLAS_MAX_SPRITES ];
+    struct Sprite *sorted[ ATLAS_MAX_SPRITES ];
+    const char *output = NULL;
+    int padding = ATLAS_DEFAULT_PADDING;
+    int count = 0;
+    int i;
+
+    for ( i = 1 ; i < argc ; ++i ) {
+        if ( strcmp( argv[i], "--padding" ) == 0 && i + 1 < argc ) {
+            padding = atoi( argv[++i] );
+        } else if ( strcmp( argv[i], "--output" ) == 0 && i + 1 < argc ) {
+            output = argv[++i];
+        } else if ( argv[i][0] == '-' ) {
+            Usage( argv[0] );
+            return 1;
+        } else if ( count == ATLAS_MAX_SPRITES ) {
+            fprintf( stderr, "%s: More than %d sprites\n", __FILE__,
+                    ATLAS_MAX_SPRITES );
+            return 1;
+        } else {
+            struct Sprite *sprite = &sprites[count];
+            SpriteName( argv[i], sprite->name );
+            sprite->pixels = ReadPngTexture( argv[i], &sprite->width,
+                    &sprite->height );
+            Premultiply( sprite->pixels, sprite->width * sprite->height );
+            sorted[count] = sprite;
+            ++count;
+        }
+    }
+    if ( output == NULL || count == 0 || padding < 1 ) {
+        Usage( argv[0] );
+        return 1;
     }
-    for ( i = 0 ; i < 16 ; ++i ) {
-        free(textures[i]);
+
+    int cleanLevels = 1;
+    while ( ( 2 << ( cleanLevels - 1 ) ) <= padding ) {
+        ++cleanLevels;
+    }
+    int alignment = 1 << ( cleanLevels - 1 );
+
+    // Smallest power of two rectangle, growing the shorter side first.
+    qsort( sorted, count, sizeof(struct Sprite *), CompareHeight );
+    int width = 1, height = 1;
+    while ( !Pack( sorted, count, padding, alignment, width, height ) ) {
+        if ( width > ATLAS_MAX_SIZE ) {
+            fprintf( stderr, "%s: Sprites don't fit in %dx%d\n", __FILE__,
+                    ATLAS_MAX_SIZE, ATLAS_MAX_SIZE );
+            return 1;
+        }
+        if ( width <= height ) {
+            width *= 2;
+        } else {
+            height *= 2;
+        }
+    }
+
+    unsigned char *level = calloc( 4 * width * height, 1 );
+    for ( i = 0 ; i < count ; ++i ) {
+        Blit( level, width, &sprites[i], padding );
+    }
+
+    char fileName[512];
+    snprintf( fileName, sizeof(fileName), "%s.atlas", output );
+    FILE *metadata = fopen( fileName, "w" );
+    if ( metadata == NULL ) {
+        fprintf( stderr, "%s: Error opening %s\n", __FILE__, fileName );
+        return 1;
+    }
+    fprintf( metadata, "# Written by makeTextureAtlas, padding %d\n",
+            padding );
+    fprintf( metadata, "size %d %d\n", width, height );
+    fprintf( metadata, "premultiplied 1\n" );
+    fprintf( metadata, "clean %d\n", cleanLevels );
+
+    int levelWidth = width, levelHeight = height;
+    int levelNumber = 0;
+    for ( ;; ) {
+        if ( levelNumber == 0 ) {
+            snprintf( fileName, sizeof(fileName), "%s.png", output );
+        } else {
+            snprintf( fileName, sizeof(fileName), "%s-%d.png", output,
+                    levelNumber );
+        }
+        WritePngFile( fileName, level, levelWidth, levelHeight );
+        fprintf( metadata, "level %s\n", fileName );
+        if ( levelWidth == 1 && levelHeight == 1 ) {
+            break;
+        }
+        int nextWidth, nextHeight;
+        unsigned char *next = Downsample( level, levelWidth, levelHeight,
+                &nextWidth, &nextHeight );
+        free( level );
+        level = next;
+        levelWidth = nextWidth;
+        levelHeight = nextHeight;
+        ++levelNumber;
+    }
+    free( level );
+
+    // UVs cover the sprite itself; the padding is only there for filtering.
+    for ( i = 0 ; i < count ; ++i ) {
+        const struct Sprite *sprite = &sprites[i];
+        fprintf( metadata, "sprite %s %.6f %.6f %.6f %.6f\n", sprite->name,
+                (float)sprite->x / width, (float)sprite->y / height,
+                (float)( sprite->x + sprite->width ) / width,
+                (float)( sprite->y + sprite->height ) / height );
+        free( sprite->pixels );
     }
+    fclose( metadata );
+    return 0;
 }
@@ -0,0 +1,231 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "mesh.h"
+#include "glesTools.h"
+#include "assets.h"
+
+#define MESH_ALIGN(x) (((x) + 3u) & ~3u)
+
+static int CachePath( const char *_fileName, char *path, size_t size )
+{
+    const char *slash = strrchr( _fileName, '/' );
+    const char *dot = strrchr( _fileName, '.' );
+    size_t length = strlen( _fileName );
+    if ( dot != NULL && ( slash == NULL || dot > slash ) ) {
+        length = dot - _fileName;
+    }
+    int written = snprintf( path, size, "%.*s%s", (int)length, _fileName,
+            MESH_CACHE_SUFFIX );
+    return written > 0 && (size_t)written < size;
+}
+
+static int IsNewer( const struct stat *a, const struct stat *b )
+{
+    if ( a->st_mtim.tv_sec != b->st_mtim.tv_sec ) {
+        return a->st_mtim.tv_sec > b->st_mtim.tv_sec;
+    }
+    return a->st_mtim.tv_nsec > b->st_mtim.tv_nsec;
+}
+
+static int SectionFits( uint32_t offset, uint64_t bytes, size_t mapSize )
+{
+    return ( offset & 3u ) == 0 && offset >= sizeof(struct MeshCacheHeader)
+        && (uint64_t)offset + bytes <= mapSize;
+}
+
+static int MapCache( struct Mesh *mesh, const char *path, int withNormals )
+{
+    int fd = open( path, O_RDONLY );
+    if ( fd < 0 ) {
+        return 0;
+    }
+    struct stat info;
+    if ( fstat( fd, &info ) != 0 ||
+            (size_t)info.st_size < sizeof(struct MeshCacheHeader) ) {
+        close( fd );
+        return 0;
+    }
+    size_t mapSize = info.st_size;
+    void *map = mmap( NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( map == MAP_FAILED ) {
+        return 0;
+    }
+
+    const struct MeshCacheHeader *header = map;
+    int valid = header->magic == MESH_CACHE_MAGIC
+        && header->version == MESH_CACHE_VERSION
+        && header->elementsSize <= 0x7fffffffu
+        && SectionFits( header->verticesOffset,
+                (uint64_t)header->vertexCount * 2 * sizeof(GLfloat), mapSize )
+        && SectionFits( header->elementsOffset,
+                (uint64_t)header->elementsSize * sizeof(GLushort), mapSize )
+        && SectionFits( header->normalsOffset,
+                (uint64_t)header->normalsSize * sizeof(GLfloat), mapSize )
+        && ( !withNormals || header->normalsSize == header->elementsSize );
+    if ( valid ) {
+        // The collision code indexes vertices straight from the elements, so
+        // a truncated or foreign file must not get past here.
+        const GLushort *e = (const GLushort *)
+            ((const char *)map + header->elementsOffset);
+        uint32_t i;
+        for ( i = 0 ; i < header->elementsSize && valid ; ++i ) {
+            valid = e[i] < header->vertexCount;
+        }
+    }
+    if ( !valid ) {
+        fprintf( stderr, "%s: Ignoring invalid mesh cache %s\n", __FILE__,
+                path );
+        munmap( map, mapSize );
+        return 0;
+    }
+
+    mesh->elementsSize = header->elementsSize;
+    mesh->vertexCount = header->vertexCount;
+    mesh->v = (const GLfloat *)((const char *)map + header->verticesOffset);
+    mesh->e = (const GLushort *)((const char *)map + header->elementsOffset);
+    mesh->n = header->normalsSize ?
+        (const GLfloat *)((const char *)map + header->normalsOffset) : NULL;
+    mesh->map = map;
+    mesh->mapSize = mapSize;
+    return 1;
+}
+
+static int WriteSection( FILE *file, const void *data, size_t bytes )
+{
+    static const unsigned char padding[4] = { 0 };
+    size_t pad = MESH_ALIGN( bytes ) - bytes;
+    return fwrite( data, 1, bytes, file ) == bytes &&
+        fwrite( padding, 1, pad, file ) == pad;
+}
+
+static int WriteCache( const char *path, const struct Mesh *mesh,
+        GLuint normalsSize )
+{
+    struct MeshCacheHeader header;
+    header.magic = MESH_CACHE_MAGIC;
+    header.version = MESH_CACHE_VERSION;
+    header.vertexCount = mesh->vertexCount;
+    header.elementsSize = mesh->elementsSize;
+    header.normalsSize = normalsSize;
+    header.verticesOffset = sizeof(header);
+    header.elementsOffset = header.verticesOffset +
+        MESH_ALIGN( mesh->vertexCount * 2 * sizeof(GLfloat) );
+    header.normalsOffset = header.elementsOffset +
+        MESH_ALIGN( mesh->elementsSize * sizeof(GLushort) );
+
+    // Write next to the destination and rename so a reader never maps a
+    // partially written file.
+    char temporary[512];
+    if ( snprintf( temporary, sizeof(temporary), "%s.%ld", path,
+                (long)getpid() ) >= (int)sizeof(temporary) ) {
+        return 0;
+    }
+    FILE *file = fopen( temporary, "wb" );
+    if ( file == NULL ) {
+        return 0;
+    }
+    int ok = fwrite( &header, sizeof(header), 1, file ) == 1
+        && WriteSection( file, mesh->v,
+                mesh->vertexCount * 2 * sizeof(GLfloat) )
+        && WriteSection( file, mesh->e, mesh->elementsSize * sizeof(GLushort) )
+        && WriteSection( file, mesh->n, normalsSize * sizeof(GLfloat) );
+    ok = fclose( file ) == 0 && ok;
+    if ( !ok || rename( temporary, path ) != 0 ) {
+        unlink( temporary );
+        return 0;
+    }
+    return 1;
+}
+
+static int ParseMesh( struct Mesh *mesh, const char *_fileName,
+        int withNormals )
+{
+    GLfloat *vertices;
+    GLushort *elements;
+    GLuint elementsSize = loadObj( _fileName, &vertices, &elements );
+    if ( elementsSize == 0 ) {
+        return 0;
+    }
+    GLuint vertexCount = 0;
+    GLuint i;
+    for ( i = 0 ; i < elementsSize ; ++i ) {
+        if ( elements[i] >= vertexCount ) {
+            vertexCount = elements[i] + 1;
+        }
+    }
+    mesh->elementsSize = elementsSize;
+    mesh->vertexCount = vertexCount;
+    mesh->v = vertices;
+    mesh->e = elements;
+    if ( withNormals ) {
+        mesh->n = ComputeSurfaceNormals( vertices, elements, elementsSize );
+        if ( mesh->n == NULL ) {
+            FreeMesh( mesh );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int LoadMesh( struct Mesh *mesh, const char *_fileName, int withNormals )
+{
+    memset( mesh, 0, sizeof(*mesh) );
+
+    // Embedded models are parsed straight from memory, the cache is only
+    // worth it when they come off the disk.
+    if ( AssetDirectory() == NULL ) {
+        return ParseMesh( mesh, _fileName, withNormals );
+    }
+
+    char sourcePath[512], path[512];
+    if ( !AssetPath( _fileName, sourcePath, sizeof(sourcePath) ) ||
+            !CachePath( sourcePath, path, sizeof(path) ) ) {
+        fprintf( stderr, "%s: Path too long %s\n", __FILE__, _fileName );
+        return 0;
+    }
+
+    // A cache without its .obj is fine, that is how a stripped install
+    // ships.  Otherwise the cache has to be newer than its source.
+    struct stat source, cache;
+    int haveSource = stat( sourcePath, &source ) == 0;
+    int haveCache = stat( path, &cache ) == 0;
+    if ( haveCache && ( !haveSource || !IsNewer( &source, &cache ) ) &&
+            MapCache( mesh, path, withNormals ) ) {
+        return 1;
+    }
+
+    if ( !ParseMesh( mesh, _fileName, withNormals ) ) {
+        return 0;
+    }
+    if ( WriteCache( path, mesh, withNormals ? mesh->elementsSize : 0 ) ) {
+        struct Mesh mapped;
+        memset( &mapped, 0, sizeof(mapped) );
+        if ( MapCache( &mapped, path, withNormals ) ) {
+            FreeMesh( mesh );
+            *mesh = mapped;
+        }
+    } else {
+        // Read only install, keep using the parsed copy.
+        fprintf( stderr, "%s: Could not write mesh cache %s\n", __FILE__,
+                path );
+    }
+    return 1;
+}
+
+void FreeMesh( struct Mesh *mesh )
+{
+    if ( mesh->map != NULL ) {
+        munmap( mesh->map, mesh->mapSize );
+    } else {
+        free( (void *)mesh->v );
+        free( (void *)mesh->e );
+        free( (void *)mesh->n );
+    }
+    memset( mesh, 0, sizeof(*mesh) );
+}
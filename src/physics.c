@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <math.h>
+#include <GLES2/gl2.h>
+#include "glesVMath.h"
+#include "defines.h"
+#include "physics.h"
+
+static void AddContact( struct ContactList *contacts, GLint type, GLint a,
+        GLint b )
+{
+    if ( contacts == NULL ) {
+        return;
+    }
+    if ( contacts->count < CONTACT_LIST_SIZE ) {
+        struct Contact *contact = &contacts->contacts[ contacts->count ];
+        contact->type = type;
+        contact->a = a;
+        contact->b = b;
+    }
+    ++contacts->count;
+}
+
+///
+// How long ago two overlapping, closing balls first touched: the t >= 0 with
+// |d - t dv| = 2 radius, d and dv being b's position and velocity relative to
+// a's.
+//
+static GLfloat TimeSinceImpact( const GLfloat *d, const GLfloat *dv,
+        GLfloat radius )
+{
+    GLfloat a = dv[0]*dv[0] + dv[1]*dv[1];
+    GLfloat b = d[0]*dv[0] + d[1]*dv[1];
+    GLfloat c = d[0]*d[0] + d[1]*d[1] - 4*radius*radius;
+    GLfloat discriminant = b*b - a*c;
+    if ( a <= 0.0f || discriminant < 0.0f ) {
+        return 0.0f;
+    }
+    GLfloat t = ( b + sqrtf( discriminant ) ) / a;
+    return t > 0.0f ? t : 0.0f;
+}
+
+///
+// Every pair that is touching and closing at the start of the step is found
+// first, from the same positions, and then all of them are resolved together
+// by a Jacobi impulse solver: each iteration works out every contact's
+// impulse from the same velocities and applies them at once, split between a
+// ball's contacts so a rack of them can't overshoot.  Nothing depends on the
+// order of the balls, and the work is bounded by BALL_CONTACT_MAX contacts
+// times BALL_SOLVER_ITERATIONS.  A pair on its own is an exact elastic
+// exchange along the line of centres at impact, done in one iteration.
+//
+// Afterwards each ball is moved to where it would be had it left its
+// earliest impact with its new velocity, so overlaps don't linger.
+//
+// BallContacts in physicsReference.c is a double precision copy of this for
+// --accuracy to measure against; keep the two in step.
+//
+GLuint CheckForParticleCollisions ( GLfloat *particleData, GLint ballCount,
+        GLfloat radius, struct ContactList *contacts )
+{
+    struct BallContact found[ BALL_CONTACT_MAX ];
+    GLint touching[ NUM_PARTICLES ];
+    GLfloat rewind[ NUM_PARTICLES ];
+    GLfloat before[ NUM_PARTICLES * 2 ];
+    GLuint count = 0;
+    GLuint c, iteration;
+    int i;
+
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        touching[i] = 0;
+        rewind[i] = 0.0f;
+    }
+    for ( i = 0 ; i < ballCount && count < BALL_CONTACT_MAX ; ++i ) {
+        int j;
+        const GLfloat *point1 = &particleData[i * PARTICLE_SIZE];
+        // Pocketed balls and unused slots.
+        if ( point1[0] == INFINITY )
+            continue;
+        for ( j = i+1 ; j < ballCount && count < BALL_CONTACT_MAX ; ++j ) {
+            const GLfloat *point2 = &particleData[j * PARTICLE_SIZE];
+            GLfloat d[2] = { point2[0] - point1[0], point2[1] - point1[1] };
+            GLfloat dv[2] = { point2[2] - point1[2], point2[3] - point1[3] };
+            // Balls already moving apart are left alone, otherwise a pair
+            // that ends up touching collides again every step.
+            if ( d[0]*d[0] + d[1]*d[1] > 4*radius*radius ||
+                    d[0]*dv[0] + d[1]*dv[1] >= 0.0f ) {
+                continue;
+            }
+            struct BallContact *contact = &found[ count++ ];
+            contact->a = i;
+            contact->b = j;
+            contact->rewind = TimeSinceImpact( d, dv, radius );
+            contact->normal[0] = d[0] - contact->rewind * dv[0];
+            contact->normal[1] = d[1] - contact->rewind * dv[1];
+            GLfloat length = sqrtf( contact->normal[0]*contact->normal[0] +
+                    contact->normal[1]*contact->normal[1] );
+            if ( length > 0.0f ) {
+                contact->normal[0] /= length;
+                contact->normal[1] /= length;
+            } else {
+                contact->normal[0] = 1.0f;
+                contact->normal[1] = 0.0f;
+            }
+            // Elastic: they leave as fast as they came together.
+            contact->target = -( dv[0]*contact->normal[0] +
+                    dv[1]*contact->normal[1] );
+            contact->impulse = 0.0f;
+            ++touching[i];
+            ++touching[j];
+            if ( contact->rewind > rewind[i] ) {
+                rewind[i] = contact->rewind;
+            }
+            if ( contact->rewind > rewind[j] ) {
+                rewind[j] = contact->rewind;
+            }
+            AddContact( contacts, CONTACT_BALL, i, j );
+        }
+    }
+    if ( count == 0 ) {
+        return 0;
+    }
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        before[2*i] = particleData[i * PARTICLE_SIZE + 2];
+        before[2*i + 1] = particleData[i * PARTICLE_SIZE + 3];
+    }
+
+    for ( iteration = 0 ; iteration < BALL_SOLVER_ITERATIONS ; ++iteration ) {
+        GLfloat delta[ BALL_CONTACT_MAX ];
+        GLfloat largest = 0.0f;
+        for ( c = 0 ; c < count ; ++c ) {
+            const struct BallContact *contact = &found[c];
+            const GLfloat *va = &particleData[contact->a * PARTICLE_SIZE + 2];
+            const GLfloat *vb = &particleData[contact->b * PARTICLE_SIZE + 2];
+            GLfloat separating = (vb[0] - va[0]) * contact->normal[0] +
+                                 (vb[1] - va[1]) * contact->normal[1];
+            GLint shared = touching[contact->a] > touching[contact->b] ?
+                touching[contact->a] : touching[contact->b];
+            // Equal masses: an impulse J changes the separating speed by 2J.
+            GLfloat step = 0.5f * ( contact->target - separating ) / shared;
+            // Balls can push but never pull.
+            if ( step < -contact->impulse ) {
+                step = -contact->impulse;
+            }
+            delta[c] = step;
+            if ( fabsf( step ) > largest ) {
+                largest = fabsf( step );
+            }
+        }
+        for ( c = 0 ; c < count ; ++c ) {
+            struct BallContact *contact = &found[c];
+            GLfloat *va = &particleData[contact->a * PARTICLE_SIZE + 2];
+            GLfloat *vb = &particleData[contact->b * PARTICLE_SIZE + 2];
+            contact->impulse += delta[c];
+            va[0] -= delta[c] * contact->normal[0];
+            va[1] -= delta[c] * contact->normal[1];
+            vb[0] += delta[c] * contact->normal[0];
+            vb[1] += delta[c] * contact->normal[1];
+        }
+        if ( largest < BALL_SOLVER_TOLERANCE ) {
+            break;
+        }
+    }
+
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        if ( touching[i] > 0 ) {
+            point[0] += rewind[i] * ( point[2] - before[2*i] );
+            point[1] += rewind[i] * ( point[3] - before[2*i + 1] );
+        }
+    }
+    return count;
+}
+
+// CushionContacts in physicsReference.c is a double precision copy of this;
+// keep the two in step.
+GLuint CheckForBoundaryCollisions( GLfloat *particleData, GLint ballCount,
+        const GLfloat *v, const GLushort *e, GLint elementsSize,
+        const GLfloat *n, struct ContactList *contacts )
+{
+    // boundaryPoints is counter-clockwise starting at the lower left
+    GLuint count = 0;
+    int ball;
+    for( ball = 0 ; ball < ballCount ; ++ball ) {
+        GLfloat *point = &particleData[ball * PARTICLE_SIZE];
+        // A ball at rest can't be heading into a cushion.
+        if ( point[0] == INFINITY || ( point[2] == 0.0f && point[3] == 0.0f ) )
+            continue;
+        unsigned int i;
+        for ( i = 1 ; i < elementsSize ; i+=2 ) {
+            GLfloat v1[2], v2[2], v3[2], v4[2], v5[2];
+            GLfloat point2[2];
+            // TODO: maybe precompute this.
+            v1[0] = v[2*e[i]] - v[2*e[i-1]];
+            v1[1] = v[2*e[i]+1] - v[2*e[i-1]+1];
+            normalize2f(&v1[0]);
+
+            v2[0] = point[0] - v[2*e[i-1]];
+            v2[1] = point[1] - v[2*e[i-1]+1];
+            normalize2f(&v2[0]);
+
+            v3[0] = point[0] - v[2*e[i]];
+            v3[1] = point[1] - v[2*e[i]+1];
+            normalize2f(&v3[0]);
+
+            // point2 is just point1 moved along its velocity a small time step.
+            point2[0] = point[0] + (SMALL_TIME_STEP * point[2]);
+            point2[1] = point[1] + (SMALL_TIME_STEP * point[3]);
+
+            v4[0] = point2[0] - v[2*e[i-1]];
+            v4[1] = point2[1] - v[2*e[i-1]+1];
+
+            v5[0] = point2[0] - v[2*e[i]];
+            v5[1] = point2[1] - v[2*e[i]+1];
+
+            GLfloat result1, result2, result3, result4, result5;
+            UDotV(&result1, &v1[0], &v2[0], 2);
+            result1 = acos(result1);
+
+            scalarU(&v1[0], &v1[0], -1.0f, 2);
+            UDotV(&result2, &v1, &v3, 2);
+            result2 = acos(result2);
+
+            GLfloat normal[2];
+
+            normal[0] = v1[1];
+            normal[1] = -v1[0];
+
+            UDotV(&result3, &point[2], &normal[0], 2);
+            GLfloat size;
+
+            UDotV(&result4, &v4[0], &normal[0], 2);
+            UDotV(&result5, &v5[0], &normal[0], 2);
+
+            distanceSquared(&size, &v[2*e[i]], &v[2*e[i-1]], 2);
+            size = sqrt(size);
+
+            if ( result3 < 0.0f && result1 < HALFPI && result2 < HALFPI ) {
+                if( ((result1 <= -0.14707f * size + 0.21279f && result2 < HALFPI)
+                        || (result2 <= -0.14707f * size + 0.21279f && result1 <
+                        HALFPI)) || result4 < 0.0f || result5 < 0.0f ) {
+                    if(((i - 1) / 2) % 4 == 1) {
+                        // This makes me cringe.
+                        point[0] = INFINITY;
+                        point[1] = INFINITY;
+                        point[2] = 0.0f;
+                        point[3] = 0.0f;
+                        AddContact( contacts, CONTACT_POCKET, ball, -1 );
+                        break;
+                    } else {
+                        reflectAboutNormal2f(&point[2], &point[2], &normal[0]);
+                        AddContact( contacts, CONTACT_CUSHION, ball, -1 );
+                        ++count;
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+int CheckForMovement( const GLfloat *particleData, GLint ballCount )
+{
+    int i;
+    for ( i=0 ; i < ballCount ; ++i ) {
+        const GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        if (fabs(point[2]) > 0.0f || fabs(point[3]) > 0.0f) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+///
+// Distance from point to the nearest collision segment, pockets included.
+//
+static GLfloat CushionDistance( const GLfloat *point, const struct Table *table )
+{
+    const GLfloat *v = table->boundary;
+    const GLushort *e = table->collision.e;
+    GLfloat nearest = INFINITY;
+    GLint i;
+    for ( i = 1 ; i < table->collision.elementsSize ; i += 2 ) {
+        const GLfloat *a = &v[2*e[i-1]];
+        const GLfloat *b = &v[2*e[i]];
+        GLfloat ab[2] = { b[0] - a[0], b[1] - a[1] };
+        GLfloat ap[2] = { point[0] - a[0], point[1] - a[1] };
+        GLfloat length = ab[0]*ab[0] + ab[1]*ab[1];
+        GLfloat t = length > 0.0f ? ( ap[0]*ab[0] + ap[1]*ab[1] ) / length :
+            0.0f;
+        t = t < 0.0f ? 0.0f : t > 1.0f ? 1.0f : t;
+        GLfloat dx = ap[0] - t * ab[0];
+        GLfloat dy = ap[1] - t * ab[1];
+        GLfloat distance = dx*dx + dy*dy;
+        if ( distance < nearest ) {
+            nearest = distance;
+        }
+    }
+    return sqrtf( nearest );
+}
+
+///
+// How many pieces deltaTime needs cutting into.  Only moving balls count:
+// each may cover half the gap to whatever ball or cushion is nearest it per
+// substep, or SUBSTEP_MIN_TRAVEL radii if that's more.  A shot rolling across
+// open cloth takes one; the break, with everything touching, takes several.
+//
+static GLuint CountSubsteps( const GLfloat *particleData,
+        const struct Table *table, float deltaTime )
+{
+    GLfloat radius = table->ballRadius;
+    GLfloat needed = 1.0f;
+    int i, j;
+    for ( i = 0 ; i < table->ballCount ; ++i ) {
+        const GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        if ( point[0] == INFINITY || ( point[2] == 0.0f && point[3] == 0.0f ) )
+            continue;
+        GLfloat travel = sqrtf( point[2]*point[2] + point[3]*point[3] ) *
+            deltaTime;
+        GLfloat gap = CushionDistance( point, table ) - radius;
+        for ( j = 0 ; j < table->ballCount ; ++j ) {
+            const GLfloat *other = &particleData[j * PARTICLE_SIZE];
+            if ( j == i || other[0] == INFINITY )
+                continue;
+            GLfloat dx = other[0] - point[0];
+            GLfloat dy = other[1] - point[1];
+            GLfloat between = sqrtf( dx*dx + dy*dy ) - 2*radius;
+            if ( between < gap ) {
+                gap = between;
+            }
+        }
+        GLfloat allowed = 0.5f * gap;
+        if ( allowed < SUBSTEP_MIN_TRAVEL * radius ) {
+            allowed = SUBSTEP_MIN_TRAVEL * radius;
+        }
+        if ( travel / allowed > needed ) {
+            needed = travel / allowed;
+        }
+    }
+    // Clamped before the cast so a runaway speed can't overflow it.
+    return needed > SUBSTEP_MAX + 1 ? SUBSTEP_MAX + 1 : (GLuint) ceilf( needed );
+}
+
+GLuint UpdatePositions ( GLfloat *particleData, const struct Table *table,
+        float deltaTime, struct ContactList *contacts,
+        struct StepStats *stats )
+{
+    GLuint count = 0;
+    GLuint substeps = CountSubsteps( particleData, table, deltaTime );
+    GLuint substep;
+    if ( substeps > SUBSTEP_MAX ) {
+        substeps = SUBSTEP_MAX;
+        if ( stats != NULL ) {
+            ++stats->capped;
+        }
+    }
+    if ( stats != NULL ) {
+        ++stats->steps;
+        stats->substeps += substeps;
+    }
+    // One substep is exactly the old single step.
+    deltaTime /= substeps;
+    for ( substep = 0 ; substep < substeps ; ++substep ) {
+        count += CheckForParticleCollisions( particleData,
+                table->ballCount, table->ballRadius, contacts );
+        count += CheckForBoundaryCollisions( particleData,
+                table->ballCount, table->boundary, table->collision.e,
+                table->collision.elementsSize, table->collision.n, contacts );
+        int i;
+        for ( i = 0 ; i < table->ballCount ; ++i ) {
+            GLfloat *point = &particleData[i * PARTICLE_SIZE];
+            if ( point[2] == 0.0f && point[3] == 0.0f )
+                continue;
+
+            point[0] += point[2] * deltaTime;
+            point[1] += point[3] * deltaTime;
+
+            GLfloat tmpAccelVec[2];
+            scale(&tmpAccelVec[0], &point[2], POINT_ACCELERATION * deltaTime, 2);
+            UPlusV(&point[2], &point[2], &tmpAccelVec[0], 2);
+            if(fabs(point[2]) < 0.01f) {
+                point[2] = 0.0f;
+            }
+            if(fabs(point[3]) < 0.01f) {
+                point[3] = 0.0f;
+            }
+        }
+    }
+    return count;
+}
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "defines.h"
+#include "physicsReference.h"
+
+int ReferenceTableInit( struct ReferenceTable *reference,
+        const struct Table *table )
+{
+    GLuint i;
+    reference->boundary = malloc( sizeof(double) * 2 *
+            table->collision.vertexCount );
+    if ( reference->boundary == NULL ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        return 0;
+    }
+    for ( i = 0 ; i < 2 * table->collision.vertexCount ; ++i ) {
+        reference->boundary[i] = table->boundary[i];
+    }
+    reference->e = table->collision.e;
+    reference->elementsSize = table->collision.elementsSize;
+    reference->ballCount = table->ballCount;
+    reference->ballRadius = table->ballRadius;
+    return 1;
+}
+
+void ReferenceTableFree( struct ReferenceTable *reference )
+{
+    free( reference->boundary );
+    reference->boundary = NULL;
+}
+
+static void Normalize( double *v )
+{
+    double magnitude = sqrt( v[0]*v[0] + v[1]*v[1] );
+    v[0] /= magnitude;
+    v[1] /= magnitude;
+}
+
+///
+// CheckForParticleCollisions, widened.
+//
+static GLuint BallContacts( double *state, GLint ballCount, double radius )
+{
+    struct
+    {
+        GLint a, b;
+        double normal[2];
+        double target;
+        double impulse;
+    } found[ BALL_CONTACT_MAX ];
+    GLint touching[ NUM_PARTICLES ];
+    double rewind[ NUM_PARTICLES ];
+    double before[ NUM_PARTICLES * 2 ];
+    GLuint count = 0;
+    GLuint c, iteration;
+    int i, j;
+
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        touching[i] = 0;
+        rewind[i] = 0.0;
+    }
+    for ( i = 0 ; i < ballCount && count < BALL_CONTACT_MAX ; ++i ) {
+        const double *point1 = &state[i * PARTICLE_SIZE];
+        if ( point1[0] == INFINITY )
+            continue;
+        for ( j = i+1 ; j < ballCount && count < BALL_CONTACT_MAX ; ++j ) {
+            const double *point2 = &state[j * PARTICLE_SIZE];
+            double d[2] = { point2[0] - point1[0], point2[1] - point1[1] };
+            double dv[2] = { point2[2] - point1[2], point2[3] - point1[3] };
+            if ( d[0]*d[0] + d[1]*d[1] > 4*radius*radius ||
+                    d[0]*dv[0] + d[1]*dv[1] >= 0.0 ) {
+                continue;
+            }
+            // How long ago they first touched.
+            double a = dv[0]*dv[0] + dv[1]*dv[1];
+            double b = d[0]*dv[0] + d[1]*dv[1];
+            double discriminant = b*b -
+                a * ( d[0]*d[0] + d[1]*d[1] - 4*radius*radius );
+            double t = 0.0;
+            if ( a > 0.0 && discriminant >= 0.0 ) {
+                t = ( b + sqrt( discriminant ) ) / a;
+                t = t > 0.0 ? t : 0.0;
+            }
+            c = count++;
+            found[c].a = i;
+            found[c].b = j;
+            found[c].normal[0] = d[0] - t * dv[0];
+            found[c].normal[1] = d[1] - t * dv[1];
+            double length = sqrt( found[c].normal[0]*found[c].normal[0] +
+                    found[c].normal[1]*found[c].normal[1] );
+            if ( length > 0.0 ) {
+                found[c].normal[0] /= length;
+                found[c].normal[1] /= length;
+            } else {
+                found[c].normal[0] = 1.0;
+                found[c].normal[1] = 0.0;
+            }
+            found[c].target = -( dv[0]*found[c].normal[0] +
+                    dv[1]*found[c].normal[1] );
+            found[c].impulse = 0.0;
+            ++touching[i];
+            ++touching[j];
+            rewind[i] = t > rewind[i] ? t : rewind[i];
+            rewind[j] = t > rewind[j] ? t : rewind[j];
+        }
+    }
+    if ( count == 0 ) {
+        return 0;
+    }
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        before[2*i] = state[i * PARTICLE_SIZE + 2];
+        before[2*i + 1] = state[i * PARTICLE_SIZE + 3];
+    }
+
+    for ( iteration = 0 ; iteration < BALL_SOLVER_ITERATIONS ; ++iteration ) {
+        double delta[ BALL_CONTACT_MAX ];
+        double largest = 0.0;
+        for ( c = 0 ; c < count ; ++c ) {
+            const double *va = &state[found[c].a * PARTICLE_SIZE + 2];
+            const double *vb = &state[found[c].b * PARTICLE_SIZE + 2];
+            double separating = (vb[0] - va[0]) * found[c].normal[0] +
+                                (vb[1] - va[1]) * found[c].normal[1];
+            GLint shared = touching[found[c].a] > touching[found[c].b] ?
+                touching[found[c].a] : touching[found[c].b];
+            double step = 0.5 * ( found[c].target - separating ) / shared;
+            if ( step < -found[c].impulse ) {
+                step = -found[c].impulse;
+            }
+            delta[c] = step;
+            largest = fabs( step ) > largest ? fabs( step ) : largest;
+        }
+        for ( c = 0 ; c < count ; ++c ) {
+            double *va = &state[found[c].a * PARTICLE_SIZE + 2];
+            double *vb = &state[found[c].b * PARTICLE_SIZE + 2];
+            found[c].impulse += delta[c];
+            va[0] -= delta[c] * found[c].normal[0];
+            va[1] -= delta[c] * found[c].normal[1];
+            vb[0] += delta[c] * found[c].normal[0];
+            vb[1] += delta[c] * found[c].normal[1];
+        }
+        if ( largest < BALL_SOLVER_TOLERANCE ) {
+            break;
+        }
+    }
+
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        double *point = &state[i * PARTICLE_SIZE];
+        if ( touching[i] > 0 ) {
+            point[0] += rewind[i] * ( point[2] - before[2*i] );
+            point[1] += rewind[i] * ( point[3] - before[2*i + 1] );
+        }
+    }
+    return count;
+}
+
+///
+// CheckForBoundaryCollisions, widened.  The pocket and cushion tests are the
+// float version's, constants and all.
+//
+static GLuint CushionContacts( double *state,
+        const struct ReferenceTable *reference )
+{
+    const double *v = reference->boundary;
+    const GLushort *e = reference->e;
+    GLuint count = 0;
+    int ball;
+    for ( ball = 0 ; ball < reference->ballCount ; ++ball ) {
+        double *point = &state[ball * PARTICLE_SIZE];
+        if ( point[0] == INFINITY || ( point[2] == 0.0 && point[3] == 0.0 ) )
+            continue;
+        GLint i;
+        for ( i = 1 ; i < reference->elementsSize ; i += 2 ) {
+            const double *start = &v[2*e[i-1]];
+            const double *end = &v[2*e[i]];
+            double v1[2] = { end[0] - start[0], end[1] - start[1] };
+            double v2[2] = { point[0] - start[0], point[1] - start[1] };
+            double v3[2] = { point[0] - end[0], point[1] - end[1] };
+            double size = sqrt( v1[0]*v1[0] + v1[1]*v1[1] );
+            Normalize( v1 );
+            Normalize( v2 );
+            Normalize( v3 );
+
+            double point2[2] = { point[0] + SMALL_TIME_STEP * point[2],
+                                 point[1] + SMALL_TIME_STEP * point[3] };
+            double normal[2] = { -v1[1], v1[0] };
+
+            double result1 = acos( v1[0]*v2[0] + v1[1]*v2[1] );
+            double result2 = acos( -v1[0]*v3[0] - v1[1]*v3[1] );
+            double result3 = point[2]*normal[0] + point[3]*normal[1];
+            double result4 = ( point2[0] - start[0] ) * normal[0] +
+                             ( point2[1] - start[1] ) * normal[1];
+            double result5 = ( point2[0] - end[0] ) * normal[0] +
+                             ( point2[1] - end[1] ) * normal[1];
+
+            if ( result3 < 0.0 && result1 < HALFPI && result2 < HALFPI ) {
+                if( ((result1 <= -0.14707 * size + 0.21279 && result2 < HALFPI)
+                        || (result2 <= -0.14707 * size + 0.21279 && result1 <
+                        HALFPI)) || result4 < 0.0 || result5 < 0.0 ) {
+                    if ( ((i - 1) / 2) % 4 == 1 ) {
+                        point[0] = INFINITY;
+                        point[1] = INFINITY;
+                        point[2] = 0.0;
+                        point[3] = 0.0;
+                        break;
+                    } else {
+                        double along = 2.0 * result3;
+                        point[2] -= along * normal[0];
+                        point[3] -= along * normal[1];
+                        ++count;
+                    }
+                }
+            }
+        }
+    }
+    return count;
+}
+
+GLuint ReferenceUpdate( double *state, const struct ReferenceTable *reference )
+{
+    const double step = 1.0 / REFERENCE_RATE;
+    GLuint count = BallContacts( state, reference->ballCount,
+            reference->ballRadius );
+    count += CushionContacts( state, reference );
+    int i;
+    for ( i = 0 ; i < reference->ballCount ; ++i ) {
+        double *point = &state[i * PARTICLE_SIZE];
+        if ( point[2] == 0.0 && point[3] == 0.0 )
+            continue;
+        point[0] += point[2] * step;
+        point[1] += point[3] * step;
+        point[2] += point[2] * POINT_ACCELERATION * step;
+        point[3] += point[3] * POINT_ACCELERATION * step;
+        if ( fabs( point[2] ) < 0.01 ) {
+            point[2] = 0.0;
+        }
+        if ( fabs( point[3] ) < 0.01 ) {
+            point[3] = 0.0;
+        }
+    }
+    return count;
+}
+
+int ReferenceMoving( const double *state,
+        const struct ReferenceTable *reference )
+{
+    int i;
+    for ( i = 0 ; i < reference->ballCount ; ++i ) {
+        const double *point = &state[i * PARTICLE_SIZE];
+        if ( point[2] != 0.0 || point[3] != 0.0 ) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,252 @@
+// esUtil.h's window functions for every PLATFORM but rpi.  The native side
+// is in the backend the Makefile links alongside, see platform.h.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "esUtil.h"
+#include "platform.h"
+
+// One window per process, as with esUtil.c.
+static struct PlatformWindow window;
+static EGLDisplay windowDisplay = EGL_NO_DISPLAY;
+static EGLSurface windowSurface = EGL_NO_SURFACE;
+static EGLContext windowContext = EGL_NO_CONTEXT;
+
+void esInitContext( ESContext *esContext )
+{
+    if ( esContext != NULL ) {
+        memset( esContext, 0, sizeof(ESContext) );
+    }
+}
+
+void esLogMessage( const char *formatStr, ... )
+{
+    va_list params;
+    va_start( params, formatStr );
+    vfprintf( stderr, formatStr, params );
+    va_end( params );
+}
+
+void esRegisterDrawFunc( ESContext *esContext,
+        void (ESCALLBACK *drawFunc)( ESContext * ) )
+{
+    esContext->drawFunc = drawFunc;
+}
+
+void esRegisterUpdateFunc( ESContext *esContext,
+        void (ESCALLBACK *updateFunc)( ESContext *, float ) )
+{
+    esContext->updateFunc = updateFunc;
+}
+
+void esRegisterKeyFunc( ESContext *esContext,
+        void (ESCALLBACK *keyFunc)( ESContext *, unsigned char, int, int ) )
+{
+    esContext->keyFunc = keyFunc;
+}
+
+///
+// An uncompressed TGA's pixels as stored, as esUtil.c loads them.  NULL if
+// the file can't be read.
+//
+char *esLoadTGA( char *fileName, int *width, int *height )
+{
+    unsigned char header[12];
+    unsigned char attributes[6];
+    FILE *f = fopen( fileName, "rb" );
+    if ( f == NULL ) {
+        return NULL;
+    }
+    if ( fread( header, sizeof(header), 1, f ) != 1 ||
+            fread( attributes, sizeof(attributes), 1, f ) != 1 ) {
+        fclose( f );
+        return NULL;
+    }
+    *width = attributes[1] * 256 + attributes[0];
+    *height = attributes[3] * 256 + attributes[2];
+    size_t size = (size_t) ( attributes[4] / 8 ) * *width * *height;
+    char *buffer = malloc( size );
+    if ( buffer == NULL || fread( buffer, 1, size, f ) != size ) {
+        free( buffer );
+        buffer = NULL;
+    }
+    fclose( f );
+    return buffer;
+}
+
+static int HasExtension( const char *extensions, const char *name )
+{
+    size_t length = strlen( name );
+    while ( extensions != NULL && *extensions != '\0' ) {
+        const char *end = strchr( extensions, ' ' );
+        size_t wordLength = end ? (size_t) (end - extensions) :
+            strlen( extensions );
+        if ( wordLength == length && strncmp( extensions, name, length ) == 0 ) {
+            return 1;
+        }
+        extensions = end ? end + 1 : NULL;
+    }
+    return 0;
+}
+
+///
+// Run at exit, after the game's own GL cleanup.  KMS gets the CRTC back the
+// way it was.
+//
+static void CloseWindow( void )
+{
+    eglMakeCurrent( windowDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
+            EGL_NO_CONTEXT );
+    eglDestroyContext( windowDisplay, windowContext );
+    eglDestroySurface( windowDisplay, windowSurface );
+    eglTerminate( windowDisplay );
+    PlatformClose( &window );
+}
+
+///
+// The first config with flags' buffers that can draw into the window (or a
+// pbuffer), and whose visual matches the window's if it has one.
+//
+static int ChooseConfig( EGLDisplay display, GLuint flags, EGLConfig *config )
+{
+    EGLint attribs[] = {
+        EGL_SURFACE_TYPE, window.nativeWindow != NULL ? EGL_WINDOW_BIT :
+            EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_RED_SIZE, 5,
+        EGL_GREEN_SIZE, 6,
+        EGL_BLUE_SIZE, 5,
+        EGL_ALPHA_SIZE, ( flags & ES_WINDOW_ALPHA ) ? 8 : EGL_DONT_CARE,
+        EGL_DEPTH_SIZE, ( flags & ES_WINDOW_DEPTH ) ? 8 : EGL_DONT_CARE,
+        EGL_STENCIL_SIZE, ( flags & ES_WINDOW_STENCIL ) ? 8 : EGL_DONT_CARE,
+        EGL_SAMPLE_BUFFERS, ( flags & ES_WINDOW_MULTISAMPLE ) ? 1 : 0,
+        EGL_NONE
+    };
+    EGLConfig configs[64];
+    EGLint count, i;
+    if ( !eglChooseConfig( display, attribs, configs, 64, &count ) ) {
+        return 0;
+    }
+    for ( i = 0 ; i < count ; ++i ) {
+        EGLint visual = 0;
+        eglGetConfigAttrib( display, configs[i], EGL_NATIVE_VISUAL_ID, &visual );
+        if ( window.visual == 0 || visual == window.visual ) {
+            *config = configs[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+GLboolean esCreateWindow( ESContext *esContext, const char *title,
+        GLint width, GLint height, GLuint flags )
+{
+    EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+    EGLint majorVersion, minorVersion;
+    EGLConfig config;
+
+    if ( esContext == NULL || !PlatformOpen( &window, title, width, height ) ) {
+        return GL_FALSE;
+    }
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = NULL;
+    PFNEGLCREATEPLATFORMWINDOWSURFACEEXTPROC createWindowSurface = NULL;
+    if ( HasExtension( eglQueryString( EGL_NO_DISPLAY, EGL_EXTENSIONS ),
+            "EGL_EXT_platform_base" ) ) {
+        getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress( "eglGetPlatformDisplayEXT" );
+        createWindowSurface = (PFNEGLCREATEPLATFORMWINDOWSURFACEEXTPROC)
+            eglGetProcAddress( "eglCreatePlatformWindowSurfaceEXT" );
+    }
+    if ( getPlatformDisplay == NULL || createWindowSurface == NULL ) {
+        fprintf( stderr, "%s: EGL_EXT_platform_base is missing\n", __FILE__ );
+        PlatformClose( &window );
+        return GL_FALSE;
+    }
+
+    EGLDisplay display = getPlatformDisplay( window.platform,
+            window.nativeDisplay, NULL );
+    if ( display == EGL_NO_DISPLAY ||
+            !eglInitialize( display, &majorVersion, &minorVersion ) ) {
+        fprintf( stderr, "%s: No EGL display (0x%x)\n", __FILE__,
+                eglGetError() );
+        PlatformClose( &window );
+        return GL_FALSE;
+    }
+    eglBindAPI( EGL_OPENGL_ES_API );
+    if ( !ChooseConfig( display, flags, &config ) ) {
+        fprintf( stderr, "%s: No config for the window\n", __FILE__ );
+        eglTerminate( display );
+        PlatformClose( &window );
+        return GL_FALSE;
+    }
+
+    EGLSurface surface;
+    if ( window.nativeWindow != NULL ) {
+        surface = createWindowSurface( display, config, window.nativeWindow,
+                NULL );
+    } else {
+        EGLint pbufferAttribs[] = {
+            EGL_WIDTH, window.width, EGL_HEIGHT, window.height, EGL_NONE
+        };
+        surface = eglCreatePbufferSurface( display, config, pbufferAttribs );
+    }
+    EGLContext context = surface == EGL_NO_SURFACE ? EGL_NO_CONTEXT :
+        eglCreateContext( display, config, EGL_NO_CONTEXT, contextAttribs );
+    if ( context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent( display, surface, surface, context ) ) {
+        fprintf( stderr, "%s: Can't draw into the window (0x%x)\n", __FILE__,
+                eglGetError() );
+        if ( context != EGL_NO_CONTEXT ) {
+            eglDestroyContext( display, context );
+        }
+        if ( surface != EGL_NO_SURFACE ) {
+            eglDestroySurface( display, surface );
+        }
+        eglTerminate( display );
+        PlatformClose( &window );
+        return GL_FALSE;
+    }
+
+    windowDisplay = display;
+    windowSurface = surface;
+    windowContext = context;
+    atexit( CloseWindow );
+
+    esContext->eglDisplay = display;
+    esContext->eglSurface = surface;
+    esContext->eglContext = context;
+    esContext->width = window.width;
+    esContext->height = window.height;
+    return GL_TRUE;
+}
+
+///
+// Update, draw and swap until the window is closed.
+//
+void esMainLoop( ESContext *esContext )
+{
+    struct timespec last, now;
+    clock_gettime( CLOCK_MONOTONIC, &last );
+    while ( PlatformPollEvents( &window, esContext ) ) {
+        clock_gettime( CLOCK_MONOTONIC, &now );
+        float deltaTime = (float) ( now.tv_sec - last.tv_sec ) +
+            (float) ( now.tv_nsec - last.tv_nsec ) * 1e-9f;
+        last = now;
+
+        if ( esContext->updateFunc != NULL ) {
+            esContext->updateFunc( esContext, deltaTime );
+        }
+        if ( esContext->drawFunc != NULL ) {
+            esContext->drawFunc( esContext );
+        }
+        eglSwapBuffers( esContext->eglDisplay, esContext->eglSurface );
+        if ( !PlatformPresent( &window, esContext->eglDisplay,
+                esContext->eglSurface ) ) {
+            break;
+        }
+    }
+}
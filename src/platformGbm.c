@@ -0,0 +1,275 @@
+// PLATFORM=gbm: straight onto a screen through KMS, no display server, the
+// way the Pi build owns the screen through dispmanx.  Uses the first
+// connected output on PLATFORM_DRM_DEVICE (or $BILLIARDS_DRM_DEVICE) at its
+// preferred mode; the size asked for is ignored.  Every swap is page-flipped
+// at the next vblank, so the main loop runs at the display's refresh rate.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include <gbm.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "platform.h"
+
+#define PLATFORM_DRM_DEVICE "/dev/dri/card0"
+
+struct GbmWindow
+{
+    int fd;
+    drmModeModeInfo mode;
+    uint32_t connector;
+    uint32_t crtc;
+    drmModeCrtc *savedCrtc;     // Put back on close.
+    struct gbm_device *device;
+    struct gbm_surface *surface;
+    struct gbm_bo *shown;       // On screen now; released after the next flip.
+    int flipPending;
+};
+
+///
+// A CRTC the connector can drive, preferring the one it is already on.
+//
+static uint32_t FindCrtc( int fd, drmModeRes *resources,
+        drmModeConnector *connector )
+{
+    int i, j;
+    if ( connector->encoder_id != 0 ) {
+        drmModeEncoder *encoder = drmModeGetEncoder( fd, connector->encoder_id );
+        if ( encoder != NULL ) {
+            uint32_t crtc = encoder->crtc_id;
+            drmModeFreeEncoder( encoder );
+            if ( crtc != 0 ) {
+                return crtc;
+            }
+        }
+    }
+    for ( i = 0 ; i < connector->count_encoders ; ++i ) {
+        drmModeEncoder *encoder = drmModeGetEncoder( fd,
+                connector->encoders[i] );
+        if ( encoder == NULL ) {
+            continue;
+        }
+        for ( j = 0 ; j < resources->count_crtcs ; ++j ) {
+            if ( encoder->possible_crtcs & ( 1u << j ) ) {
+                drmModeFreeEncoder( encoder );
+                return resources->crtcs[j];
+            }
+        }
+        drmModeFreeEncoder( encoder );
+    }
+    return 0;
+}
+
+static int FindOutput( struct GbmWindow *gbm )
+{
+    drmModeRes *resources = drmModeGetResources( gbm->fd );
+    int i;
+    if ( resources == NULL ) {
+        return 0;
+    }
+    for ( i = 0 ; i < resources->count_connectors && gbm->crtc == 0 ; ++i ) {
+        drmModeConnector *connector = drmModeGetConnector( gbm->fd,
+                resources->connectors[i] );
+        if ( connector == NULL ) {
+            continue;
+        }
+        if ( connector->connection == DRM_MODE_CONNECTED &&
+                connector->count_modes > 0 ) {
+            int m;
+            gbm->mode = connector->modes[0];
+            for ( m = 0 ; m < connector->count_modes ; ++m ) {
+                if ( connector->modes[m].type & DRM_MODE_TYPE_PREFERRED ) {
+                    gbm->mode = connector->modes[m];
+                    break;
+                }
+            }
+            gbm->connector = connector->connector_id;
+            gbm->crtc = FindCrtc( gbm->fd, resources, connector );
+        }
+        drmModeFreeConnector( connector );
+    }
+    drmModeFreeResources( resources );
+    return gbm->crtc != 0;
+}
+
+int PlatformOpen( struct PlatformWindow *window, const char *title,
+        GLint width, GLint height )
+{
+    (void) title;
+    (void) width;
+    (void) height;
+    const char *path = getenv( "BILLIARDS_DRM_DEVICE" );
+    if ( path == NULL ) {
+        path = PLATFORM_DRM_DEVICE;
+    }
+    struct GbmWindow *gbm = calloc( 1, sizeof(struct GbmWindow) );
+    if ( gbm == NULL ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        return 0;
+    }
+    gbm->fd = open( path, O_RDWR | O_CLOEXEC );
+    if ( gbm->fd < 0 ) {
+        fprintf( stderr, "%s: Can't open %s\n", __FILE__, path );
+        free( gbm );
+        return 0;
+    }
+    if ( !FindOutput( gbm ) ) {
+        fprintf( stderr, "%s: Nothing connected to %s\n", __FILE__, path );
+        close( gbm->fd );
+        free( gbm );
+        return 0;
+    }
+    gbm->savedCrtc = drmModeGetCrtc( gbm->fd, gbm->crtc );
+    gbm->device = gbm_create_device( gbm->fd );
+    if ( gbm->device != NULL ) {
+        gbm->surface = gbm_surface_create( gbm->device, gbm->mode.hdisplay,
+                gbm->mode.vdisplay, GBM_FORMAT_XRGB8888,
+                GBM_BO_USE_SCANOUT | GBM_BO_USE_RENDERING );
+    }
+    if ( gbm->surface == NULL ) {
+        fprintf( stderr, "%s: Can't create a GBM surface on %s\n", __FILE__,
+                path );
+        window->backend = gbm;
+        PlatformClose( window );
+        return 0;
+    }
+
+    window->platform = EGL_PLATFORM_GBM_KHR;
+    window->nativeDisplay = gbm->device;
+    window->nativeWindow = gbm->surface;
+    window->visual = GBM_FORMAT_XRGB8888;
+    window->width = gbm->mode.hdisplay;
+    window->height = gbm->mode.vdisplay;
+    window->backend = gbm;
+    return 1;
+}
+
+static void DestroyFramebuffer( struct gbm_bo *bo, void *data )
+{
+    struct GbmWindow *gbm = data;
+    uint32_t *framebuffer = gbm_bo_get_user_data( bo );
+    if ( framebuffer != NULL ) {
+        drmModeRmFB( gbm->fd, *framebuffer );
+        free( framebuffer );
+    }
+}
+
+///
+// The KMS framebuffer for a buffer object, made the first time GBM hands it
+// out and kept with it after that.
+//
+static int Framebuffer( struct GbmWindow *gbm, struct gbm_bo *bo,
+        uint32_t *id )
+{
+    uint32_t *framebuffer = gbm_bo_get_user_data( bo );
+    if ( framebuffer != NULL ) {
+        *id = *framebuffer;
+        return 1;
+    }
+    framebuffer = malloc( sizeof(uint32_t) );
+    if ( framebuffer == NULL ) {
+        return 0;
+    }
+    if ( drmModeAddFB( gbm->fd, gbm_bo_get_width( bo ),
+            gbm_bo_get_height( bo ), 24, 32, gbm_bo_get_stride( bo ),
+            gbm_bo_get_handle( bo ).u32, framebuffer ) != 0 ) {
+        free( framebuffer );
+        return 0;
+    }
+    gbm_bo_set_user_data( bo, framebuffer, DestroyFramebuffer );
+    *id = *framebuffer;
+    return 1;
+}
+
+static void FlipDone( int fd, unsigned int frame, unsigned int seconds,
+        unsigned int microseconds, void *data )
+{
+    (void) fd;
+    (void) frame;
+    (void) seconds;
+    (void) microseconds;
+    *(int *) data = 0;
+}
+
+int PlatformPresent( struct PlatformWindow *window, EGLDisplay display,
+        EGLSurface surface )
+{
+    struct GbmWindow *gbm = window->backend;
+    drmEventContext events;
+    uint32_t framebuffer;
+    (void) display;
+    (void) surface;
+
+    struct gbm_bo *bo = gbm_surface_lock_front_buffer( gbm->surface );
+    if ( bo == NULL || !Framebuffer( gbm, bo, &framebuffer ) ) {
+        fprintf( stderr, "%s: No framebuffer for the frame\n", __FILE__ );
+        return 0;
+    }
+    if ( gbm->shown == NULL ) {
+        // The first frame sets the mode.
+        if ( drmModeSetCrtc( gbm->fd, gbm->crtc, framebuffer, 0, 0,
+                &gbm->connector, 1, &gbm->mode ) != 0 ) {
+            fprintf( stderr, "%s: drmModeSetCrtc failed\n", __FILE__ );
+            gbm_surface_release_buffer( gbm->surface, bo );
+            return 0;
+        }
+    } else {
+        gbm->flipPending = 1;
+        if ( drmModePageFlip( gbm->fd, gbm->crtc, framebuffer,
+                DRM_MODE_PAGE_FLIP_EVENT, &gbm->flipPending ) != 0 ) {
+            fprintf( stderr, "%s: drmModePageFlip failed\n", __FILE__ );
+            gbm_surface_release_buffer( gbm->surface, bo );
+            return 0;
+        }
+        memset( &events, 0, sizeof(events) );
+        events.version = DRM_EVENT_CONTEXT_VERSION;
+        events.page_flip_handler = FlipDone;
+        while ( gbm->flipPending ) {
+            if ( drmHandleEvent( gbm->fd, &events ) != 0 ) {
+                break;
+            }
+        }
+        gbm_surface_release_buffer( gbm->surface, gbm->shown );
+    }
+    gbm->shown = bo;
+    return 1;
+}
+
+int PlatformPollEvents( struct PlatformWindow *window, ESContext *esContext )
+{
+    // Input comes through input.c (stdin, a FIFO or evdev).
+    (void) window;
+    (void) esContext;
+    return 1;
+}
+
+void PlatformClose( struct PlatformWindow *window )
+{
+    struct GbmWindow *gbm = window->backend;
+    if ( gbm == NULL ) {
+        return;
+    }
+    if ( gbm->savedCrtc != NULL ) {
+        drmModeSetCrtc( gbm->fd, gbm->savedCrtc->crtc_id,
+                gbm->savedCrtc->buffer_id, gbm->savedCrtc->x,
+                gbm->savedCrtc->y, &gbm->connector, 1,
+                &gbm->savedCrtc->mode );
+        drmModeFreeCrtc( gbm->savedCrtc );
+    }
+    if ( gbm->shown != NULL ) {
+        gbm_surface_release_buffer( gbm->surface, gbm->shown );
+    }
+    if ( gbm->surface != NULL ) {
+        gbm_surface_destroy( gbm->surface );
+    }
+    if ( gbm->device != NULL ) {
+        gbm_device_destroy( gbm->device );
+    }
+    close( gbm->fd );
+    free( gbm );
+    window->backend = NULL;
+}
@@ -0,0 +1,47 @@
+// PLATFORM=surfaceless: nothing to show the frames on.  The game draws into
+// a pbuffer of the window's size, so the whole windowed path, swaps
+// included, runs in a container or on CI with Mesa's llvmpipe.  Kill it, or
+// add --capture or --video-out to get the frames.
+#include <stdio.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "platform.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+int PlatformOpen( struct PlatformWindow *window, const char *title,
+        GLint width, GLint height )
+{
+    (void) title;
+    window->platform = EGL_PLATFORM_SURFACELESS_MESA;
+    window->nativeDisplay = EGL_DEFAULT_DISPLAY;
+    window->nativeWindow = NULL;
+    window->visual = 0;
+    window->width = width;
+    window->height = height;
+    window->backend = NULL;
+    return 1;
+}
+
+int PlatformPresent( struct PlatformWindow *window, EGLDisplay display,
+        EGLSurface surface )
+{
+    (void) window;
+    (void) display;
+    (void) surface;
+    return 1;
+}
+
+int PlatformPollEvents( struct PlatformWindow *window, ESContext *esContext )
+{
+    (void) window;
+    (void) esContext;
+    return 1;
+}
+
+void PlatformClose( struct PlatformWindow *window )
+{
+    (void) window;
+}
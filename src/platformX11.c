@@ -0,0 +1,95 @@
+// PLATFORM=x11: a plain window on the X server in $DISPLAY.
+#include <stdio.h>
+#include <stdlib.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "platform.h"
+
+struct X11Window
+{
+    Display *display;
+    Window window;
+    Atom deleteWindow;
+};
+
+int PlatformOpen( struct PlatformWindow *window, const char *title,
+        GLint width, GLint height )
+{
+    struct X11Window *x11 = calloc( 1, sizeof(struct X11Window) );
+    if ( x11 == NULL ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        return 0;
+    }
+    x11->display = XOpenDisplay( NULL );
+    if ( x11->display == NULL ) {
+        fprintf( stderr, "%s: Can't open the X display\n", __FILE__ );
+        free( x11 );
+        return 0;
+    }
+    Window root = DefaultRootWindow( x11->display );
+    XSetWindowAttributes attributes;
+    attributes.event_mask = ExposureMask | KeyPressMask | StructureNotifyMask;
+    x11->window = XCreateWindow( x11->display, root, 0, 0, width, height, 0,
+            CopyFromParent, InputOutput, CopyFromParent, CWEventMask,
+            &attributes );
+    XStoreName( x11->display, x11->window, title );
+    // Closing the window is a message, not a kill.
+    x11->deleteWindow = XInternAtom( x11->display, "WM_DELETE_WINDOW", False );
+    XSetWMProtocols( x11->display, x11->window, &x11->deleteWindow, 1 );
+    XMapWindow( x11->display, x11->window );
+
+    window->platform = EGL_PLATFORM_X11_KHR;
+    window->nativeDisplay = x11->display;
+    // The platform extension takes a pointer to the Window.
+    window->nativeWindow = &x11->window;
+    window->visual = 0;
+    window->width = width;
+    window->height = height;
+    window->backend = x11;
+    return 1;
+}
+
+int PlatformPresent( struct PlatformWindow *window, EGLDisplay display,
+        EGLSurface surface )
+{
+    (void) window;
+    (void) display;
+    (void) surface;
+    return 1;
+}
+
+int PlatformPollEvents( struct PlatformWindow *window, ESContext *esContext )
+{
+    struct X11Window *x11 = window->backend;
+    while ( XPending( x11->display ) ) {
+        XEvent event;
+        XNextEvent( x11->display, &event );
+        if ( event.type == ClientMessage &&
+                (Atom) event.xclient.data.l[0] == x11->deleteWindow ) {
+            return 0;
+        }
+        if ( event.type == KeyPress && esContext->keyFunc != NULL ) {
+            char text;
+            KeySym key;
+            if ( XLookupString( &event.xkey, &text, 1, &key, NULL ) == 1 ) {
+                esContext->keyFunc( esContext, (unsigned char) text,
+                        event.xkey.x, event.xkey.y );
+            }
+        }
+    }
+    return 1;
+}
+
+void PlatformClose( struct PlatformWindow *window )
+{
+    struct X11Window *x11 = window->backend;
+    if ( x11 == NULL ) {
+        return;
+    }
+    XDestroyWindow( x11->display, x11->window );
+    XCloseDisplay( x11->display );
+    free( x11 );
+    window->backend = NULL;
+}
@@ -0,0 +1,240 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <EGL/egl.h>
+#include "esUtil.h"
+#include "programCache.h"
+
+struct ProgramCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t format;
+    uint32_t length;
+    uint64_t sourceHash;
+};
+
+// FNV-1a, chained through hash.  Strings are hashed with their '\0' so
+// "ab" + "c" and "a" + "bc" differ.
+static uint64_t HashString( uint64_t hash, const char *string )
+{
+    const unsigned char *c = (const unsigned char *)string;
+    do {
+        hash ^= *c;
+        hash *= 0x100000001b3ull;
+    } while ( *c++ != '\0' );
+    return hash;
+}
+
+#define HASH_SEED 0xcbf29ce484222325ull
+
+static int HasExtension( const char *name )
+{
+    const char *extensions = (const char *)glGetString( GL_EXTENSIONS );
+    size_t length = strlen( name );
+    const char *found = extensions;
+    while ( found != NULL && ( found = strstr( found, name ) ) != NULL ) {
+        if ( ( found == extensions || found[-1] == ' ' ) &&
+                ( found[length] == ' ' || found[length] == '\0' ) ) {
+            return 1;
+        }
+        found += length;
+    }
+    return 0;
+}
+
+static int MakeDirectory( const char *path )
+{
+    return mkdir( path, 0755 ) == 0 || errno == EEXIST;
+}
+
+// Drop binaries left behind by a different driver, they can never load.
+static void PruneCache( struct ProgramCache *cache )
+{
+    char prefix[32];
+    snprintf( prefix, sizeof(prefix), "%016llx-",
+            (unsigned long long)cache->driverHash );
+    DIR *directory = opendir( cache->directory );
+    if ( directory == NULL ) {
+        return;
+    }
+    struct dirent *entry;
+    while ( ( entry = readdir( directory ) ) != NULL ) {
+        size_t length = strlen( entry->d_name );
+        if ( length < 4 || strcmp( entry->d_name + length - 4, ".bin" ) != 0 ||
+                strncmp( entry->d_name, prefix, strlen( prefix ) ) == 0 ) {
+            continue;
+        }
+        char path[ sizeof(cache->directory) + 256 ];
+        snprintf( path, sizeof(path), "%s/%s", cache->directory,
+                entry->d_name );
+        unlink( path );
+    }
+    closedir( directory );
+}
+
+///
+// Check for GL_OES_get_program_binary, find the cache directory under
+// $XDG_CACHE_HOME (or ~/.cache) and fingerprint the driver.
+//
+void ProgramCacheInit( struct ProgramCache *cache )
+{
+    memset( cache, 0, sizeof(*cache) );
+
+    GLint formats = 0;
+    if ( HasExtension( "GL_OES_get_program_binary" ) ) {
+        glGetIntegerv( GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formats );
+    }
+    if ( formats <= 0 ) {
+        return;
+    }
+    cache->getProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)
+        eglGetProcAddress( "glGetProgramBinaryOES" );
+    cache->programBinary = (PFNGLPROGRAMBINARYOESPROC)
+        eglGetProcAddress( "glProgramBinaryOES" );
+    if ( cache->getProgramBinary == NULL || cache->programBinary == NULL ) {
+        return;
+    }
+
+    // A path too long for directory turns the cache off rather than putting
+    // it somewhere else.
+    const char *base = getenv( "XDG_CACHE_HOME" );
+    char parent[ sizeof(cache->directory) ];
+    int written;
+    if ( base != NULL && base[0] != '\0' ) {
+        written = snprintf( parent, sizeof(parent), "%s", base );
+    } else if ( ( base = getenv( "HOME" ) ) != NULL ) {
+        written = snprintf( parent, sizeof(parent), "%s/.cache", base );
+    } else {
+        return;
+    }
+    if ( written <= 0 || (size_t)written >= sizeof(parent) ) {
+        return;
+    }
+    written = snprintf( cache->directory, sizeof(cache->directory),
+            "%s/billiards", parent );
+    if ( written <= 0 || (size_t)written >= sizeof(cache->directory) ) {
+        cache->directory[0] = '\0';
+        return;
+    }
+    if ( !MakeDirectory( parent ) || !MakeDirectory( cache->directory ) ) {
+        return;
+    }
+
+    uint64_t hash = HASH_SEED;
+    hash = HashString( hash, (const char *)glGetString( GL_VENDOR ) );
+    hash = HashString( hash, (const char *)glGetString( GL_RENDERER ) );
+    hash = HashString( hash, (const char *)glGetString( GL_VERSION ) );
+    cache->driverHash = hash;
+    cache->enabled = 1;
+    PruneCache( cache );
+}
+
+static GLuint LoadBinary( struct ProgramCache *cache, const char *path,
+        uint64_t sourceHash )
+{
+    FILE *file = fopen( path, "rb" );
+    if ( file == NULL ) {
+        return 0;
+    }
+    struct ProgramCacheHeader header;
+    void *binary = NULL;
+    GLuint program = 0;
+    if ( fread( &header, sizeof(header), 1, file ) == 1 &&
+            header.magic == PROGRAM_CACHE_MAGIC &&
+            header.version == PROGRAM_CACHE_VERSION &&
+            header.sourceHash == sourceHash &&
+            ( binary = malloc( header.length ) ) != NULL &&
+            fread( binary, 1, header.length, file ) == header.length ) {
+        program = glCreateProgram();
+        cache->programBinary( program, header.format, binary, header.length );
+        GLint linked = 0;
+        glGetProgramiv( program, GL_LINK_STATUS, &linked );
+        if ( !linked ) {
+            glDeleteProgram( program );
+            program = 0;
+        }
+    }
+    free( binary );
+    fclose( file );
+    if ( program == 0 ) {
+        // Corrupt, or the driver refused it.  Compile and overwrite.
+        unlink( path );
+    }
+    return program;
+}
+
+static void SaveBinary( struct ProgramCache *cache, const char *path,
+        GLuint program, uint64_t sourceHash )
+{
+    GLint length = 0;
+    glGetProgramiv( program, GL_PROGRAM_BINARY_LENGTH_OES, &length );
+    if ( length <= 0 ) {
+        return;
+    }
+    void *binary = malloc( length );
+    if ( binary == NULL ) {
+        return;
+    }
+    struct ProgramCacheHeader header;
+    GLenum format;
+    GLsizei written = 0;
+    cache->getProgramBinary( program, length, &written, &format, binary );
+
+    header.magic = PROGRAM_CACHE_MAGIC;
+    header.version = PROGRAM_CACHE_VERSION;
+    header.format = format;
+    header.length = written;
+    header.sourceHash = sourceHash;
+
+    // Write and rename so a crash never leaves half a binary under the real
+    // name.
+    char temporary[ sizeof(cache->directory) + 64 ];
+    snprintf( temporary, sizeof(temporary), "%s.%ld", path, (long)getpid() );
+    FILE *file = fopen( temporary, "wb" );
+    if ( file != NULL ) {
+        int ok = written > 0 &&
+            fwrite( &header, sizeof(header), 1, file ) == 1 &&
+            fwrite( binary, 1, written, file ) == (size_t)written;
+        ok = fclose( file ) == 0 && ok;
+        if ( !ok || rename( temporary, path ) != 0 ) {
+            unlink( temporary );
+        }
+    }
+    free( binary );
+}
+
+///
+// Drop-in for esLoadProgram.  Loads the cached binary for these sources if
+// the driver still accepts it, otherwise compiles and stores the result.
+//
+GLuint ProgramCacheLoad( struct ProgramCache *cache, const char *vertexSource,
+        const char *fragmentSource )
+{
+    if ( !cache->enabled ) {
+        return esLoadProgram( vertexSource, fragmentSource );
+    }
+
+    uint64_t sourceHash = HashString( HashString( HASH_SEED, vertexSource ),
+            fragmentSource );
+    char path[ sizeof(cache->directory) + 64 ];
+    snprintf( path, sizeof(path), "%s/%016llx-%016llx.bin", cache->directory,
+            (unsigned long long)cache->driverHash,
+            (unsigned long long)sourceHash );
+
+    GLuint program = LoadBinary( cache, path, sourceHash );
+    if ( program != 0 ) {
+        ++cache->hits;
+        return program;
+    }
+    ++cache->misses;
+    program = esLoadProgram( vertexSource, fragmentSource );
+    if ( program != 0 ) {
+        SaveBinary( cache, path, program, sourceHash );
+    }
+    return program;
+}
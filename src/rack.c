@@ -0,0 +1,106 @@
+#include <stdlib.h>
+#include <math.h>
+#include "rack.h"
+
+///
+// The 16 ball triangle of eight-ball, spots in the order the table
+// description lists them.
+//
+static void RackEightBall( GLint *ballOrder, unsigned int seed )
+{
+    GLint i;
+    const GLint count = 16;
+    // 8 ball needs to go in position 5.  A stipe and solid must compose the
+    // back corners.
+    GLint stripeBallPos = count - 1;
+    GLint solidBallPos = count - 1;
+    int eightBallPos = count - 1;
+    // shuffle
+    for( i = 1 ; i < count-1 ; ++i ) {
+        int j = i + rand_r( &seed ) / (RAND_MAX / (count - i) + 1);
+        int t = ballOrder[j];
+        if( ballOrder[j] == 8 ) {
+            eightBallPos = i;
+        }
+        if ( ballOrder[j] > 8 && i != 5 ) {
+            stripeBallPos = i;
+        }
+        if ( ballOrder[j] < 8 && i != 5 ) {
+            solidBallPos = i;
+        }
+        ballOrder[j] = ballOrder[i];
+        ballOrder[i] = t;
+    }
+
+    // This is where the 8 ball must go.
+    int t = ballOrder[5];
+    ballOrder[5] = ballOrder[eightBallPos];
+    ballOrder[eightBallPos] = t;
+
+    if ( ballOrder[11] < 8 && ballOrder[15] < 8 ) {
+        t = ballOrder[11];
+        ballOrder[11] = ballOrder[stripeBallPos];
+        ballOrder[stripeBallPos] = t;
+    } else if ( ballOrder[11] > 8 && ballOrder[15] > 8 ) {
+        t = ballOrder[11];
+        ballOrder[11] = ballOrder[solidBallPos];
+        ballOrder[solidBallPos] = t;
+    }
+}
+
+static void RackShuffleKeeping( GLint *ballOrder, GLint count, GLuint keep,
+        unsigned int seed )
+{
+    GLint spots[ NUM_PARTICLES ];
+    GLint spotCount = 0;
+    GLint i;
+    for ( i = 1 ; i < count ; ++i ) {
+        if ( !( keep & 1u << i ) ) {
+            spots[ spotCount++ ] = i;
+        }
+    }
+    for ( i = 0 ; i < spotCount - 1 ; ++i ) {
+        int j = i + rand_r( &seed ) / (RAND_MAX / (spotCount - i) + 1);
+        int t = ballOrder[ spots[j] ];
+        ballOrder[ spots[j] ] = ballOrder[ spots[i] ];
+        ballOrder[ spots[i] ] = t;
+    }
+}
+
+void RackShuffle( const struct TableSpec *spec, GLint *ballOrder,
+        unsigned int seed )
+{
+    GLint i;
+    for( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        ballOrder[i] = i;
+    }
+    switch ( spec->rack ) {
+        case RACK_EIGHT_BALL:
+            RackEightBall( ballOrder, seed );
+            break;
+        case RACK_SHUFFLE:
+            RackShuffleKeeping( ballOrder, spec->ballCount, spec->keep, seed );
+            break;
+        default:
+            break;
+    }
+}
+
+void RackPositions( const struct TableSpec *spec, GLfloat *particleData )
+{
+    GLint i;
+    for ( i = 0; i < NUM_PARTICLES; i++ )
+    {
+        GLfloat *ptr = &particleData[i * PARTICLE_SIZE];
+        if ( i < spec->ballCount ) {
+            ptr[0] = spec->balls[i].spot[0];
+            ptr[1] = spec->balls[i].spot[1];
+        } else {
+            ptr[0] = INFINITY;
+            ptr[1] = INFINITY;
+        }
+        // Velocities
+        ptr[2] = 0.0f;
+        ptr[3] = 0.0f;
+    }
+}
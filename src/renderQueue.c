@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "renderQueue.h"
+
+void RenderQueueReset( struct RenderQueue *queue )
+{
+    queue->count = 0;
+}
+
+struct RenderItem *RenderQueueAdd( struct RenderQueue *queue )
+{
+    if ( queue->count >= RENDER_QUEUE_MAX ) {
+        fprintf( stderr, "%s: More than %d items\n", __FILE__,
+                RENDER_QUEUE_MAX );
+        return NULL;
+    }
+    struct RenderItem *item = &queue->items[ queue->count ];
+    memset( item, 0, sizeof(*item) );
+    item->order = queue->count++;
+    return item;
+}
+
+static int CompareState( const struct RenderItem *a,
+        const struct RenderItem *b )
+{
+    if ( a->program != b->program ) {
+        return a->program < b->program ? -1 : 1;
+    }
+    if ( a->texture != b->texture ) {
+        return a->texture < b->texture ? -1 : 1;
+    }
+    if ( a->blend != b->blend ) {
+        return a->blend < b->blend ? -1 : 1;
+    }
+    // Keep submission order, which blending can depend on.
+    return a->order < b->order ? -1 : ( a->order > b->order );
+}
+
+///
+// Opaque before blended.  Opaque nearest first, blended furthest first,
+// then by state.
+//
+static int CompareItems( const void *left, const void *right )
+{
+    const struct RenderItem *a = left;
+    const struct RenderItem *b = right;
+    int aOpaque = a->blend == RENDER_BLEND_OPAQUE;
+    int bOpaque = b->blend == RENDER_BLEND_OPAQUE;
+    if ( aOpaque != bOpaque ) {
+        return aOpaque ? -1 : 1;
+    }
+    if ( a->layer != b->layer ) {
+        return ( a->layer > b->layer ) == aOpaque ? -1 : 1;
+    }
+    return CompareState( a, b );
+}
+
+static void SetBlend( struct RenderQueue *queue, int blend )
+{
+    if ( blend == queue->blend ) {
+        return;
+    }
+    if ( queue->blend == RENDER_BLEND_OPAQUE ) {
+        // Into the blended pass, which tests depth but leaves it alone.
+        glEnable( GL_BLEND );
+        glDepthMask( GL_FALSE );
+    }
+    switch ( blend ) {
+        case RENDER_BLEND_ALPHA:
+            glBlendFunc( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA );
+            break;
+        case RENDER_BLEND_PREMULTIPLIED:
+            glBlendFunc( GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+            break;
+        case RENDER_BLEND_ADDITIVE:
+            glBlendFunc( GL_SRC_ALPHA, GL_ONE );
+            break;
+    }
+    queue->blend = blend;
+}
+
+void RenderQueueRun( struct RenderQueue *queue )
+{
+    GLuint i;
+
+    qsort( queue->items, queue->count, sizeof(struct RenderItem),
+            CompareItems );
+
+    // Whatever was drawn before may have left anything bound.
+    glEnable( GL_DEPTH_TEST );
+    glDepthFunc( GL_LESS );
+    glDepthMask( GL_TRUE );
+    glDisable( GL_BLEND );
+    glEnable( GL_POLYGON_OFFSET_FILL );
+    glPolygonOffset( 0.0f, 0.0f );
+    glActiveTexture( GL_TEXTURE0 );
+    queue->program = 0;
+    queue->texture = 0;
+    queue->blend = RENDER_BLEND_OPAQUE;
+    queue->layer = 0;
+
+    for ( i = 0 ; i < queue->count ; ++i ) {
+        const struct RenderItem *item = &queue->items[i];
+        SetBlend( queue, item->blend );
+        if ( item->program != queue->program ) {
+            glUseProgram( item->program );
+            queue->program = item->program;
+        }
+        if ( item->texture != 0 && item->texture != queue->texture ) {
+            glBindTexture( GL_TEXTURE_2D, item->texture );
+            queue->texture = item->texture;
+        }
+        if ( item->layer != queue->layer ) {
+            // Units are the smallest depth step the buffer resolves.
+            glPolygonOffset( 0.0f, (GLfloat) -item->layer );
+            queue->layer = item->layer;
+        }
+        item->draw( item->context, item );
+    }
+
+    glDisable( GL_POLYGON_OFFSET_FILL );
+    glDisable( GL_BLEND );
+    glDepthMask( GL_TRUE );
+    glDisable( GL_DEPTH_TEST );
+    queue->count = 0;
+}
@@ -0,0 +1,51 @@
+#include <math.h>
+#include <string.h>
+#include "renderScale.h"
+
+void RenderScaleInit( struct RenderScale *renderScale, GLfloat scale,
+        double budget )
+{
+    memset( renderScale, 0, sizeof(*renderScale) );
+    renderScale->automatic = scale <= 0.0f;
+    renderScale->scale = renderScale->automatic ? RENDER_SCALE_MAX : scale;
+    renderScale->budget = budget;
+}
+
+int RenderScaleUpdate( struct RenderScale *renderScale, double busy )
+{
+    if ( !renderScale->automatic ) {
+        return 0;
+    }
+    renderScale->busyTotal += busy;
+    if ( ++renderScale->samples < RENDER_SCALE_PERIOD ) {
+        return 0;
+    }
+    double load = renderScale->busyTotal / renderScale->samples /
+        renderScale->budget;
+    renderScale->busyTotal = 0.0;
+    renderScale->samples = 0;
+    if ( load < RENDER_SCALE_HIGH && load > RENDER_SCALE_LOW ) {
+        return 0;
+    }
+
+    // Pixels go with the square of the scale, so move it by the square root
+    // of the load we want over the load we have.
+    GLfloat scale = renderScale->scale *
+        (GLfloat) sqrt( RENDER_SCALE_TARGET / load );
+    if ( scale > renderScale->scale + RENDER_SCALE_STEP ) {
+        scale = renderScale->scale + RENDER_SCALE_STEP;
+    } else if ( scale < renderScale->scale - RENDER_SCALE_STEP ) {
+        scale = renderScale->scale - RENDER_SCALE_STEP;
+    }
+    if ( scale > RENDER_SCALE_MAX ) {
+        scale = RENDER_SCALE_MAX;
+    } else if ( scale < RENDER_SCALE_MIN ) {
+        scale = RENDER_SCALE_MIN;
+    }
+    if ( scale == renderScale->scale ) {
+        return 0;
+    }
+    renderScale->scale = scale;
+    ++renderScale->changes;
+    return 1;
+}
@@ -0,0 +1,601 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "replay.h"
+
+#define REPLAY_DELTA_ESCAPE 31
+
+// ============Recording============ //
+
+static int Reserve( struct ReplayRecorder *recorder, size_t size )
+{
+    if ( recorder->failed ) {
+        return 0;
+    }
+    if ( recorder->recordsSize + size <= recorder->recordsCapacity ) {
+        return 1;
+    }
+    size_t capacity = recorder->recordsCapacity ?
+        recorder->recordsCapacity * 2 : 4096;
+    while ( capacity < recorder->recordsSize + size ) {
+        capacity *= 2;
+    }
+    unsigned char *records = realloc( recorder->records, capacity );
+    if ( records == NULL ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        recorder->failed = 1;
+        return 0;
+    }
+    recorder->records = records;
+    recorder->recordsCapacity = capacity;
+    return 1;
+}
+
+static void PutByte( struct ReplayRecorder *recorder, unsigned char byte )
+{
+    if ( Reserve( recorder, 1 ) ) {
+        recorder->records[ recorder->recordsSize++ ] = byte;
+    }
+}
+
+static void PutVarint( struct ReplayRecorder *recorder, uint32_t value )
+{
+    while ( value >= 0x80 ) {
+        PutByte( recorder, (unsigned char) ( value | 0x80 ) );
+        value >>= 7;
+    }
+    PutByte( recorder, (unsigned char) value );
+}
+
+static void PutBytes( struct ReplayRecorder *recorder, const void *bytes,
+        size_t size )
+{
+    if ( Reserve( recorder, size ) ) {
+        memcpy( recorder->records + recorder->recordsSize, bytes, size );
+        recorder->recordsSize += size;
+    }
+}
+
+static void PutFloat( struct ReplayRecorder *recorder, GLfloat value )
+{
+    PutBytes( recorder, &value, sizeof(value) );
+}
+
+static void PutTag( struct ReplayRecorder *recorder, GLint type )
+{
+    GLuint delta = recorder->tick - recorder->lastRecordTick;
+    recorder->lastRecordTick = recorder->tick;
+    if ( delta < REPLAY_DELTA_ESCAPE ) {
+        PutByte( recorder, (unsigned char) ( type | delta << 3 ) );
+    } else {
+        PutByte( recorder, (unsigned char) ( type |
+                    REPLAY_DELTA_ESCAPE << 3 ) );
+        PutVarint( recorder, delta - REPLAY_DELTA_ESCAPE );
+    }
+}
+
+static void PutKeyframe( struct ReplayRecorder *recorder )
+{
+    const GLfloat *particleData = recorder->particleData;
+    uint32_t onTable = 0;
+    uint32_t moving = 0;
+    GLint i;
+
+    if ( recorder->indexCount == recorder->indexCapacity ) {
+        GLuint capacity = recorder->indexCapacity ?
+            recorder->indexCapacity * 2 : 64;
+        struct ReplayIndexEntry *index = realloc( recorder->index,
+                capacity * sizeof(*index) );
+        if ( index == NULL ) {
+            fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+            recorder->failed = 1;
+            return;
+        }
+        recorder->index = index;
+        recorder->indexCapacity = capacity;
+    }
+    struct ReplayIndexEntry *entry = &recorder->index[ recorder->indexCount++ ];
+    entry->tick = recorder->tick;
+    entry->offset = recorder->recordsSize;
+    entry->shot = recorder->shots;
+
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        const GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        if ( point[0] != INFINITY ) {
+            onTable |= 1u << i;
+        }
+        if ( point[2] != 0.0f || point[3] != 0.0f ) {
+            moving |= 1u << i;
+        }
+    }
+    PutTag( recorder, REPLAY_KEYFRAME );
+    PutBytes( recorder, &onTable, sizeof(onTable) );
+    PutBytes( recorder, &moving, sizeof(moving) );
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        if ( onTable & 1u << i ) {
+            PutFloat( recorder, particleData[i * PARTICLE_SIZE] );
+            PutFloat( recorder, particleData[i * PARTICLE_SIZE + 1] );
+        }
+        if ( moving & 1u << i ) {
+            PutFloat( recorder, particleData[i * PARTICLE_SIZE + 2] );
+            PutFloat( recorder, particleData[i * PARTICLE_SIZE + 3] );
+        }
+    }
+    recorder->sinceKeyframe = 0;
+}
+
+static void PutContacts( struct ReplayRecorder *recorder,
+        const struct ContactList *contacts )
+{
+    GLuint count = contacts->count < CONTACT_LIST_SIZE ? contacts->count :
+        CONTACT_LIST_SIZE;
+    GLuint i;
+    for ( i = 0 ; i < count ; ++i ) {
+        const struct Contact *contact = &contacts->contacts[i];
+        switch ( contact->type ) {
+            case CONTACT_BALL:
+                PutTag( recorder, REPLAY_BALL );
+                PutByte( recorder, contact->a );
+                PutByte( recorder, contact->b );
+                break;
+            case CONTACT_CUSHION:
+                PutTag( recorder, REPLAY_CUSHION );
+                PutByte( recorder, contact->a );
+                break;
+            case CONTACT_POCKET:
+                PutTag( recorder, REPLAY_POCKET );
+                PutByte( recorder, contact->a );
+                break;
+        }
+    }
+}
+
+///
+// Apply a command the way the sim thread did and run the table to rest.
+//
+static void RecordCommand( struct ReplayRecorder *recorder,
+        const struct SimCommand *command )
+{
+    const float step = (float) ( 1.0 / SIM_RATE );
+    if ( command->type == SIM_COMMAND_SHOOT ) {
+        PutKeyframe( recorder );
+    }
+    PutTag( recorder, command->type == SIM_COMMAND_SHOOT ? REPLAY_SHOOT :
+            REPLAY_PLACE );
+    PutByte( recorder, command->ball );
+    PutFloat( recorder, command->value[0] );
+    PutFloat( recorder, command->value[1] );
+    SimApplyCommand( recorder->particleData, command );
+
+    while ( CheckForMovement( recorder->particleData,
+                recorder->table->ballCount ) ) {
+        struct ContactList contacts;
+        contacts.count = 0;
+        UpdatePositions( recorder->particleData, recorder->table, step,
+                &contacts, NULL );
+        ++recorder->tick;
+        PutContacts( recorder, &contacts );
+        if ( ++recorder->sinceKeyframe >= REPLAY_KEYFRAME_TICKS &&
+                CheckForMovement( recorder->particleData,
+                    recorder->table->ballCount ) ) {
+            PutKeyframe( recorder );
+        }
+    }
+    if ( command->type == SIM_COMMAND_SHOOT ) {
+        ++recorder->shots;
+    }
+}
+
+static void * ReplayRecorderMain( void *arg )
+{
+    struct ReplayRecorder *recorder = arg;
+    struct SimCommand command;
+    for ( ;; ) {
+        int stopping = !atomic_load_explicit( &recorder->running,
+                memory_order_acquire );
+        while ( RingPop( &recorder->commands, &command ) ) {
+            RecordCommand( recorder, &command );
+        }
+        if ( stopping ) {
+            return NULL;
+        }
+        struct timespec sleep = { 0, 5000000 };
+        nanosleep( &sleep, NULL );
+    }
+}
+
+int ReplayRecorderStart( struct ReplayRecorder *recorder, const char *path,
+        const char *tablePath, const char *tableName, const struct Table *table,
+        const GLfloat *particleData, uint32_t rackSeed )
+{
+    memset( recorder, 0, sizeof(*recorder) );
+    if ( strlen( tablePath ) >= REPLAY_TABLE_SIZE ) {
+        fprintf( stderr, "%s: Table path too long %s\n", __FILE__, tablePath );
+        return 0;
+    }
+    if ( strlen( tableName ) >= REPLAY_TABLE_SIZE ) {
+        fprintf( stderr, "%s: Table name too long %s\n", __FILE__, tableName );
+        return 0;
+    }
+    recorder->path = path;
+    recorder->tablePath = tablePath;
+    recorder->tableName = tableName;
+    recorder->table = table;
+    recorder->rackSeed = rackSeed;
+    memcpy( recorder->particleData, particleData,
+            sizeof(recorder->particleData) );
+    PutKeyframe( recorder );
+
+    if ( !RingInit( &recorder->commands, sizeof(struct SimCommand),
+            REPLAY_COMMAND_QUEUE ) ) {
+        return 0;
+    }
+    atomic_init( &recorder->running, 1 );
+    if ( pthread_create( &recorder->thread, NULL, ReplayRecorderMain,
+            recorder ) != 0 ) {
+        fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+        RingFree( &recorder->commands );
+        return 0;
+    }
+    recorder->started = 1;
+    return 1;
+}
+
+void ReplayRecord( struct ReplayRecorder *recorder,
+        const struct SimCommand *command )
+{
+    if ( recorder->dropping ) {
+        return;
+    }
+    if ( !RingPush( &recorder->commands, command ) ) {
+        fprintf( stderr, "%s: Recorder queue full, stopping the replay "
+                "here\n", __FILE__ );
+        recorder->dropping = 1;
+    }
+}
+
+int ReplayRecorderStop( struct ReplayRecorder *recorder )
+{
+    struct ReplayHeader header;
+    static const unsigned char padding[4];
+    if ( !recorder->started ) {
+        return 0;
+    }
+    atomic_store_explicit( &recorder->running, 0, memory_order_release );
+    pthread_join( recorder->thread, NULL );
+    RingFree( &recorder->commands );
+    recorder->started = 0;
+
+    // The index is read in place, keep it aligned.
+    size_t paddingSize = ( 4 - recorder->recordsSize % 4 ) % 4;
+    memset( &header, 0, sizeof(header) );
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.simRate = SIM_RATE;
+    header.rackSeed = recorder->rackSeed;
+    header.shotCount = recorder->shots;
+    header.tickCount = recorder->tick;
+    header.recordsOffset = sizeof(header);
+    header.recordsSize = recorder->recordsSize;
+    header.indexOffset = sizeof(header) + recorder->recordsSize + paddingSize;
+    header.indexCount = recorder->indexCount;
+    strcpy( header.table, recorder->tablePath );
+    strcpy( header.tableName, recorder->tableName );
+
+    char temporary[ 4096 ];
+    snprintf( temporary, sizeof(temporary), "%s.tmp", recorder->path );
+    FILE *file = recorder->failed ? NULL : fopen( temporary, "wb" );
+    int ok = file != NULL;
+    if ( ok ) {
+        ok = fwrite( &header, sizeof(header), 1, file ) == 1 &&
+            fwrite( recorder->records, 1, recorder->recordsSize, file ) ==
+                recorder->recordsSize &&
+            fwrite( padding, 1, paddingSize, file ) == paddingSize &&
+            fwrite( recorder->index, sizeof(*recorder->index),
+                recorder->indexCount, file ) == recorder->indexCount;
+        ok = fclose( file ) == 0 && ok;
+        ok = ok && rename( temporary, recorder->path ) == 0;
+    }
+    if ( !ok ) {
+        fprintf( stderr, "%s: Can't write %s\n", __FILE__, recorder->path );
+        unlink( temporary );
+    } else {
+        fprintf( stderr, "Recorded %u shots, %u ticks in %zu bytes to %s\n",
+                recorder->shots, recorder->tick, header.indexOffset +
+                recorder->indexCount * sizeof(*recorder->index),
+                recorder->path );
+    }
+    free( recorder->records );
+    free( recorder->index );
+    recorder->records = NULL;
+    recorder->index = NULL;
+    return ok;
+}
+
+// ============Playback============ //
+
+int ReplayLoad( struct Replay *replay, const char *path )
+{
+    memset( replay, 0, sizeof(*replay) );
+    FILE *file = fopen( path, "rb" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: Can't open %s\n", __FILE__, path );
+        return 0;
+    }
+    fseek( file, 0, SEEK_END );
+    long size = ftell( file );
+    fseek( file, 0, SEEK_SET );
+    replay->data = size > 0 ? malloc( size ) : NULL;
+    if ( replay->data == NULL ||
+            fread( replay->data, 1, size, file ) != (size_t) size ) {
+        fprintf( stderr, "%s: Can't read %s\n", __FILE__, path );
+        fclose( file );
+        ReplayFree( replay );
+        return 0;
+    }
+    fclose( file );
+    replay->size = size;
+
+    struct ReplayHeader *header = &replay->header;
+    if ( replay->size < sizeof(*header) ) {
+        fprintf( stderr, "%s: %s is not a replay\n", __FILE__, path );
+        ReplayFree( replay );
+        return 0;
+    }
+    memcpy( header, replay->data, sizeof(*header) );
+    if ( header->magic != REPLAY_MAGIC || header->version != REPLAY_VERSION ||
+            header->recordsOffset > replay->size ||
+            header->recordsSize > replay->size - header->recordsOffset ||
+            header->indexOffset % 4 != 0 ||
+            header->indexOffset > replay->size ||
+            header->indexCount == 0 ||
+            memchr( header->table, '\0', sizeof(header->table) ) == NULL ||
+            memchr( header->tableName, '\0',
+                sizeof(header->tableName) ) == NULL ||
+            header->indexCount > ( replay->size - header->indexOffset ) /
+                sizeof(struct ReplayIndexEntry) ) {
+        fprintf( stderr, "%s: %s is not a replay this build can read\n",
+                __FILE__, path );
+        ReplayFree( replay );
+        return 0;
+    }
+    if ( header->simRate != SIM_RATE ) {
+        fprintf( stderr, "%s: %s was recorded at %u ticks per second, not "
+                "%u\n", __FILE__, path, header->simRate, SIM_RATE );
+        ReplayFree( replay );
+        return 0;
+    }
+    replay->records = replay->data + header->recordsOffset;
+    replay->index = (const struct ReplayIndexEntry *)
+        ( replay->data + header->indexOffset );
+    return 1;
+}
+
+void ReplayFree( struct Replay *replay )
+{
+    free( replay->data );
+    replay->data = NULL;
+}
+
+const struct ReplayIndexEntry * ReplayFindShot( const struct Replay *replay,
+        GLuint shot )
+{
+    // First entry with entry.shot >= shot.
+    GLuint low = 0;
+    GLuint high = replay->header.indexCount;
+    while ( low < high ) {
+        GLuint middle = low + ( high - low ) / 2;
+        if ( replay->index[middle].shot < shot ) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if ( low == replay->header.indexCount || replay->index[low].shot != shot ) {
+        return NULL;
+    }
+    return &replay->index[low];
+}
+
+const struct ReplayIndexEntry * ReplayFindTick( const struct Replay *replay,
+        GLuint tick )
+{
+    // Last entry with entry.tick <= tick.  The first is always at tick 0.
+    GLuint low = 1;
+    GLuint high = replay->header.indexCount;
+    while ( low < high ) {
+        GLuint middle = low + ( high - low ) / 2;
+        if ( replay->index[middle].tick <= tick ) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    // A shot's keyframe shares its tick with the places before it.  Take the
+    // earliest so ReplayAdvance stops short of them like it would coming
+    // from further back.
+    --low;
+    while ( low > 0 && replay->index[low - 1].tick == replay->index[low].tick ) {
+        --low;
+    }
+    return &replay->index[low];
+}
+
+struct ReplayRecord
+{
+    GLint type;
+    GLuint tick;
+    struct SimCommand command;
+};
+
+static int GetBytes( const struct Replay *replay, size_t *offset, void *bytes,
+        size_t size )
+{
+    if ( replay->header.recordsSize - *offset < size ) {
+        return 0;
+    }
+    memcpy( bytes, replay->records + *offset, size );
+    *offset += size;
+    return 1;
+}
+
+///
+// Decode the record at *offset.  Keyframes are decoded into particleData.
+// Returns 0 at the end of the stream or if it's damaged, and then record
+// may be only partly filled in: don't look at it.
+//
+static int GetRecord( const struct Replay *replay, size_t *offset,
+        struct ReplayRecord *record, GLfloat *particleData )
+{
+    unsigned char tag, byte;
+    if ( !GetBytes( replay, offset, &tag, 1 ) ) {
+        return 0;
+    }
+    record->type = tag & 0x7;
+    GLuint delta = tag >> 3;
+    if ( delta == REPLAY_DELTA_ESCAPE ) {
+        GLuint shift = 0;
+        GLuint rest = 0;
+        do {
+            if ( !GetBytes( replay, offset, &byte, 1 ) || shift > 28 ) {
+                return 0;
+            }
+            rest |= (GLuint) ( byte & 0x7f ) << shift;
+            shift += 7;
+        } while ( byte & 0x80 );
+        delta += rest;
+    }
+    record->tick += delta;
+
+    switch ( record->type ) {
+        case REPLAY_KEYFRAME: {
+            uint32_t onTable;
+            uint32_t moving;
+            GLint i;
+            if ( !GetBytes( replay, offset, &onTable, sizeof(onTable) ) ||
+                    !GetBytes( replay, offset, &moving, sizeof(moving) ) ) {
+                return 0;
+            }
+            for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+                GLfloat *point = &particleData[i * PARTICLE_SIZE];
+                point[0] = point[1] = INFINITY;
+                point[2] = point[3] = 0.0f;
+                if ( onTable & 1u << i &&
+                        !GetBytes( replay, offset, point, 2 * sizeof(GLfloat) ) ) {
+                    return 0;
+                }
+                if ( moving & 1u << i &&
+                        !GetBytes( replay, offset, point + 2,
+                            2 * sizeof(GLfloat) ) ) {
+                    return 0;
+                }
+            }
+            return 1;
+        }
+        case REPLAY_PLACE:
+        case REPLAY_SHOOT:
+            record->command.type = record->type == REPLAY_SHOOT ?
+                SIM_COMMAND_SHOOT : SIM_COMMAND_PLACE;
+            if ( !GetBytes( replay, offset, &byte, 1 ) || byte >= NUM_PARTICLES ||
+                    !GetBytes( replay, offset, record->command.value,
+                        sizeof(record->command.value) ) ) {
+                return 0;
+            }
+            record->command.ball = byte;
+            return 1;
+        case REPLAY_BALL: {
+            unsigned char slots[2];
+            return GetBytes( replay, offset, slots, sizeof(slots) );
+        }
+        case REPLAY_CUSHION:
+        case REPLAY_POCKET:
+            return GetBytes( replay, offset, &byte, 1 );
+        default:
+            return 0;
+    }
+}
+
+int ReplaySeek( struct ReplayCursor *cursor, const struct Replay *replay,
+        const struct ReplayIndexEntry *entry )
+{
+    struct ReplayRecord record;
+    size_t offset = entry->offset;
+    record.tick = 0;
+    if ( !GetRecord( replay, &offset, &record, cursor->particleData ) ||
+            record.type != REPLAY_KEYFRAME ) {
+        fprintf( stderr, "%s: Bad keyframe at %u\n", __FILE__, entry->offset );
+        return 0;
+    }
+    cursor->replay = replay;
+    cursor->offset = offset;
+    cursor->recordTick = entry->tick;
+    cursor->tick = entry->tick;
+    return 1;
+}
+
+static void Simulate( struct ReplayCursor *cursor, const struct Table *table,
+        GLuint until )
+{
+    const float step = (float) ( 1.0 / SIM_RATE );
+    while ( cursor->tick < until ) {
+        // The recorder doesn't count ticks at rest.
+        if ( !CheckForMovement( cursor->particleData, table->ballCount ) ) {
+            cursor->tick = until;
+            return;
+        }
+        UpdatePositions( cursor->particleData, table, step, NULL, NULL );
+        ++cursor->tick;
+    }
+}
+
+///
+// Stops short of any command recorded at tick, so the table is as it was
+// just before the player acted.
+//
+void ReplayAdvance( struct ReplayCursor *cursor, const struct Table *table,
+        GLuint tick )
+{
+    GLfloat keyframe[ NUM_PARTICLES * PARTICLE_SIZE ];
+    for ( ;; ) {
+        struct ReplayRecord record;
+        size_t offset = cursor->offset;
+        record.tick = cursor->recordTick;
+        if ( !GetRecord( cursor->replay, &offset, &record, keyframe ) ) {
+            Simulate( cursor, table, tick );
+            return;
+        }
+        int isCommand = record.type == REPLAY_PLACE ||
+            record.type == REPLAY_SHOOT;
+        if ( record.tick > tick || ( isCommand && record.tick == tick ) ) {
+            Simulate( cursor, table, tick );
+            return;
+        }
+        Simulate( cursor, table, record.tick );
+        if ( record.type == REPLAY_KEYFRAME ) {
+            memcpy( cursor->particleData, keyframe, sizeof(keyframe) );
+        } else if ( isCommand ) {
+            SimApplyCommand( cursor->particleData, &record.command );
+        }
+        cursor->offset = offset;
+        cursor->recordTick = record.tick;
+    }
+}
+
+int ReplayNextCommand( struct ReplayCursor *cursor,
+        struct SimCommand *command )
+{
+    GLfloat keyframe[ NUM_PARTICLES * PARTICLE_SIZE ];
+    struct ReplayRecord record;
+    record.tick = cursor->recordTick;
+    while ( GetRecord( cursor->replay, &cursor->offset, &record, keyframe ) ) {
+        cursor->recordTick = record.tick;
+        if ( record.type == REPLAY_PLACE || record.type == REPLAY_SHOOT ) {
+            *command = record.command;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ring.h"
+
+int RingInit( struct Ring *ring, size_t elementSize, GLuint capacity )
+{
+    if ( capacity == 0 || (capacity & (capacity - 1)) != 0 ) {
+        fprintf( stderr, "%s: capacity %u is not a power of two\n", __FILE__,
+                capacity );
+        return 0;
+    }
+    ring->data = malloc( elementSize * capacity );
+    if ( ring->data == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        return 0;
+    }
+    ring->elementSize = elementSize;
+    ring->capacity = capacity;
+    atomic_init( &ring->head, 0 );
+    atomic_init( &ring->tail, 0 );
+    return 1;
+}
+
+void RingFree( struct Ring *ring )
+{
+    free( ring->data );
+    ring->data = NULL;
+}
+
+// Returns 0 if the ring is full.  The element is dropped in that case; the
+// producer never waits on the consumer.
+int RingPush( struct Ring *ring, const void *element )
+{
+    GLuint tail = atomic_load_explicit( &ring->tail, memory_order_relaxed );
+    GLuint head = atomic_load_explicit( &ring->head, memory_order_acquire );
+    if ( tail - head == ring->capacity ) {
+        return 0;
+    }
+    memcpy( ring->data + (tail & (ring->capacity - 1)) * ring->elementSize,
+            element, ring->elementSize );
+    atomic_store_explicit( &ring->tail, tail + 1, memory_order_release );
+    return 1;
+}
+
+// Returns 0 if the ring is empty.
+int RingPop( struct Ring *ring, void *element )
+{
+    GLuint head = atomic_load_explicit( &ring->head, memory_order_relaxed );
+    GLuint tail = atomic_load_explicit( &ring->tail, memory_order_acquire );
+    if ( head == tail ) {
+        return 0;
+    }
+    memcpy( element, ring->data + (head & (ring->capacity - 1)) *
+            ring->elementSize, ring->elementSize );
+    atomic_store_explicit( &ring->head, head + 1, memory_order_release );
+    return 1;
+}
+
+int RingIsEmpty( struct Ring *ring )
+{
+    return atomic_load_explicit( &ring->head, memory_order_acquire ) ==
+           atomic_load_explicit( &ring->tail, memory_order_acquire );
+}
@@ -0,0 +1,605 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "physics.h"
+#include "physicsReference.h"
+#include "rack.h"
+#include "simThread.h"
+#include "script.h"
+#include "trajectory.h"
+
+enum ScriptActionType
+{
+    SCRIPT_RACK,
+    SCRIPT_PLACE,
+    SCRIPT_SHOOT
+};
+
+struct ScriptAction
+{
+    GLint type;
+    GLuint line;
+    GLuint shot;
+    unsigned int seed;
+    GLfloat value[2];
+};
+
+// A rack and the shots that follow it, up to the next rack.  Its JSON lines
+// collect in output until the writer gets to it.
+struct ScriptRack
+{
+    GLuint first;
+    GLuint count;
+    char *output;
+    size_t outputSize;
+    GLuint shots;
+    int failed;
+    int done;        // Guarded by the script lock.
+};
+
+struct Script
+{
+    const struct Table *table;
+    const struct TableSpec *spec;
+    struct ScriptAction *actions;
+    GLuint actionCount;
+    GLuint actionCapacity;
+    struct ScriptRack *racks;
+    GLuint rackCount;
+    GLuint rackCapacity;
+
+    atomic_uint nextRack;
+    pthread_mutex_t lock;
+    pthread_cond_t rackDone;
+};
+
+// Grow *array to hold at least count + 1 elements of size.
+static int Reserve( void **array, GLuint *capacity, GLuint count, size_t size )
+{
+    if ( count < *capacity ) {
+        return 1;
+    }
+    GLuint newCapacity = *capacity ? *capacity * 2 : 256;
+    void *grown = realloc( *array, newCapacity * size );
+    if ( grown == NULL ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        return 0;
+    }
+    *array = grown;
+    *capacity = newCapacity;
+    return 1;
+}
+
+static int ParseScript( struct Script *script, const char *path )
+{
+    FILE *file = fopen( path, "r" );
+    if ( file == NULL ) {
+        fprintf( stderr, "%s: Can't open %s\n", __FILE__, path );
+        return 0;
+    }
+    char *line = NULL;
+    size_t lineSize = 0;
+    GLuint lineNumber = 0;
+    GLuint shots = 0;
+    int ok = 1;
+    while ( ok && getline( &line, &lineSize, file ) != -1 ) {
+        struct ScriptAction action;
+        char word[16];
+        ++lineNumber;
+        if ( sscanf( line, "%15s", word ) != 1 || word[0] == '#' ) {
+            continue;
+        }
+        memset( &action, 0, sizeof(action) );
+        action.line = lineNumber;
+        if ( strcmp( word, "rack" ) == 0 &&
+                sscanf( line, "%*s %u", &action.seed ) == 1 ) {
+            action.type = SCRIPT_RACK;
+        } else if ( strcmp( word, "place" ) == 0 &&
+                sscanf( line, "%*s %f %f", &action.value[0],
+                    &action.value[1] ) == 2 ) {
+            action.type = SCRIPT_PLACE;
+        } else if ( strcmp( word, "shoot" ) == 0 &&
+                sscanf( line, "%*s %f %f", &action.value[0],
+                    &action.value[1] ) == 2 ) {
+            action.type = SCRIPT_SHOOT;
+            action.shot = shots++;
+        } else {
+            fprintf( stderr, "%s:%u: Can't parse %s", path, lineNumber, line );
+            ok = 0;
+            break;
+        }
+
+        if ( action.type == SCRIPT_RACK ) {
+            ok = Reserve( (void **) &script->racks, &script->rackCapacity,
+                    script->rackCount, sizeof(struct ScriptRack) );
+            if ( ok ) {
+                struct ScriptRack *rack = &script->racks[ script->rackCount++ ];
+                memset( rack, 0, sizeof(*rack) );
+                rack->first = script->actionCount;
+            }
+        } else if ( script->rackCount == 0 ) {
+            fprintf( stderr, "%s:%u: %s before the first rack\n", path,
+                    lineNumber, word );
+            ok = 0;
+        }
+        if ( ok ) {
+            ok = Reserve( (void **) &script->actions, &script->actionCapacity,
+                    script->actionCount, sizeof(struct ScriptAction) );
+        }
+        if ( ok ) {
+            script->actions[ script->actionCount++ ] = action;
+            ++script->racks[ script->rackCount - 1 ].count;
+        }
+    }
+    free( line );
+    fclose( file );
+    return ok;
+}
+
+static void WriteVector( FILE *out, const GLfloat *v )
+{
+    fprintf( out, "[%.9g,%.9g]", v[0], v[1] );
+}
+
+///
+// Run the table to rest after a shot and describe what happened.  Uses the
+// same fixed step as the sim thread, so a scripted shot plays out exactly as
+// it would in the game.
+//
+static void RunShot( const struct Script *script,
+        const struct ScriptAction *action, unsigned int seed,
+        const GLint *ballOrder, GLfloat *particleData, FILE *out )
+{
+    const float step = 1.0f / SIM_RATE;
+    GLint onTable[ NUM_PARTICLES ];
+    GLint slotOf[ NUM_PARTICLES ];
+    struct StepStats stats;
+    GLuint steps = 0;
+    GLuint contacts = 0;
+    GLint i;
+
+    memset( &stats, 0, sizeof(stats) );
+
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        onTable[i] = particleData[i * PARTICLE_SIZE] != INFINITY;
+        slotOf[ ballOrder[i] ] = i;
+    }
+    particleData[2] = action->value[0];
+    particleData[3] = action->value[1];
+    while ( CheckForMovement( particleData, script->table->ballCount ) &&
+            steps * step < SCRIPT_MAX_SIM_TIME ) {
+        contacts += UpdatePositions( particleData, script->table, step,
+                NULL, &stats );
+        ++steps;
+    }
+
+    fprintf( out, "{\"shot\":%u,\"line\":%u,\"rack\":%u,\"velocity\":",
+            action->shot, action->line, seed );
+    WriteVector( out, action->value );
+    fprintf( out, ",\"simTime\":%.6f,\"steps\":%u,\"substeps\":%u,"
+            "\"capped\":%u,\"contacts\":%u,\"settled\":%s,\"pocketed\":[",
+            steps * step, steps, stats.substeps, stats.capped, contacts,
+            CheckForMovement( particleData, script->table->ballCount ) ?
+            "false" : "true" );
+    const char *separator = "";
+    for ( i = 0 ; i < script->spec->ballCount ; ++i ) {
+        if ( onTable[ slotOf[i] ] &&
+                particleData[ slotOf[i] * PARTICLE_SIZE ] == INFINITY ) {
+            fprintf( out, "%s%d", separator, i );
+            separator = ",";
+        }
+    }
+    // Indexed by ball number, 0 is the cue ball.
+    fprintf( out, "],\"positions\":[" );
+    for ( i = 0 ; i < script->spec->ballCount ; ++i ) {
+        const GLfloat *point = &particleData[ slotOf[i] * PARTICLE_SIZE ];
+        if ( i > 0 ) {
+            fputc( ',', out );
+        }
+        if ( point[0] == INFINITY ) {
+            fprintf( out, "null" );
+        } else {
+            WriteVector( out, point );
+        }
+    }
+    fprintf( out, "]}\n" );
+}
+
+static void RunRack( struct Script *script, struct ScriptRack *rack )
+{
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLint ballOrder[ NUM_PARTICLES ];
+    unsigned int seed = 0;
+    GLuint i;
+
+    FILE *out = open_memstream( &rack->output, &rack->outputSize );
+    if ( out == NULL ) {
+        fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+        rack->failed = 1;
+        return;
+    }
+    for ( i = rack->first ; i < rack->first + rack->count ; ++i ) {
+        const struct ScriptAction *action = &script->actions[i];
+        switch ( action->type ) {
+            case SCRIPT_RACK:
+                seed = action->seed;
+                RackShuffle( script->spec, ballOrder, seed );
+                RackPositions( script->spec, particleData );
+                break;
+            case SCRIPT_PLACE:
+                particleData[0] = action->value[0];
+                particleData[1] = action->value[1];
+                particleData[2] = 0.0f;
+                particleData[3] = 0.0f;
+                break;
+            case SCRIPT_SHOOT:
+                ++rack->shots;
+                if ( particleData[0] == INFINITY ) {
+                    fprintf( out, "{\"shot\":%u,\"line\":%u,\"rack\":%u,"
+                            "\"error\":\"cue ball not placed\"}\n",
+                            action->shot, action->line, seed );
+                    rack->failed = 1;
+                    break;
+                }
+                RunShot( script, action, seed, ballOrder, particleData, out );
+                break;
+        }
+    }
+    fclose( out );
+}
+
+static void * ScriptWorker( void *arg )
+{
+    struct Script *script = arg;
+    for ( ;; ) {
+        GLuint next = atomic_fetch_add( &script->nextRack, 1 );
+        if ( next >= script->rackCount ) {
+            return NULL;
+        }
+        struct ScriptRack *rack = &script->racks[next];
+        RunRack( script, rack );
+
+        pthread_mutex_lock( &script->lock );
+        rack->done = 1;
+        pthread_cond_broadcast( &script->rackDone );
+        pthread_mutex_unlock( &script->lock );
+    }
+}
+
+int RunScript( const char *path, const struct Table *table,
+        const struct TableSpec *spec, FILE *out, GLuint workers )
+{
+    struct Script script;
+    pthread_t threads[ SCRIPT_MAX_WORKERS ];
+    GLuint threadCount = 0;
+    GLuint shots = 0;
+    int failed = 0;
+    GLuint i;
+
+    memset( &script, 0, sizeof(script) );
+    script.table = table;
+    script.spec = spec;
+    if ( !ParseScript( &script, path ) ) {
+        free( script.actions );
+        free( script.racks );
+        return 1;
+    }
+    atomic_init( &script.nextRack, 0 );
+    pthread_mutex_init( &script.lock, NULL );
+    pthread_cond_init( &script.rackDone, NULL );
+
+    double start = SimThreadNow();
+    if ( workers > SCRIPT_MAX_WORKERS ) {
+        workers = SCRIPT_MAX_WORKERS;
+    }
+    for ( i = 0 ; i < workers && i < script.rackCount ; ++i ) {
+        if ( pthread_create( &threads[i], NULL, ScriptWorker, &script ) != 0 ) {
+            fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+            break;
+        }
+        ++threadCount;
+    }
+    if ( threadCount == 0 ) {
+        ScriptWorker( &script );
+    }
+
+    // Write each rack as soon as it and everything before it is done.
+    for ( i = 0 ; i < script.rackCount ; ++i ) {
+        struct ScriptRack *rack = &script.racks[i];
+        pthread_mutex_lock( &script.lock );
+        while ( !rack->done ) {
+            pthread_cond_wait( &script.rackDone, &script.lock );
+        }
+        pthread_mutex_unlock( &script.lock );
+        if ( rack->output != NULL ) {
+            fwrite( rack->output, 1, rack->outputSize, out );
+        }
+        free( rack->output );
+        shots += rack->shots;
+        failed |= rack->failed;
+    }
+    fflush( out );
+    for ( i = 0 ; i < threadCount ; ++i ) {
+        pthread_join( threads[i], NULL );
+    }
+    double elapsed = SimThreadNow() - start;
+    fprintf( stderr, "%s: %u shots in %u racks, %.2f s (%.0f shots/s)\n",
+            path, shots, script.rackCount, elapsed,
+            elapsed > 0.0 ? shots / elapsed : 0.0 );
+
+    pthread_mutex_destroy( &script.lock );
+    pthread_cond_destroy( &script.rackDone );
+    free( script.actions );
+    free( script.racks );
+    return failed;
+}
+
+enum AccuracyMethod
+{
+    ACCURACY_STEP,       // UpdatePositions, as the sim thread runs it.
+    ACCURACY_TRAJECTORY, // BuildTrajectory's closed-form motion.
+};
+
+struct AccuracyConfig
+{
+    const char *name;
+    GLint method;
+    GLuint ticks;        // ACCURACY_STEP: sim ticks per step.
+};
+
+// What RunAccuracy measures.  Add a line here for each new fast path.
+static const struct AccuracyConfig accuracyConfigs[] = {
+    { "step 240 Hz", ACCURACY_STEP, 1 },
+    { "step 120 Hz", ACCURACY_STEP, 2 },
+    { "step 60 Hz", ACCURACY_STEP, 4 },
+    { "trajectory", ACCURACY_TRAJECTORY, 0 },
+};
+#define ACCURACY_CONFIG_COUNT \
+    ( sizeof(accuracyConfigs) / sizeof(accuracyConfigs[0]) )
+
+// A shot's error is how far its furthest ball ended up from where the
+// reference put it.  Breaks are chaotic, so a handful of them can be way off
+// while the rest agree; the median says more than the mean about a
+// configuration.
+struct AccuracyResult
+{
+    double *errors;      // One per settled shot.
+    GLuint compared;
+    double errorSum;
+    GLuint mismatched;   // Shots that pocketed different balls.
+    GLuint unsettled;    // Shots that never came to rest.
+    double time;
+};
+
+///
+// Play one shot with config from particleData, leaving the result in it.
+// Returns 0 if it didn't come to rest.
+//
+static int AccuracyRun( const struct AccuracyConfig *config,
+        const struct Table *table, struct Trajectory *trajectory,
+        GLfloat *particleData )
+{
+    if ( config->method == ACCURACY_TRAJECTORY ) {
+        if ( !BuildTrajectory( trajectory, particleData, table ) ) {
+            return 0;
+        }
+        memcpy( particleData, trajectory->finalParticleData,
+                sizeof(trajectory->finalParticleData) );
+        return 1;
+    }
+    const float step = (float) config->ticks / SIM_RATE;
+    GLuint steps = 0;
+    while ( CheckForMovement( particleData, table->ballCount ) &&
+            steps * step < SCRIPT_MAX_SIM_TIME ) {
+        UpdatePositions( particleData, table, step, NULL, NULL );
+        ++steps;
+    }
+    return !CheckForMovement( particleData, table->ballCount );
+}
+
+static void AccuracyCompare( struct AccuracyResult *result,
+        const double *reference, const GLfloat *particleData )
+{
+    double largest = 0.0;
+    int mismatched = 0;
+    int i;
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        const double *expected = &reference[i * PARTICLE_SIZE];
+        const GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        if ( ( expected[0] == INFINITY ) != ( point[0] == INFINITY ) ) {
+            mismatched = 1;
+        } else if ( point[0] != INFINITY ) {
+            double error = hypot( point[0] - expected[0],
+                    point[1] - expected[1] );
+            if ( error > largest ) {
+                largest = error;
+            }
+        }
+    }
+    result->errors[ result->compared++ ] = largest;
+    result->errorSum += largest;
+    result->mismatched += mismatched;
+}
+
+static int CompareErrors( const void *a, const void *b )
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+    return ( x > y ) - ( x < y );
+}
+
+struct Accuracy
+{
+    const struct Table *table;
+    const struct TableSpec *spec;
+    struct ReferenceTable reference;
+    struct Trajectory trajectory;
+    struct AccuracyResult results[ ACCURACY_CONFIG_COUNT ];
+    double referenceTime;
+    GLuint referenceUnsettled;
+    GLuint shots;
+};
+
+///
+// Run a shot from state with the reference, then from the same place with
+// every configuration, and leave the reference's result in state.
+//
+static void AccuracyShot( struct Accuracy *accuracy, double *state )
+{
+    GLfloat start[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLuint steps = 0;
+    GLuint c;
+    int i;
+
+    for ( i = 0 ; i < NUM_PARTICLES * PARTICLE_SIZE ; ++i ) {
+        start[i] = (GLfloat) state[i];
+    }
+    double begin = SimThreadNow();
+    while ( ReferenceMoving( state, &accuracy->reference ) &&
+            steps < SCRIPT_MAX_SIM_TIME * REFERENCE_RATE ) {
+        ReferenceUpdate( state, &accuracy->reference );
+        ++steps;
+    }
+    accuracy->referenceTime += SimThreadNow() - begin;
+    if ( ReferenceMoving( state, &accuracy->reference ) ) {
+        // Stopped where it got to, so the next shot starts from rest.
+        ++accuracy->referenceUnsettled;
+        for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+            state[i * PARTICLE_SIZE + 2] = 0.0;
+            state[i * PARTICLE_SIZE + 3] = 0.0;
+        }
+    }
+
+    for ( c = 0 ; c < ACCURACY_CONFIG_COUNT ; ++c ) {
+        struct AccuracyResult *result = &accuracy->results[c];
+        memcpy( particleData, start, sizeof(start) );
+        begin = SimThreadNow();
+        int settled = AccuracyRun( &accuracyConfigs[c], accuracy->table,
+                &accuracy->trajectory, particleData );
+        result->time += SimThreadNow() - begin;
+        if ( settled ) {
+            AccuracyCompare( result, state, particleData );
+        } else {
+            ++result->unsettled;
+        }
+    }
+    ++accuracy->shots;
+}
+
+///
+// Every configuration starts each shot from where the reference left the
+// last one, so errors are per shot and don't pile up over a rack.
+//
+static int AccuracyPlay( struct Accuracy *accuracy, const struct Script
+        *script, const char *path )
+{
+    GLfloat particleData[ NUM_PARTICLES * PARTICLE_SIZE ];
+    double state[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLint ballOrder[ NUM_PARTICLES ];
+    int failed = 0;
+    GLuint i;
+    int j;
+
+    for ( i = 0 ; i < script->actionCount ; ++i ) {
+        const struct ScriptAction *action = &script->actions[i];
+        switch ( action->type ) {
+            case SCRIPT_RACK:
+                RackShuffle( accuracy->spec, ballOrder, action->seed );
+                RackPositions( accuracy->spec, particleData );
+                for ( j = 0 ; j < NUM_PARTICLES * PARTICLE_SIZE ; ++j ) {
+                    state[j] = particleData[j];
+                }
+                break;
+            case SCRIPT_PLACE:
+                state[0] = action->value[0];
+                state[1] = action->value[1];
+                state[2] = state[3] = 0.0;
+                break;
+            case SCRIPT_SHOOT:
+                if ( state[0] == INFINITY ) {
+                    fprintf( stderr, "%s:%u: Cue ball not placed\n", path,
+                            action->line );
+                    failed = 1;
+                    break;
+                }
+                state[2] = action->value[0];
+                state[3] = action->value[1];
+                AccuracyShot( accuracy, state );
+                break;
+        }
+    }
+    return failed;
+}
+
+static void AccuracyReport( struct Accuracy *accuracy, const char *path,
+        FILE *out )
+{
+    GLuint c;
+    fprintf( out, "%s: %u shots on %s against the double precision reference"
+            " at %d Hz (%.2f s, %u unsettled)\n", path, accuracy->shots,
+            accuracy->spec->name, REFERENCE_RATE, accuracy->referenceTime,
+            accuracy->referenceUnsettled );
+    fprintf( out, "%-14s %11s %11s %11s %10s %10s %10s %9s\n", "config",
+            "median", "mean", "worst", "mismatched", "unsettled", "time",
+            "speedup" );
+    for ( c = 0 ; c < ACCURACY_CONFIG_COUNT ; ++c ) {
+        struct AccuracyResult *result = &accuracy->results[c];
+        double median = 0.0, mean = 0.0, worst = 0.0;
+        if ( result->compared > 0 ) {
+            qsort( result->errors, result->compared, sizeof(double),
+                    CompareErrors );
+            median = result->errors[ result->compared / 2 ];
+            mean = result->errorSum / result->compared;
+            worst = result->errors[ result->compared - 1 ];
+        }
+        fprintf( out, "%-14s %11.3e %11.3e %11.3e %10u %10u %9.3fs %8.1fx\n",
+                accuracyConfigs[c].name, median, mean, worst,
+                result->mismatched, result->unsettled, result->time,
+                result->time > 0.0 ?
+                accuracy->referenceTime / result->time : 0.0 );
+    }
+    fflush( out );
+}
+
+int RunAccuracy( const char *path, const struct Table *table,
+        const struct TableSpec *spec, FILE *out )
+{
+    struct Script script;
+    struct Accuracy accuracyData;
+    struct Accuracy *accuracy = &accuracyData;
+    int failed = 1;
+    GLuint c;
+
+    memset( &script, 0, sizeof(script) );
+    memset( accuracy, 0, sizeof(*accuracy) );
+    accuracy->table = table;
+    accuracy->spec = spec;
+    int ok = ParseScript( &script, path ) &&
+        ReferenceTableInit( &accuracy->reference, table ) &&
+        TrajectoryInit( &accuracy->trajectory, SCRIPT_MAX_KEYFRAMES );
+    for ( c = 0 ; ok && c < ACCURACY_CONFIG_COUNT ; ++c ) {
+        accuracy->results[c].errors = malloc( sizeof(double) *
+                ( script.actionCount + 1 ) );
+        if ( accuracy->results[c].errors == NULL ) {
+            fprintf( stderr, "%s: Memory Error\n", __FILE__ );
+            ok = 0;
+        }
+    }
+    if ( ok ) {
+        failed = AccuracyPlay( accuracy, &script, path );
+        AccuracyReport( accuracy, path, out );
+    }
+
+    for ( c = 0 ; c < ACCURACY_CONFIG_COUNT ; ++c ) {
+        free( accuracy->results[c].errors );
+    }
+    TrajectoryFree( &accuracy->trajectory );
+    ReferenceTableFree( &accuracy->reference );
+    free( script.actions );
+    free( script.racks );
+    return failed;
+}
@@ -0,0 +1,236 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "sharedState.h"
+#include "physics.h"
+
+// ============Publisher============ //
+
+int SharedStateCreate( struct SharedStatePublisher *publisher,
+        const char *name, const char *table, uint32_t simRate )
+{
+    struct SharedStateRegion *region;
+    GLint i;
+
+    if ( strlen( name ) >= sizeof(publisher->name) ) {
+        fprintf( stderr, "%s: Name too long %s\n", __FILE__, name );
+        return 0;
+    }
+    if ( strlen( table ) >= sizeof(region->table) ) {
+        fprintf( stderr, "%s: Table name too long %s\n", __FILE__, table );
+        return 0;
+    }
+    strcpy( publisher->name, name );
+    // A region left by an earlier run is replaced, not reused: truncating it
+    // would pull the pages out from under readers that still have it mapped.
+    // They keep the old one until they open the name again.
+    shm_unlink( name );
+    publisher->fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0644 );
+    if ( publisher->fd < 0 ) {
+        perror( name );
+        return 0;
+    }
+    if ( ftruncate( publisher->fd, sizeof(*region) ) != 0 ) {
+        perror( name );
+        close( publisher->fd );
+        shm_unlink( name );
+        return 0;
+    }
+    region = mmap( NULL, sizeof(*region), PROT_READ | PROT_WRITE, MAP_SHARED,
+            publisher->fd, 0 );
+    if ( region == MAP_FAILED ) {
+        perror( name );
+        close( publisher->fd );
+        shm_unlink( name );
+        return 0;
+    }
+    region->version = SHARED_STATE_VERSION;
+    region->slotCount = SHARED_STATE_SLOTS;
+    region->simRate = simRate;
+    strcpy( region->table, table );
+    atomic_init( &region->published, 0 );
+    for ( i = 0 ; i < SHARED_STATE_SLOTS ; ++i ) {
+        atomic_init( &region->slots[i].lock, 0 );
+    }
+    atomic_thread_fence( memory_order_release );
+    region->magic = SHARED_STATE_MAGIC;
+
+    publisher->region = region;
+    publisher->published = 0;
+    for ( i = 0 ; i < SHARED_STATE_BALLS ; ++i ) {
+        publisher->ballNumbers[i] = i;
+    }
+    return 1;
+}
+
+void SharedStatePublish( struct SharedStatePublisher *publisher,
+        uint32_t tick, const float *particleData )
+{
+    struct SharedStateRegion *region = publisher->region;
+    struct SharedStateSlot *slot = &region->slots[ publisher->published %
+            SHARED_STATE_SLOTS ];
+    struct SharedState *state = &slot->state;
+    GLint i;
+
+    unsigned int lock = atomic_load_explicit( &slot->lock,
+            memory_order_relaxed );
+    atomic_store_explicit( &slot->lock, lock + 1, memory_order_relaxed );
+    atomic_thread_fence( memory_order_release );
+
+    state->sequence = publisher->published;
+    state->tick = tick;
+    state->moving = 0;
+    state->pocketed = 0;
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        const GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        int32_t number = publisher->ballNumbers[i];
+        memcpy( state->balls[number], point, sizeof(state->balls[number]) );
+        if ( point[0] == INFINITY ) {
+            state->pocketed |= 1u << number;
+        }
+        if ( point[2] != 0.0f || point[3] != 0.0f ) {
+            state->moving |= 1u << number;
+        }
+    }
+
+    atomic_store_explicit( &slot->lock, lock + 2, memory_order_release );
+    atomic_store_explicit( &region->published, ++publisher->published,
+            memory_order_release );
+}
+
+void SharedStateDestroy( struct SharedStatePublisher *publisher )
+{
+    if ( publisher->region == NULL ) {
+        return;
+    }
+    munmap( publisher->region, sizeof(*publisher->region) );
+    close( publisher->fd );
+    shm_unlink( publisher->name );
+    publisher->region = NULL;
+}
+
+// ============Reader============ //
+
+int SharedStateOpen( struct SharedStateReader *reader, const char *name )
+{
+    struct stat info;
+    const struct SharedStateRegion *region;
+
+    memset( reader, 0, sizeof(*reader) );
+    reader->fd = shm_open( name, O_RDONLY, 0 );
+    if ( reader->fd < 0 ) {
+        perror( name );
+        return 0;
+    }
+    if ( fstat( reader->fd, &info ) != 0 ||
+            (size_t) info.st_size < sizeof(*region) ) {
+        fprintf( stderr, "%s: %s isn't ready\n", __FILE__, name );
+        close( reader->fd );
+        return 0;
+    }
+    region = mmap( NULL, sizeof(*region), PROT_READ, MAP_SHARED, reader->fd,
+            0 );
+    if ( region == MAP_FAILED ) {
+        perror( name );
+        close( reader->fd );
+        return 0;
+    }
+    if ( region->magic != SHARED_STATE_MAGIC ) {
+        fprintf( stderr, "%s: %s isn't ready\n", __FILE__, name );
+        munmap( (void *) region, sizeof(*region) );
+        close( reader->fd );
+        return 0;
+    }
+    atomic_thread_fence( memory_order_acquire );
+    if ( region->version != SHARED_STATE_VERSION ||
+            region->slotCount != SHARED_STATE_SLOTS ) {
+        fprintf( stderr, "%s: %s is version %u with %u slots, this reader "
+                "wants version %u with %u\n", __FILE__, name, region->version,
+                region->slotCount, SHARED_STATE_VERSION, SHARED_STATE_SLOTS );
+        munmap( (void *) region, sizeof(*region) );
+        close( reader->fd );
+        return 0;
+    }
+    if ( memchr( region->table, '\0', sizeof(region->table) ) == NULL ) {
+        fprintf( stderr, "%s: %s has a bad table name\n", __FILE__, name );
+        munmap( (void *) region, sizeof(*region) );
+        close( reader->fd );
+        return 0;
+    }
+    reader->region = region;
+    reader->size = sizeof(*region);
+    reader->next = atomic_load_explicit( &region->published,
+            memory_order_acquire );
+    if ( reader->next > 0 ) {
+        --reader->next;
+    }
+    return 1;
+}
+
+int SharedStateRead( struct SharedStateReader *reader,
+        struct SharedState *state )
+{
+    const struct SharedStateRegion *region = reader->region;
+    for ( ;; ) {
+        uint32_t published = atomic_load_explicit(
+                (atomic_uint *) &region->published, memory_order_acquire );
+        if ( reader->next == published ) {
+            return 0;
+        }
+        // The oldest slot may be the one being rewritten, don't bother.
+        if ( published - reader->next > SHARED_STATE_SLOTS - 1 ) {
+            reader->dropped += published - ( SHARED_STATE_SLOTS - 1 ) -
+                reader->next;
+            reader->next = published - ( SHARED_STATE_SLOTS - 1 );
+        }
+
+        const struct SharedStateSlot *slot = &region->slots[ reader->next %
+                SHARED_STATE_SLOTS ];
+        unsigned int before = atomic_load_explicit(
+                (atomic_uint *) &slot->lock, memory_order_acquire );
+        if ( before & 1 ) {
+            sched_yield();
+            continue;
+        }
+        memcpy( state, &slot->state, sizeof(*state) );
+        atomic_thread_fence( memory_order_acquire );
+        unsigned int after = atomic_load_explicit(
+                (atomic_uint *) &slot->lock, memory_order_relaxed );
+        if ( before != after || state->sequence != reader->next ) {
+            // Overwritten while we copied.  Next time round we skip ahead.
+            continue;
+        }
+        ++reader->next;
+        return 1;
+    }
+}
+
+int SharedStateLatest( struct SharedStateReader *reader,
+        struct SharedState *state )
+{
+    uint32_t published = atomic_load_explicit(
+            (atomic_uint *) &reader->region->published, memory_order_acquire );
+    if ( published == 0 ) {
+        return 0;
+    }
+    if ( published - reader->next > 1 ) {
+        reader->next = published - 1;
+    }
+    return SharedStateRead( reader, state );
+}
+
+void SharedStateClose( struct SharedStateReader *reader )
+{
+    if ( reader->region == NULL ) {
+        return;
+    }
+    munmap( (void *) reader->region, reader->size );
+    close( reader->fd );
+    reader->region = NULL;
+}
@@ -0,0 +1,187 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "simThread.h"
+
+double SimThreadNow( void )
+{
+    struct timespec now;
+    clock_gettime( CLOCK_MONOTONIC, &now );
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+void SimApplyCommand( GLfloat *particleData, const struct SimCommand *command )
+{
+    GLfloat *point = &particleData[ command->ball * PARTICLE_SIZE ];
+    switch ( command->type ) {
+        case SIM_COMMAND_PLACE:
+            point[0] = command->value[0];
+            point[1] = command->value[1];
+            point[2] = 0.0f;
+            point[3] = 0.0f;
+            break;
+        case SIM_COMMAND_SHOOT:
+            point[2] = command->value[0];
+            point[3] = command->value[1];
+            break;
+        default:
+            fprintf( stderr, "%s: Unknown command %d\n", __FILE__,
+                    command->type );
+            break;
+    }
+}
+
+static void SimThreadApplyCommands( struct SimThread *sim )
+{
+    struct SimCommand command;
+    while ( RingPop( &sim->commands, &command ) ) {
+        SimApplyCommand( sim->particleData, &command );
+        ++sim->commandsApplied;
+    }
+}
+
+static void SimThreadWriteState( struct SimThread *sim, struct SimState *state )
+{
+    memcpy( &state->particleData[0], &sim->particleData[0],
+            sizeof(state->particleData) );
+    memcpy( &state->previousParticleData[0], &sim->tickStart[0],
+            sizeof(state->previousParticleData) );
+    state->tick = sim->tick;
+    state->commandsApplied = sim->commandsApplied;
+    state->moving = CheckForMovement( sim->particleData,
+            sim->table->ballCount );
+    state->publishTime = SimThreadNow();
+    state->stats = sim->stats;
+}
+
+static void SimThreadPublish( struct SimThread *sim )
+{
+    SimThreadWriteState( sim, &sim->states[ sim->writeIndex ] );
+    GLuint previous = atomic_exchange_explicit( &sim->sharedIndex,
+            sim->writeIndex | SIM_STATE_FRESH, memory_order_acq_rel );
+    sim->writeIndex = previous & SIM_STATE_INDEX_MASK;
+}
+
+static void SimThreadPushTick( struct SimThread *sim,
+        const struct ContactList *contacts )
+{
+    struct SimTick tick;
+    tick.tick = sim->tick;
+    tick.moving = CheckForMovement( sim->particleData, sim->table->ballCount );
+    memcpy( &tick.particleData[0], &sim->particleData[0],
+            sizeof(tick.particleData) );
+    tick.contacts = *contacts;
+    RingPush( sim->ticks, &tick );
+}
+
+static void * SimThreadMain( void *arg )
+{
+    struct SimThread *sim = arg;
+    const double step = 1.0 / SIM_RATE;
+    double next = SimThreadNow();
+
+    while ( atomic_load_explicit( &sim->running, memory_order_acquire ) ) {
+        struct ContactList contacts;
+        GLuint applied = sim->commandsApplied;
+        int moving;
+        contacts.count = 0;
+        SimThreadApplyCommands( sim );
+        // Placed balls start the tick where they were put, not slide there.
+        memcpy( &sim->tickStart[0], &sim->particleData[0],
+                sizeof(sim->tickStart) );
+        moving = CheckForMovement( sim->particleData, sim->table->ballCount );
+        if ( moving ) {
+            UpdatePositions( sim->particleData, sim->table, (float) step,
+                    sim->ticks != NULL ? &contacts : NULL, &sim->stats );
+        }
+        ++sim->tick;
+        SimThreadPublish( sim );
+        if ( sim->shared != NULL ) {
+            SharedStatePublish( sim->shared, sim->tick, sim->particleData );
+        }
+        if ( sim->ticks != NULL && ( moving || sim->tick == 1 ||
+                applied != sim->commandsApplied ) ) {
+            SimThreadPushTick( sim, &contacts );
+        }
+
+        // Run at a fixed rate.  After a long stall (the break) catch up on the
+        // missed ticks, but not so many that we never get back to real time.
+        next += step;
+        double now = SimThreadNow();
+        if ( now - next > SIM_MAX_CATCH_UP ) {
+            next = now;
+        }
+        if ( next > now ) {
+            struct timespec sleep;
+            sleep.tv_sec = (time_t) next;
+            sleep.tv_nsec = (long) ((next - sleep.tv_sec) * 1e9);
+            clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &sleep, NULL );
+        }
+    }
+    return NULL;
+}
+
+int SimThreadStart( struct SimThread *sim, const struct Table *table, const
+        GLfloat *particleData )
+{
+    int i;
+    sim->table = table;
+    memcpy( &sim->particleData[0], particleData, sizeof(sim->particleData) );
+    memcpy( &sim->tickStart[0], particleData, sizeof(sim->tickStart) );
+    sim->tick = 0;
+    sim->commandsApplied = 0;
+    memset( &sim->stats, 0, sizeof(sim->stats) );
+    if ( !RingInit( &sim->commands, sizeof(struct SimCommand),
+            SIM_COMMAND_QUEUE_SIZE ) ) {
+        return 0;
+    }
+
+    // Every buffer starts out holding the initial state so the renderer has
+    // something sane to read before the first tick.
+    for ( i = 0 ; i < SIM_STATE_COUNT ; ++i ) {
+        SimThreadWriteState( sim, &sim->states[i] );
+    }
+    sim->writeIndex = 0;
+    sim->readIndex = 1;
+    atomic_init( &sim->sharedIndex, 2 );
+
+    atomic_init( &sim->running, 1 );
+    if ( pthread_create( &sim->thread, NULL, SimThreadMain, sim ) != 0 ) {
+        fprintf( stderr, "%s: pthread_create failed\n", __FILE__ );
+        RingFree( &sim->commands );
+        return 0;
+    }
+    return 1;
+}
+
+void SimThreadStop( struct SimThread *sim )
+{
+    atomic_store_explicit( &sim->running, 0, memory_order_release );
+    pthread_join( sim->thread, NULL );
+    RingFree( &sim->commands );
+}
+
+///
+// Newest complete state.  Only the render thread may call this; the returned
+// state stays valid until the next call.
+//
+const struct SimState * SimThreadLatest( struct SimThread *sim )
+{
+    if ( atomic_load_explicit( &sim->sharedIndex, memory_order_acquire ) &
+            SIM_STATE_FRESH ) {
+        GLuint previous = atomic_exchange_explicit( &sim->sharedIndex,
+                sim->readIndex, memory_order_acq_rel );
+        sim->readIndex = previous & SIM_STATE_INDEX_MASK;
+    }
+    return &sim->states[ sim->readIndex ];
+}
+
+int SimThreadSubmit( struct SimThread *sim, const struct SimCommand *command )
+{
+    if ( !RingPush( &sim->commands, command ) ) {
+        fprintf( stderr, "%s: Command queue full\n", __FILE__ );
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "tableSpec.h"
+#include "assets.h"
+
+static int ParseCoordinate( const char *text, GLfloat *value )
+{
+    char *end;
+    if ( strcmp( text, "-" ) == 0 ) {
+        *value = INFINITY;
+        return 1;
+    }
+    *value = strtof( text, &end );
+    return end != text && *end == '\0';
+}
+
+static int ParseRack( struct TableSpec *spec, const char *line )
+{
+    char rule[ TABLE_SPEC_NAME_SIZE ];
+    int used;
+    if ( sscanf( line, "rack %63s%n", rule, &used ) != 1 ) {
+        return 0;
+    }
+    if ( strcmp( rule, "fixed" ) == 0 ) {
+        spec->rack = RACK_FIXED;
+    } else if ( strcmp( rule, "eight-ball" ) == 0 ) {
+        spec->rack = RACK_EIGHT_BALL;
+    } else if ( strcmp( rule, "shuffle" ) == 0 ) {
+        int number;
+        int more;
+        spec->rack = RACK_SHUFFLE;
+        spec->keep = 0;
+        line += used;
+        while ( sscanf( line, "%d%n", &number, &more ) == 1 ) {
+            if ( number < 0 || number >= NUM_PARTICLES ) {
+                return 0;
+            }
+            spec->keep |= 1u << number;
+            line += more;
+        }
+    } else {
+        return 0;
+    }
+    return 1;
+}
+
+int LoadTableSpec( struct TableSpec *spec, const char *_fileName )
+{
+    struct AssetData asset;
+    if ( !AssetOpen( _fileName, &asset ) ) {
+        return 0;
+    }
+    memset( spec, 0, sizeof(*spec) );
+    spec->scale = 1.0f;
+    spec->rack = RACK_FIXED;
+
+    const char *line = (const char *)asset.data;
+    GLuint lineNumber = 1;
+    int hasModels = 0;
+    int ok = 1;
+    while ( ok && *line != '\0' ) {
+        char first[ TABLE_SPEC_NAME_SIZE ];
+        char x[ TABLE_SPEC_NAME_SIZE ];
+        char y[ TABLE_SPEC_NAME_SIZE ];
+        if ( strncmp( line, "name ", 5 ) == 0 ) {
+            size_t length = strcspn( line + 5, "\n" );
+            if ( length >= sizeof(spec->name) ) {
+                length = sizeof(spec->name) - 1;
+            }
+            memcpy( spec->name, line + 5, length );
+            spec->name[length] = '\0';
+        } else if ( strncmp( line, "models ", 7 ) == 0 ) {
+            ok = sscanf( line, "models %63s %63s %63s %63s %63s",
+                    spec->models[0], spec->models[1], spec->models[2],
+                    spec->models[3], spec->models[4] ) == TABLE_MODEL_COUNT;
+            hasModels = ok;
+        } else if ( strncmp( line, "scale ", 6 ) == 0 ) {
+            ok = sscanf( line, "scale %f", &spec->scale ) == 1 &&
+                spec->scale > 0.0f;
+        } else if ( strncmp( line, "size ", 5 ) == 0 ) {
+            ok = sscanf( line, "size %f %f", &spec->size[0],
+                    &spec->size[1] ) == 2;
+        } else if ( strncmp( line, "headString ", 11 ) == 0 ) {
+            ok = sscanf( line, "headString %f", &spec->headString ) == 1;
+        } else if ( strncmp( line, "radius ", 7 ) == 0 ) {
+            ok = sscanf( line, "radius %f", &spec->ballRadius ) == 1 &&
+                spec->ballRadius > 0.0f;
+        } else if ( strncmp( line, "rack ", 5 ) == 0 ) {
+            ok = ParseRack( spec, line );
+        } else if ( strncmp( line, "ball ", 5 ) == 0 ) {
+            ok = spec->ballCount < NUM_PARTICLES &&
+                sscanf( line, "ball %63s %63s %63s", first, x, y ) == 3;
+            if ( ok ) {
+                struct TableSpecBall *ball = &spec->balls[ spec->ballCount++ ];
+                strcpy( ball->sprite, first );
+                ok = ParseCoordinate( x, &ball->spot[0] ) &&
+                    ParseCoordinate( y, &ball->spot[1] ) &&
+                    ( ball->spot[0] == INFINITY ) ==
+                    ( ball->spot[1] == INFINITY ) &&
+                    ( spec->ballCount == 1 || ball->spot[0] != INFINITY );
+            }
+        }
+        // Anything else is a comment.
+        const char *next = strchr( line, '\n' );
+        if ( next == NULL ) {
+            break;
+        }
+        line = next + 1;
+        ++lineNumber;
+    }
+    AssetClose( &asset );
+
+    if ( !ok ) {
+        fprintf( stderr, "%s: Bad table %s (line %u)\n", __FILE__, _fileName,
+                lineNumber );
+        return 0;
+    }
+    if ( !hasModels || strcmp( spec->models[TABLE_MODEL_COLLISION], "-" ) == 0 ||
+            spec->size[0] <= 0.0f || spec->size[1] <= 0.0f ||
+            spec->ballRadius <= 0.0f || spec->ballCount < 2 ) {
+        fprintf( stderr, "%s: %s needs models with a collision mesh, a size, "
+                "a radius and at least two balls\n", __FILE__, _fileName );
+        return 0;
+    }
+    if ( spec->rack == RACK_EIGHT_BALL && spec->ballCount != 16 ) {
+        fprintf( stderr, "%s: %s racks eight-ball with %d balls, not 16\n",
+                __FILE__, _fileName, spec->ballCount );
+        return 0;
+    }
+    return 1;
+}
+
+size_t TableSpecArenaSize( const struct TableSpec *spec,
+        const struct Table *table )
+{
+    if ( spec->scale == 1.0f ) {
+        return 0;
+    }
+    return ArenaSize( sizeof(GLfloat) * 2 * table->collision.vertexCount );
+}
+
+int TableSpecApply( const struct TableSpec *spec, struct Table *table,
+        struct Arena *arena )
+{
+    GLuint i;
+    table->ballCount = spec->ballCount;
+    table->ballRadius = spec->ballRadius;
+    table->boundary = table->collision.v;
+    if ( spec->scale == 1.0f ) {
+        return 1;
+    }
+    // A uniform scale leaves the segment normals as they are.
+    GLfloat *boundary = ArenaAlloc( arena,
+            sizeof(GLfloat) * 2 * table->collision.vertexCount );
+    if ( boundary == NULL ) {
+        return 0;
+    }
+    for ( i = 0 ; i < 2 * table->collision.vertexCount ; ++i ) {
+        boundary[i] = table->collision.v[i] * spec->scale;
+    }
+    table->boundary = boundary;
+    return 1;
+}
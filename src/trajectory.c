@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "trajectory.h"
+
+int TrajectoryInit( struct Trajectory *trajectory, GLuint maxKeyframes )
+{
+    trajectory->keyframes = malloc( sizeof(struct Keyframe) * maxKeyframes );
+    trajectory->scratch = malloc( sizeof(struct Keyframe) * maxKeyframes );
+    trajectory->owner = malloc( sizeof(GLint) * maxKeyframes );
+    if ( trajectory->keyframes == NULL || trajectory->scratch == NULL ||
+         trajectory->owner == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        TrajectoryFree( trajectory );
+        return 0;
+    }
+    trajectory->maxKeyframes = maxKeyframes;
+    trajectory->keyframeCount = 0;
+    return 1;
+}
+
+void TrajectoryFree( struct Trajectory *trajectory )
+{
+    free( trajectory->keyframes );
+    free( trajectory->scratch );
+    free( trajectory->owner );
+    trajectory->keyframes = NULL;
+    trajectory->scratch = NULL;
+    trajectory->owner = NULL;
+}
+
+///
+// Position and velocity a keyframe predicts at an absolute time.  The vertex
+// shader does exactly the same sums.
+//
+void EvaluateKeyframe( const struct Keyframe *keyframe, GLfloat time,
+        GLfloat *position, GLfloat *velocity )
+{
+    GLfloat tau = time - keyframe->time;
+    int i;
+    if ( tau < 0.0f ) {
+        tau = 0.0f;
+    }
+    for ( i = 0 ; i < 2 ; ++i ) {
+        GLfloat v0 = keyframe->velocity[i];
+        GLfloat speed = fabsf( v0 );
+        GLfloat stopTime = 0.0f;
+        if ( speed > TRAJECTORY_STOP_SPEED ) {
+            stopTime = logf( speed / TRAJECTORY_STOP_SPEED ) /
+                    -POINT_ACCELERATION;
+        }
+        GLfloat t = tau < stopTime ? tau : stopTime;
+        GLfloat decay = expf( POINT_ACCELERATION * t );
+        position[i] = keyframe->position[i] + v0 * (decay - 1.0f) /
+                POINT_ACCELERATION;
+        velocity[i] = tau < stopTime ? v0 * decay : 0.0f;
+    }
+}
+
+///
+// Run a shot to rest.  Motion between contacts is evaluated from the current
+// keyframe rather than integrated, so whatever draws the keyframes lands on
+// exactly the positions computed here.  The existing collision code runs at
+// every step and any ball it touches starts a new keyframe.
+//
+// Returns 0 if the shot needs more keyframes than maxKeyframes or doesn't
+// settle within TRAJECTORY_MAX_TIME.
+//
+int BuildTrajectory( struct Trajectory *trajectory, const GLfloat
+        *particleData, const struct Table *table )
+{
+    // Keyframes are appended to scratch as they happen and grouped by ball
+    // at the end.  owner records which ball each one belongs to.
+    struct Keyframe *keyframes = trajectory->scratch;
+    struct Keyframe *sorted = trajectory->keyframes;
+    GLint *owner = trajectory->owner;
+    GLuint maxKeyframes = trajectory->maxKeyframes;
+    GLuint current[ NUM_PARTICLES ];
+    GLfloat state[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLfloat predicted[ NUM_PARTICLES * PARTICLE_SIZE ];
+    GLuint count = 0;
+    GLuint step;
+    int moving = 1;
+    int i;
+
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        const GLfloat *point = &particleData[i * PARTICLE_SIZE];
+        struct Keyframe *keyframe = &keyframes[count];
+        keyframe->time = 0.0f;
+        memcpy( &keyframe->position[0], &point[0], sizeof(GLfloat) * 2 );
+        memcpy( &keyframe->velocity[0], &point[2], sizeof(GLfloat) * 2 );
+        owner[count] = i;
+        current[i] = count++;
+    }
+
+    GLfloat time = 0.0f;
+    for ( step = 1 ; moving ; ++step ) {
+        time = step * TRAJECTORY_STEP;
+        if ( time > TRAJECTORY_MAX_TIME ) {
+            break;
+        }
+        for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+            GLfloat *point = &predicted[i * PARTICLE_SIZE];
+            const struct Keyframe *keyframe = &keyframes[ current[i] ];
+            if ( keyframe->position[0] == INFINITY ) {
+                point[0] = point[1] = INFINITY;
+                point[2] = point[3] = 0.0f;
+                continue;
+            }
+            EvaluateKeyframe( keyframe, time, &point[0], &point[2] );
+        }
+        memcpy( state, predicted, sizeof(state) );
+
+        CheckForParticleCollisions( state, table->ballCount,
+                table->ballRadius, NULL );
+        CheckForBoundaryCollisions( state, table->ballCount, table->boundary,
+                table->collision.e, table->collision.elementsSize,
+                table->collision.n, NULL );
+
+        moving = 0;
+        for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+            GLfloat *point = &state[i * PARTICLE_SIZE];
+            if ( memcmp( point, &predicted[i * PARTICLE_SIZE],
+                    sizeof(GLfloat) * PARTICLE_SIZE ) != 0 ) {
+                if ( count == maxKeyframes ) {
+                    return 0;
+                }
+                struct Keyframe *keyframe = &keyframes[count];
+                keyframe->time = time;
+                memcpy( &keyframe->position[0], &point[0], sizeof(GLfloat) * 2 );
+                memcpy( &keyframe->velocity[0], &point[2], sizeof(GLfloat) * 2 );
+                owner[count] = i;
+                current[i] = count++;
+            }
+            if ( point[2] != 0.0f || point[3] != 0.0f ) {
+                moving = 1;
+            }
+        }
+    }
+    if ( moving ) {
+        return 0;
+    }
+
+    // Group by ball, keeping time order within each.
+    GLuint sortedCount = 0;
+    for ( i = 0 ; i < NUM_PARTICLES ; ++i ) {
+        GLuint k;
+        trajectory->first[i] = sortedCount;
+        for ( k = 0 ; k < count ; ++k ) {
+            if ( owner[k] == i ) {
+                sorted[sortedCount] = keyframes[k];
+                if ( sorted[sortedCount].position[0] == INFINITY ) {
+                    sorted[sortedCount].position[0] = TRAJECTORY_POCKETED;
+                    sorted[sortedCount].position[1] = TRAJECTORY_POCKETED;
+                }
+                ++sortedCount;
+            }
+        }
+        trajectory->count[i] = sortedCount - trajectory->first[i];
+    }
+    trajectory->keyframeCount = count;
+    trajectory->duration = time;
+    memcpy( trajectory->finalParticleData, state, sizeof(state) );
+    return 1;
+}
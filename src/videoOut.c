@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+#include "videoOut.h"
+
+int VideoOutOpen( struct VideoOut *video, const char *path, int format,
+        GLint width, GLint height, GLuint fps )
+{
+    video->format = format;
+    video->width = width;
+    video->height = height;
+    video->fps = fps;
+    video->failed = 0;
+
+    if ( format == VIDEO_Y4M ) {
+        size_t chromaSize = (size_t) ((width + 1) / 2) * ((height + 1) / 2);
+        video->frameSize = (size_t) width * height + 2 * chromaSize;
+    } else {
+        video->frameSize = (size_t) width * height * 3;
+    }
+    video->buffer = malloc( video->frameSize );
+    if ( video->buffer == NULL ) {
+        fprintf( stderr, "%s: Memory Error", __FILE__ );
+        return 0;
+    }
+
+    // A reader going away should end the stream, not the game.
+    signal( SIGPIPE, SIG_IGN );
+
+    if ( strcmp( path, "-" ) == 0 ) {
+        // Keep the real stdout for video and point fd 1 at stderr so the
+        // prompts can't end up in the middle of a frame.
+        int videoFd = dup( STDOUT_FILENO );
+        video->file = videoFd < 0 ? NULL : fdopen( videoFd, "wb" );
+        if ( video->file != NULL ) {
+            fflush( stdout );
+            dup2( STDERR_FILENO, STDOUT_FILENO );
+        }
+    } else {
+        // Opening a FIFO blocks here until the encoder opens the other end.
+        video->file = fopen( path, "wb" );
+    }
+    if ( video->file == NULL ) {
+        fprintf( stderr, "%s: Error opening %s\n", __FILE__, path );
+        free( video->buffer );
+        return 0;
+    }
+    // Frames are written in one piece; don't copy them through stdio.
+    setvbuf( video->file, NULL, _IONBF, 0 );
+
+    if ( format == VIDEO_Y4M ) {
+        // Without XCOLORRANGE readers assume limited range and would crush
+        // the blacks and whites.
+        fprintf( video->file, "YUV4MPEG2 W%d H%d F%u:1 Ip A1:1 C420jpeg "
+                "XCOLORRANGE=FULL\n", width, height, fps );
+    }
+    return 1;
+}
+
+void VideoOutClose( struct VideoOut *video )
+{
+    fclose( video->file );
+    free( video->buffer );
+}
+
+// Full range BT.601 in 8.8 fixed point, as C420jpeg expects.
+#define Y_R 77
+#define Y_G 150
+#define Y_B 29
+#define U_R -43
+#define U_G -85
+#define U_B 128
+#define V_R 128
+#define V_G -107
+#define V_B -21
+
+///
+// One row to Y.  The scalar loop is kept free of branches so the compiler can
+// vectorize it; with NEON we take 16 pixels at a time ourselves.
+//
+static void RowToY( const unsigned char *row, GLint width, GLuint
+        bytesPerPixel, unsigned char *y )
+{
+    GLint x = 0;
+#ifdef __ARM_NEON
+    if ( bytesPerPixel == 4 ) {
+        const uint8x8_t yr = vdup_n_u8( Y_R );
+        const uint8x8_t yg = vdup_n_u8( Y_G );
+        const uint8x8_t yb = vdup_n_u8( Y_B );
+        for ( ; x + 16 <= width ; x += 16 ) {
+            uint8x16x4_t p = vld4q_u8( row + x * 4 );
+            uint16x8_t lo = vmull_u8( vget_low_u8( p.val[0] ), yr );
+            lo = vmlal_u8( lo, vget_low_u8( p.val[1] ), yg );
+            lo = vmlal_u8( lo, vget_low_u8( p.val[2] ), yb );
+            uint16x8_t hi = vmull_u8( vget_high_u8( p.val[0] ), yr );
+            hi = vmlal_u8( hi, vget_high_u8( p.val[1] ), yg );
+            hi = vmlal_u8( hi, vget_high_u8( p.val[2] ), yb );
+            vst1q_u8( y + x, vcombine_u8( vrshrn_n_u16( lo, 8 ),
+                    vrshrn_n_u16( hi, 8 ) ) );
+        }
+    }
+#endif
+    for ( ; x < width ; ++x ) {
+        const unsigned char *p = row + x * bytesPerPixel;
+        y[x] = (unsigned char) ((Y_R * p[0] + Y_G * p[1] + Y_B * p[2] + 128)
+                >> 8);
+    }
+}
+
+static inline unsigned char ClampByte( int value )
+{
+    return (unsigned char) (value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+///
+// Two rows to one row each of U and V from the 2x2 averages.  An odd last
+// column is paired with itself.
+//
+static void RowsToUV( const unsigned char *row0, const unsigned char *row1,
+        GLint width, GLuint bytesPerPixel, unsigned char *u, unsigned char *v )
+{
+    GLint x = 0;
+#ifdef __ARM_NEON
+    if ( bytesPerPixel == 4 ) {
+        for ( ; x + 16 <= width ; x += 16 ) {
+            uint8x16x4_t p0 = vld4q_u8( row0 + x * 4 );
+            uint8x16x4_t p1 = vld4q_u8( row1 + x * 4 );
+            int16x8_t r = vreinterpretq_s16_u16( vrshrq_n_u16( vaddq_u16(
+                    vpaddlq_u8( p0.val[0] ), vpaddlq_u8( p1.val[0] ) ), 2 ) );
+            int16x8_t g = vreinterpretq_s16_u16( vrshrq_n_u16( vaddq_u16(
+                    vpaddlq_u8( p0.val[1] ), vpaddlq_u8( p1.val[1] ) ), 2 ) );
+            int16x8_t b = vreinterpretq_s16_u16( vrshrq_n_u16( vaddq_u16(
+                    vpaddlq_u8( p0.val[2] ), vpaddlq_u8( p1.val[2] ) ), 2 ) );
+
+            int16x8_t cu = vmulq_n_s16( r, U_R );
+            cu = vmlaq_n_s16( cu, g, U_G );
+            cu = vmlaq_n_s16( cu, b, U_B );
+            int16x8_t cv = vmulq_n_s16( r, V_R );
+            cv = vmlaq_n_s16( cv, g, V_G );
+            cv = vmlaq_n_s16( cv, b, V_B );
+            cu = vaddq_s16( vrshrq_n_s16( cu, 8 ), vdupq_n_s16( 128 ) );
+            cv = vaddq_s16( vrshrq_n_s16( cv, 8 ), vdupq_n_s16( 128 ) );
+            vst1_u8( u + x / 2, vqmovun_s16( cu ) );
+            vst1_u8( v + x / 2, vqmovun_s16( cv ) );
+        }
+    }
+#endif
+    for ( ; x < width ; x += 2 ) {
+        GLint x1 = (x + 1 < width) ? x + 1 : x;
+        const unsigned char *a = row0 + x * bytesPerPixel;
+        const unsigned char *b = row0 + x1 * bytesPerPixel;
+        const unsigned char *c = row1 + x * bytesPerPixel;
+        const unsigned char *d = row1 + x1 * bytesPerPixel;
+        int r = (a[0] + b[0] + c[0] + d[0] + 2) >> 2;
+        int g = (a[1] + b[1] + c[1] + d[1] + 2) >> 2;
+        int bl = (a[2] + b[2] + c[2] + d[2] + 2) >> 2;
+        u[x / 2] = ClampByte( ((U_R * r + U_G * g + U_B * bl + 128) >> 8) + 128 );
+        v[x / 2] = ClampByte( ((V_R * r + V_G * g + V_B * bl + 128) >> 8) + 128 );
+    }
+}
+
+///
+// Convert a bottom-up RGBA or RGB frame to top-down planar 4:2:0.
+//
+static void FrameToYuv420( const struct Frame *frame, unsigned char *yuv )
+{
+    GLint width = frame->width;
+    GLint height = frame->height;
+    GLint chromaWidth = (width + 1) / 2;
+    GLint chromaHeight = (height + 1) / 2;
+    size_t stride = (size_t) width * frame->bytesPerPixel;
+    unsigned char *yPlane = yuv;
+    unsigned char *uPlane = yPlane + (size_t) width * height;
+    unsigned char *vPlane = uPlane + (size_t) chromaWidth * chromaHeight;
+    GLint row;
+
+    for ( row = 0 ; row < height ; ++row ) {
+        RowToY( frame->pixels + (height - 1 - row) * stride, width,
+                frame->bytesPerPixel, yPlane + (size_t) row * width );
+    }
+    for ( row = 0 ; row < chromaHeight ; ++row ) {
+        GLint top = height - 1 - 2 * row;
+        GLint bottom = (top > 0) ? top - 1 : top;
+        RowsToUV( frame->pixels + top * stride, frame->pixels + bottom *
+                stride, width, frame->bytesPerPixel,
+                uPlane + (size_t) row * chromaWidth,
+                vPlane + (size_t) row * chromaWidth );
+    }
+}
+
+static void FrameToRgb( const struct Frame *frame, unsigned char *rgb )
+{
+    size_t stride = (size_t) frame->width * frame->bytesPerPixel;
+    GLint row, x;
+    for ( row = 0 ; row < frame->height ; ++row ) {
+        const unsigned char *src = frame->pixels + (frame->height - 1 - row) *
+                stride;
+        unsigned char *dst = rgb + (size_t) row * frame->width * 3;
+        if ( frame->bytesPerPixel == 3 ) {
+            memcpy( dst, src, stride );
+            continue;
+        }
+        for ( x = 0 ; x < frame->width ; ++x ) {
+            dst[3 * x + 0] = src[4 * x + 0];
+            dst[3 * x + 1] = src[4 * x + 1];
+            dst[3 * x + 2] = src[4 * x + 2];
+        }
+    }
+}
+
+void FrameEncodeVideo( struct FrameCapture *capture, struct Frame *frame )
+{
+    struct VideoOut *video = capture->encodeData;
+    if ( video->failed ) {
+        return;
+    }
+    if ( frame->type != GL_UNSIGNED_BYTE ||
+         (frame->format != GL_RGBA && frame->format != GL_RGB) ) {
+        fprintf( stderr, "%s: Can't convert format 0x%x type 0x%x\n",
+                __FILE__, frame->format, frame->type );
+        video->failed = 1;
+        return;
+    }
+
+    if ( video->format == VIDEO_Y4M ) {
+        FrameToYuv420( frame, video->buffer );
+        if ( fwrite( "FRAME\n", 1, 6, video->file ) != 6 ) {
+            video->failed = 1;
+        }
+    } else {
+        FrameToRgb( frame, video->buffer );
+    }
+    if ( !video->failed && fwrite( video->buffer, 1, video->frameSize,
+            video->file ) != video->frameSize ) {
+        video->failed = 1;
+    }
+    if ( video->failed ) {
+        fprintf( stderr, "%s: Video output closed, no more frames will be "
+                "written\n", __FILE__ );
+    }
+}
@@ -0,0 +1,218 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "wall.h"
+#include "rack.h"
+
+void WallLayout( struct Wall *wall, GLuint count )
+{
+    GLuint i;
+    wall->count = count;
+    wall->columns = (GLuint) ceil( sqrt( (double) count ) );
+    wall->rows = ( count + wall->columns - 1 ) / wall->columns;
+    // Every table fills the window on its own, so the same scale keeps them
+    // in proportion whatever the window's shape.
+    GLfloat scale = 1.0f / ( wall->columns > wall->rows ? wall->columns :
+            wall->rows );
+    for ( i = 0 ; i < count ; ++i ) {
+        GLuint column = i % wall->columns;
+        GLuint row = i / wall->columns;
+        GLfloat *cell = &wall->cells[i * 4];
+        cell[0] = -1.0f + ( 2.0f * column + 1.0f ) / wall->columns;
+        cell[1] = 1.0f - ( 2.0f * row + 1.0f ) / wall->rows;
+        cell[2] = scale;
+        cell[3] = scale;
+    }
+}
+
+int WallLoadReplays( struct Wall *wall, const char * const *paths,
+        GLuint pathCount, const struct TableSpec *spec )
+{
+    GLuint i;
+    for ( i = 0 ; i < pathCount ; ++i ) {
+        struct Replay *replay = &wall->replays[i];
+        if ( !ReplayLoad( replay, paths[i] ) ) {
+            return 0;
+        }
+        ++wall->replayCount;
+        // By name: the path it was loaded from may be spelt differently,
+        // or not exist here at all.
+        if ( strcmp( replay->header.tableName, spec->name ) != 0 ) {
+            fprintf( stderr, "%s: %s was played on %s, not %s\n", __FILE__,
+                    paths[i], replay->header.tableName, spec->name );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int WallOpenLive( struct Wall *wall, const char * const *names,
+        GLuint nameCount, const struct TableSpec *spec )
+{
+    GLuint i;
+    for ( i = 0 ; i < nameCount ; ++i ) {
+        struct SharedStateReader *reader = &wall->live[i];
+        if ( !SharedStateOpen( reader, names[i] ) ) {
+            return 0;
+        }
+        ++wall->liveCount;
+        if ( strcmp( reader->region->table, spec->name ) != 0 ) {
+            fprintf( stderr, "%s: %s is playing %s, not %s\n", __FILE__,
+                    names[i], reader->region->table, spec->name );
+            return 0;
+        }
+        // Blending assumes a tick is 1 / SIM_RATE.
+        if ( reader->region->simRate != SIM_RATE ) {
+            fprintf( stderr, "%s: %s runs at %u ticks a second, not %d\n",
+                    __FILE__, names[i], reader->region->simRate, SIM_RATE );
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int WallStart( struct Wall *wall, const struct Table *table,
+        const struct TableSpec *spec, unsigned int seed )
+{
+    GLuint i;
+    for ( i = 0 ; i + 1 < wall->count ; ++i ) {
+        struct WallTable *wallTable = &wall->tables[i];
+        memset( wallTable, 0, sizeof(*wallTable) );
+        if ( i < wall->liveCount ) {
+            // Racked until the first tick comes in.
+            wallTable->live = &wall->live[i];
+            RackPositions( spec, wallTable->currentState.particleData );
+            memcpy( wallTable->particleData,
+                    wallTable->currentState.particleData,
+                    sizeof(wallTable->particleData) );
+            memcpy( wallTable->currentState.previousParticleData,
+                    wallTable->currentState.particleData,
+                    sizeof(wallTable->currentState.previousParticleData) );
+            ++wall->started;
+            continue;
+        }
+        if ( wall->replayCount > 0 ) {
+            wallTable->replay = &wall->replays[ ( i - wall->liveCount ) %
+                wall->replayCount ];
+            if ( !ReplaySeek( &wallTable->cursor, wallTable->replay,
+                        &wallTable->replay->index[0] ) ) {
+                return 0;
+            }
+            memcpy( wallTable->particleData, wallTable->cursor.particleData,
+                    sizeof(wallTable->particleData) );
+            wallTable->rackSeed = wallTable->replay->header.rackSeed;
+        } else {
+            RackPositions( spec, wallTable->particleData );
+            wallTable->rackSeed = seed + i + 1;
+        }
+        if ( !SimThreadStart( &wallTable->sim, table,
+                    wallTable->particleData ) ) {
+            return 0;
+        }
+        ++wall->started;
+    }
+    return 1;
+}
+
+///
+// Put every ball back where the replay starts.
+//
+static void Rerack( struct WallTable *table, GLint ballCount )
+{
+    struct SimCommand command;
+    GLint i;
+    if ( !ReplaySeek( &table->cursor, table->replay,
+                &table->replay->index[0] ) ) {
+        table->replay = NULL;
+        return;
+    }
+    command.type = SIM_COMMAND_PLACE;
+    for ( i = 0 ; i < ballCount ; ++i ) {
+        command.ball = i;
+        command.value[0] = table->cursor.particleData[i * PARTICLE_SIZE];
+        command.value[1] = table->cursor.particleData[i * PARTICLE_SIZE + 1];
+        if ( SimThreadSubmit( &table->sim, &command ) ) {
+            ++table->commandsSubmitted;
+        }
+    }
+}
+
+void WallFeed( struct WallTable *table, GLint ballCount )
+{
+    struct SimCommand command;
+    if ( table->replay == NULL ||
+            table->currentState.commandsApplied != table->commandsSubmitted ||
+            table->currentState.moving ) {
+        return;
+    }
+    if ( table->restTime > 0.0 ) {
+        if ( SimThreadNow() - table->restTime >= WALL_REPLAY_PAUSE ) {
+            table->restTime = 0.0;
+            Rerack( table, ballCount );
+        }
+        return;
+    }
+    while ( ReplayNextCommand( &table->cursor, &command ) ) {
+        if ( SimThreadSubmit( &table->sim, &command ) ) {
+            ++table->commandsSubmitted;
+        }
+        if ( command.type == SIM_COMMAND_SHOOT ) {
+            return;
+        }
+    }
+    table->restTime = SimThreadNow();
+}
+
+void WallPoll( struct WallTable *table, GLint ballCount )
+{
+    struct SimState *state = &table->currentState;
+    struct SharedState tick;
+    double now = SimThreadNow();
+    GLint i;
+    while ( SharedStateRead( table->live, &tick ) ) {
+        // Ticks are only seen a frame at a time, so each looks later than
+        // it was.  The one that looks earliest is the best guess at when
+        // the live game's ticks go out.
+        double epoch = now - (double) tick.tick / SIM_RATE;
+        if ( table->liveTicks == 0 || epoch < table->liveEpoch ) {
+            table->liveEpoch = epoch;
+        }
+        // Blend from the tick before, or not at all across a gap.
+        int step = table->liveTicks > 0 && tick.tick == state->tick + 1;
+        if ( step ) {
+            memcpy( state->previousParticleData, state->particleData,
+                    sizeof(state->previousParticleData) );
+        }
+        for ( i = 0 ; i < ballCount ; ++i ) {
+            memcpy( &state->particleData[i * PARTICLE_SIZE], tick.balls[i],
+                    sizeof(GLfloat) * PARTICLE_SIZE );
+        }
+        if ( !step ) {
+            memcpy( state->previousParticleData, state->particleData,
+                    sizeof(state->previousParticleData) );
+        }
+        state->tick = tick.tick;
+        state->moving = tick.moving != 0;
+        ++table->liveTicks;
+    }
+    state->publishTime = table->liveEpoch + (double) state->tick / SIM_RATE;
+}
+
+void WallStop( struct Wall *wall )
+{
+    GLuint i;
+    for ( i = 0 ; i < wall->started ; ++i ) {
+        if ( wall->tables[i].live == NULL ) {
+            SimThreadStop( &wall->tables[i].sim );
+        }
+    }
+    wall->started = 0;
+    for ( i = 0 ; i < wall->liveCount ; ++i ) {
+        SharedStateClose( &wall->live[i] );
+    }
+    wall->liveCount = 0;
+    for ( i = 0 ; i < wall->replayCount ; ++i ) {
+        ReplayFree( &wall->replays[i] );
+    }
+    wall->replayCount = 0;
+}
@@ -0,0 +1,90 @@
+// Follows a game started with --shared-state NAME from another process.
+//
+//     watchState [--latest] NAME
+//
+// prints a line for every tick where a ball moved or went down: the tick,
+// the moving and pocketed masks (bit per ball number) and where each moving
+// ball is.  With --latest it only prints the newest tick each time it looks,
+// the way a viewer drawing at its own frame rate would read.  Dropped ticks
+// (the game lapped us) are counted on stderr at exit.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include "sharedState.h"
+
+#define WATCH_POLL_NS 1000000 // 1 ms, a quarter of a tick.
+
+static volatile sig_atomic_t stopping;
+
+static void Stop( int signal )
+{
+    (void) signal;
+    stopping = 1;
+}
+
+static void PrintState( const struct SharedState *state )
+{
+    int i;
+    printf( "%u moving %06x pocketed %06x", state->tick, state->moving,
+            state->pocketed );
+    for ( i = 0 ; i < SHARED_STATE_BALLS ; ++i ) {
+        if ( state->moving & 1u << i ) {
+            printf( " %d:%.4f,%.4f", i, state->balls[i][0],
+                    state->balls[i][1] );
+        }
+    }
+    printf( "\n" );
+}
+
+int main( int argc, char *argv[] )
+{
+    struct SharedStateReader reader;
+    struct SharedState state;
+    uint32_t lastPocketed = 0;
+    int wasMoving = 1;
+    int latest = 0;
+    const char *name = NULL;
+    int i;
+
+    for ( i = 1 ; i < argc ; ++i ) {
+        if ( strcmp( argv[i], "--latest" ) == 0 ) {
+            latest = 1;
+        } else if ( name == NULL ) {
+            name = argv[i];
+        } else {
+            name = NULL;
+            break;
+        }
+    }
+    if ( name == NULL ) {
+        fprintf( stderr, "Usage: %s [--latest] NAME\n", argv[0] );
+        return 1;
+    }
+    if ( !SharedStateOpen( &reader, name ) ) {
+        return 1;
+    }
+    signal( SIGINT, Stop );
+    signal( SIGTERM, Stop );
+
+    while ( !stopping ) {
+        int got = latest ? SharedStateLatest( &reader, &state ) :
+            SharedStateRead( &reader, &state );
+        if ( !got ) {
+            struct timespec sleep = { 0, WATCH_POLL_NS };
+            nanosleep( &sleep, NULL );
+            continue;
+        }
+        if ( state.moving != 0 || wasMoving ||
+                state.pocketed != lastPocketed ) {
+            PrintState( &state );
+            fflush( stdout );
+        }
+        wasMoving = state.moving != 0;
+        lastPocketed = state.pocketed;
+    }
+    fprintf( stderr, "%u ticks dropped\n", reader.dropped );
+    SharedStateClose( &reader );
+    return 0;
+}